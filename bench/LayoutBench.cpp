@@ -0,0 +1,199 @@
+/**
+ * @file LayoutBench.cpp
+ * @author askryabin
+ *
+ * \brief
+ * Microbenchmark of dispatching state layouts at many registered sockets.
+ *
+ * Simulates dispatching after poll: a few of N poll items get revents,
+ * items are scanned and handlers of ready ones are called with Arg
+ * built as reactors do. Between rounds caches are polluted
+ * (as real handlers' work does), so reactor state is mostly cold.
+ * The scan is a copy of Dynamic's loop, not BasicDynamic::call_handler
+ * itself (no batching, priorities or stats), so only the relative cost
+ * of the layouts is meaningful.
+ *
+ * All layouts call the same member function bound to the same context,
+ * only storage of poll items and handlers differs:
+ * \li tr1 - plain vectors of poll items and tr1::function handlers
+ * (the bound functor does not fit into tr1::function and is heap allocated)
+ * \li inplace - aligned poll items, handlers stored inline (Dynamic default)
+ * \li packed - aligned poll items and packed {thunk, context} handlers
+ *
+ * Usage:
+ * \code
+ * $ ./LayoutBench [sockets=1000] [ready=10] [rounds=20000]
+ * \endcode
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <vector>
+#include <tr1/functional>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/InplaceHandler.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+#include "zmqreactor/details/AlignedAllocator.hpp"
+#include "zmqreactor/details/Clock.hpp"
+
+using ZmqReactor::Arg;
+using ZmqReactor::Private::AlignedAllocator;
+
+static const size_t POLLUTION_SIZE = 8 * 1024 * 1024;
+
+struct Context
+{
+  long calls;
+  long payload[7];
+
+  bool
+  handle(Arg arg)
+  {
+    calls += arg.events;
+    return true;
+  }
+};
+
+template <typename HandlerT, typename PollItemsVec, typename HandlersVec>
+struct Layout
+{
+  PollItemsVec poll_items;
+  std::vector<zmq::socket_t*> sockets;
+  std::vector<short> flags;
+  HandlersVec handlers;
+
+  void
+  add(const HandlerT& h, int fd)
+  {
+    zmq::pollitem_t item = {0, fd, ZMQ_POLLIN, 0};
+    poll_items.push_back(item);
+    sockets.push_back(0);
+    flags.push_back(0);
+    handlers.push_back(h);
+  }
+
+  /**
+   * Scan like Dynamic reactor does
+   */
+  void
+  dispatch(int num_ready)
+  {
+    const int size = poll_items.size();
+    for (int n = 0; n < size && num_ready > 0; ++n)
+    {
+      if (poll_items[n].revents)
+      {
+        --num_ready;
+        Arg arg = {sockets[n], poll_items[n].fd, poll_items[n].revents};
+        poll_items[n].revents = 0;
+        if (!flags[n])
+        {
+          handlers[n](arg);
+        }
+      }
+    }
+  }
+};
+
+typedef std::tr1::function<bool (Arg)> Tr1Handler;
+
+typedef Layout<Tr1Handler,
+  std::vector<zmq::pollitem_t>, std::vector<Tr1Handler> > Tr1Layout;
+
+typedef Layout<ZmqReactor::InplaceHandler<>,
+  std::vector<zmq::pollitem_t, AlignedAllocator<zmq::pollitem_t> >,
+  std::vector<ZmqReactor::InplaceHandler<>,
+    AlignedAllocator<ZmqReactor::InplaceHandler<> > > > InplaceLayout;
+
+typedef Layout<ZmqReactor::PackedHandler,
+  std::vector<zmq::pollitem_t, AlignedAllocator<zmq::pollitem_t> >,
+  std::vector<ZmqReactor::PackedHandler,
+    AlignedAllocator<ZmqReactor::PackedHandler> > > PackedLayout;
+
+static std::vector<char> pollution(POLLUTION_SIZE);
+
+static void
+pollute()
+{
+  for (size_t i = 0; i < pollution.size(); i += 64)
+  {
+    ++pollution[i];
+  }
+}
+
+template <typename LayoutT>
+double
+measure(LayoutT& layout, const std::vector<int>& ready, int num_ready)
+{
+  const int rounds = ready.size() / num_ready;
+  uint64_t total = 0;
+  for (int r = 0; r < rounds; ++r)
+  {
+    for (int i = 0; i < num_ready; ++i)
+    {
+      layout.poll_items[ready[r * num_ready + i]].revents = ZMQ_POLLIN;
+    }
+    pollute();
+    const uint64_t start = ZmqReactor::Private::Clock::now_nsec();
+    layout.dispatch(num_ready);
+    total += ZmqReactor::Private::Clock::now_nsec() - start;
+  }
+  return static_cast<double>(total) / rounds;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  const int sockets = (argc > 1) ? atoi(argv[1]) : 1000;
+  const int num_ready = (argc > 2) ? atoi(argv[2]) : 10;
+  const int rounds = (argc > 3) ? atoi(argv[3]) : 20000;
+  if (sockets <= 0 || num_ready <= 0 || num_ready > sockets || rounds <= 0)
+  {
+    fprintf(stderr, "Usage: %s [sockets] [ready <= sockets] [rounds]\n",
+      argv[0]);
+    return 1;
+  }
+
+  std::vector<Context> contexts(sockets);
+
+  Tr1Layout tr1;
+  InplaceLayout inplace;
+  PackedLayout packed;
+  for (int i = 0; i < sockets; ++i)
+  {
+    Context* ctx = &contexts[i];
+    tr1.add(std::tr1::bind(
+      &Context::handle, ctx, std::tr1::placeholders::_1), i);
+    inplace.add(std::tr1::bind(
+      &Context::handle, ctx, std::tr1::placeholders::_1), i);
+    packed.add(ZmqReactor::PackedHandler::bind<
+      Context, &Context::handle>(*ctx), i);
+  }
+
+  //distinct random items: one from each of num_ready ranges
+  const int step = sockets / num_ready;
+  std::vector<int> ready(rounds * num_ready);
+  for (int r = 0; r < rounds; ++r)
+  {
+    const int base = rand() % sockets;
+    for (int i = 0; i < num_ready; ++i)
+    {
+      ready[r * num_ready + i] = (base + i * step + rand() % step) % sockets;
+    }
+  }
+
+  printf("sockets: %d, ready per round: %d, rounds: %d\n",
+    sockets, num_ready, rounds);
+  printf("handler sizes: tr1 %u, inplace %u, packed %u\n",
+    static_cast<unsigned>(sizeof(Tr1Handler)),
+    static_cast<unsigned>(sizeof(ZmqReactor::InplaceHandler<>)),
+    static_cast<unsigned>(sizeof(ZmqReactor::PackedHandler)));
+  printf("ns per dispatch round (cold caches):\n");
+  printf("  tr1:     %10.1f\n", measure(tr1, ready, num_ready));
+  printf("  inplace: %10.1f\n", measure(inplace, ready, num_ready));
+  printf("  packed:  %10.1f\n", measure(packed, ready, num_ready));
+  return 0;
+}
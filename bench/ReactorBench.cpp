@@ -0,0 +1,527 @@
+/**
+ * @file ReactorBench.cpp
+ * @author askryabin
+ *
+ * \brief
+ * Benchmark of reactors' dispatching, results are printed as JSON.
+ *
+ * Sweeps:
+ * \li number of registered sockets (1 .. 10000)
+ * \li ready fraction: part of sockets getting a message in each round
+ * \li handler type: raw function pointer, bound member function,
+ * bound member function with big parameter (does not fit inline storage)
+ * \li reactor: raw zmq poll loop, Dynamic, Static, Epoll, LibEvent.
+ * Static reactor's arity is fixed at compile time: it runs with
+ * 1, 3, 10 and 20 sockets if make_static is variadic
+ * (ZMQREACTOR_HAS_VARIADIC), otherwise with up to 3 sockets.
+ *
+ * Each configuration runs closed-loop rounds: client thread sends one
+ * timestamped message to each of ready sockets and waits until reactor
+ * (in main thread) handles all of them. Reported:
+ * messages per second, wall-clock time, CPU time of reactor thread only,
+ * and p50/p99/p999 latency from sending message to its handler call.
+ *
+ * Usage:
+ * \code
+ * $ ./zmqreactor_bench [messages=20000] [max_sockets=10000] > results.json
+ * \endcode
+ * Configurations which can not run (i.e. too many sockets for zmq)
+ * are reported with "skipped" reason.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <tr1/functional>
+
+#include <pthread.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Static.hpp"
+#include "zmqreactor/Epoll.hpp"
+#include "zmqreactor/LibEvent.hpp"
+#include "zmqreactor/details/Clock.hpp"
+
+using ZmqReactor::Arg;
+using ZmqReactor::Private::Clock;
+
+static const int SOCKETS[] = {1, 3, 10, 20, 100, 1000, 10000};
+
+static const double READY[] = {0.01, 0.1, 1.0};
+
+enum ReactorKind
+{
+  RAW, DYNAMIC, STATIC, EPOLL, LIBEVENT
+};
+
+static const char* REACTORS[] = {"RAW", "DYNAMIC", "STATIC", "EPOLL", "LIBEVENT"};
+
+enum HandlerKind
+{
+  FN, MEMBER, BIG
+};
+
+static const char* HANDLERS[] = {"fn", "member", "big"};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+zmq::context_t context(1);
+
+/**
+ * Server (reactor thread) state of one configuration run
+ */
+struct State
+{
+  zmq::socket_t* control;
+  long round_size;
+  long in_round;
+  long total;
+  long handled;
+  std::vector<uint64_t> latencies;
+};
+
+static inline bool
+handle(State& st, Arg arg)
+{
+  zmq::message_t msg;
+  arg.socket->recv(&msg);
+  uint64_t sent;
+  memcpy(&sent, msg.data(), sizeof(sent));
+  st.latencies.push_back(Clock::now_nsec() - sent);
+
+  ++st.handled;
+  if (++st.in_round == st.round_size)
+  {
+    st.in_round = 0;
+    zmq::message_t ack(0);
+    st.control->send(ack);
+  }
+  return st.handled < st.total;
+}
+
+static State* fn_state = 0;
+
+static bool
+on_msg_fn(Arg arg)
+{
+  return handle(*fn_state, arg);
+}
+
+struct BigParam
+{
+  long a, b, c, d, e, f, g, h;
+};
+
+struct Server
+{
+  State* st;
+
+  bool
+  on_msg(Arg arg)
+  {
+    return handle(*st, arg);
+  }
+
+  bool
+  on_msg_big(Arg arg, BigParam)
+  {
+    return handle(*st, arg);
+  }
+};
+
+typedef std::vector<zmq::socket_t*> SocketsVec;
+
+struct Client
+{
+  SocketsVec* peers;
+  zmq::socket_t* control;
+  long rounds;
+  long round_size;
+};
+
+static void*
+client_fun(void* arg)
+{
+  Client* c = static_cast<Client*>(arg);
+  const long n = c->peers->size();
+  const long stride = n / c->round_size;
+  for (long r = 0; r < c->rounds; ++r)
+  {
+    //distinct sockets: one from each of round_size ranges
+    const long base = rand() % n;
+    for (long i = 0; i < c->round_size; ++i)
+    {
+      zmq::message_t msg(sizeof(uint64_t));
+      const uint64_t now = Clock::now_nsec();
+      memcpy(msg.data(), &now, sizeof(now));
+      (*c->peers)[(base + i * stride) % n]->send(msg);
+    }
+    zmq::message_t ack;
+    c->control->recv(&ack);
+  }
+  return 0;
+}
+
+template <typename FunT>
+static void
+run_raw(SocketsVec& socks, const FunT& fun)
+{
+  const int n = socks.size();
+  std::vector<zmq::pollitem_t> items(n);
+  for (int i = 0; i < n; ++i)
+  {
+    zmq::pollitem_t item = {static_cast<void*>(*socks[i]), 0, ZMQ_POLLIN, 0};
+    items[i] = item;
+  }
+  FunT f(fun);
+  while (true)
+  {
+    int ret = zmq::poll(&items[0], n, -1);
+    for (int i = 0; i < n && ret > 0; ++i)
+    {
+      if (items[i].revents)
+      {
+        --ret;
+        Arg arg = {socks[i], 0, items[i].revents};
+        if (!f(arg))
+        {
+          return;
+        }
+      }
+    }
+  }
+}
+
+#ifdef ZMQREACTOR_HAS_VARIADIC
+/**
+ * Static reactor of the first N sockets with the same handler:
+ * make_static(s0, fun, s1, fun, ...)
+ */
+template <size_t N>
+struct StaticMaker
+{
+  template <typename FunT, typename... Args>
+  static ZmqReactor::StaticPtr
+  make(SocketsVec& socks, const FunT& fun, Args&... args)
+  {
+    return StaticMaker<N - 1>::make(socks, fun, *socks[N - 1], fun, args...);
+  }
+};
+
+template <>
+struct StaticMaker<0>
+{
+  template <typename FunT, typename... Args>
+  static ZmqReactor::StaticPtr
+  make(SocketsVec&, const FunT&, Args&... args)
+  {
+    return ZmqReactor::make_static(args...);
+  }
+};
+
+static bool
+static_supports(size_t n)
+{
+  return n == 1 || n == 3 || n == 10 || n == 20;
+}
+
+template <typename FunT>
+static void
+run_static(SocketsVec& socks, const FunT& fun)
+{
+  ZmqReactor::StaticPtr r;
+  switch (socks.size())
+  {
+  case 1:
+    r = StaticMaker<1>::make(socks, fun);
+    break;
+  case 3:
+    r = StaticMaker<3>::make(socks, fun);
+    break;
+  case 10:
+    r = StaticMaker<10>::make(socks, fun);
+    break;
+  default:
+    r = StaticMaker<20>::make(socks, fun);
+    break;
+  }
+  r->run();
+}
+#else
+static bool
+static_supports(size_t n)
+{
+  return n <= 3;
+}
+
+template <typename FunT>
+static void
+run_static(SocketsVec& socks, const FunT& fun)
+{
+  ZmqReactor::StaticPtr r;
+  switch (socks.size())
+  {
+  case 1:
+    r = ZmqReactor::make_static(*socks[0], fun);
+    break;
+  case 2:
+    r = ZmqReactor::make_static(*socks[0], fun, *socks[1], fun);
+    break;
+  default:
+    r = ZmqReactor::make_static(
+      *socks[0], fun, *socks[1], fun, *socks[2], fun);
+    break;
+  }
+  r->run();
+}
+#endif
+
+template <typename ReactorT, typename FunT>
+static void
+run_reactor(SocketsVec& socks, const FunT& fun)
+{
+  ReactorT r;
+  for (size_t i = 0; i < socks.size(); ++i)
+  {
+    r.add_handler(*socks[i], ZmqReactor::Poll::IN, fun);
+  }
+  r.run();
+}
+
+template <typename FunT>
+static void
+run_kind(ReactorKind kind, SocketsVec& socks, const FunT& fun)
+{
+  switch (kind)
+  {
+  case RAW:
+    run_raw(socks, fun);
+    break;
+  case DYNAMIC:
+    run_reactor<ZmqReactor::Dynamic>(socks, fun);
+    break;
+  case STATIC:
+    run_static(socks, fun);
+    break;
+  case EPOLL:
+    run_reactor<ZmqReactor::Epoll>(socks, fun);
+    break;
+  case LIBEVENT:
+    run_reactor<ZmqReactor::LibEvent>(socks, fun);
+    break;
+  }
+}
+
+static uint64_t
+thread_cpu_nsec()
+{
+  timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t
+percentile(const std::vector<uint64_t>& sorted, double q)
+{
+  size_t idx = static_cast<size_t>(sorted.size() * q);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static bool first_record = true;
+
+static void
+print_head(ReactorKind kind, HandlerKind handler, int sockets, double ready)
+{
+  printf("%s\n  {\"reactor\": \"%s\", \"handler\": \"%s\", "
+    "\"sockets\": %d, \"ready\": %g, ",
+    first_record ? "" : ",", REACTORS[kind], HANDLERS[handler],
+    sockets, ready);
+  first_record = false;
+}
+
+static void
+print_skipped(
+  ReactorKind kind, HandlerKind handler, int sockets, double ready,
+  const char* reason)
+{
+  print_head(kind, handler, sockets, ready);
+  printf("\"skipped\": \"%s\"}", reason);
+}
+
+static void
+run_config(
+  ReactorKind kind, HandlerKind handler, double ready,
+  SocketsVec& socks, SocketsVec& peers,
+  zmq::socket_t& control, zmq::socket_t& control_peer, long messages)
+{
+  const int n = socks.size();
+  const long round_size = std::max(1L, static_cast<long>(n * ready + 0.5));
+
+  State st;
+  st.control = &control;
+  st.round_size = round_size;
+  st.in_round = 0;
+  st.handled = 0;
+  const long rounds = std::max(1L, messages / round_size);
+  st.total = rounds * round_size;
+  st.latencies.reserve(st.total);
+
+  Client client = {&peers, &control_peer, rounds, round_size};
+  Server server = {&st};
+  BigParam big = {1, 2, 3, 4, 5, 6, 7, 8};
+  fn_state = &st;
+
+  const uint64_t wall_start = Clock::now_nsec();
+  const uint64_t cpu_start = thread_cpu_nsec();
+
+  pthread_t t;
+  if (::pthread_create(&t, 0, &client_fun, &client))
+  {
+    print_skipped(kind, handler, n, ready, "can not start client thread");
+    return;
+  }
+
+  switch (handler)
+  {
+  case FN:
+    run_kind(kind, socks, &on_msg_fn);
+    break;
+  case MEMBER:
+    run_kind(kind, socks, std::tr1::bind(
+      &Server::on_msg, &server, std::tr1::placeholders::_1));
+    break;
+  case BIG:
+    run_kind(kind, socks, std::tr1::bind(
+      &Server::on_msg_big, &server, std::tr1::placeholders::_1, big));
+    break;
+  }
+
+  const uint64_t cpu = thread_cpu_nsec() - cpu_start;
+  const uint64_t wall = Clock::now_nsec() - wall_start;
+  ::pthread_join(t, 0);
+
+  std::sort(st.latencies.begin(), st.latencies.end());
+  print_head(kind, handler, n, ready);
+  printf("\"messages\": %ld, \"wall_sec\": %.6f, \"cpu_sec\": %.6f, "
+    "\"msgs_per_sec\": %.1f, \"latency_ns\": "
+    "{\"p50\": %llu, \"p99\": %llu, \"p999\": %llu}}",
+    st.handled, wall / 1e9, cpu / 1e9, st.handled / (wall / 1e9),
+    static_cast<unsigned long long>(percentile(st.latencies, 0.5)),
+    static_cast<unsigned long long>(percentile(st.latencies, 0.99)),
+    static_cast<unsigned long long>(percentile(st.latencies, 0.999)));
+  fflush(stdout);
+}
+
+static void
+delete_sockets(SocketsVec& socks)
+{
+  for (size_t i = 0; i < socks.size(); ++i)
+  {
+    delete socks[i];
+  }
+  socks.clear();
+}
+
+/**
+ * Create n pairs of connected sockets
+ * @return false if zmq can not create so many sockets
+ */
+static bool
+create_sockets(int n, SocketsVec& socks, SocketsVec& peers)
+{
+  try
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      char addr[64];
+      snprintf(addr, sizeof(addr), "inproc://zmqreactor_bench_%d", i);
+      socks.push_back(0);
+      socks.back() = new zmq::socket_t(context, ZMQ_PAIR);
+      socks.back()->bind(addr);
+      peers.push_back(0);
+      peers.back() = new zmq::socket_t(context, ZMQ_PAIR);
+      peers.back()->connect(addr);
+    }
+  }
+  catch (const zmq::error_t& e)
+  {
+    fprintf(stderr, "%d sockets: %s\n", n, e.what());
+    delete_sockets(socks);
+    delete_sockets(peers);
+    return false;
+  }
+  return true;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  const long messages = (argc > 1) ? atol(argv[1]) : 20000;
+  const int max_sockets = (argc > 2) ? atoi(argv[2]) : 10000;
+  if (messages <= 0 || max_sockets <= 0)
+  {
+    fprintf(stderr, "Usage: %s [messages] [max_sockets]\n", argv[0]);
+    return 1;
+  }
+
+  zmq::socket_t control(context, ZMQ_PAIR);
+  control.bind("inproc://zmqreactor_bench_control");
+  zmq::socket_t control_peer(context, ZMQ_PAIR);
+  control_peer.connect("inproc://zmqreactor_bench_control");
+
+  printf("[");
+  for (size_t s = 0; s < ARRAY_SIZE(SOCKETS) && SOCKETS[s] <= max_sockets; ++s)
+  {
+    const int n = SOCKETS[s];
+    SocketsVec socks, peers;
+    const bool created = create_sockets(n, socks, peers);
+
+    long prev_round_size = 0;
+    for (size_t r = 0; r < ARRAY_SIZE(READY); ++r)
+    {
+      //the same round size as for smaller fraction
+      const long round_size =
+        std::max(1L, static_cast<long>(n * READY[r] + 0.5));
+      if (round_size == prev_round_size)
+      {
+        continue;
+      }
+      prev_round_size = round_size;
+
+      for (int k = RAW; k <= LIBEVENT; ++k)
+      {
+        for (int h = FN; h <= BIG; ++h)
+        {
+          const ReactorKind kind = static_cast<ReactorKind>(k);
+          const HandlerKind handler = static_cast<HandlerKind>(h);
+          if (!created)
+          {
+            print_skipped(kind, handler, n, READY[r],
+              "can not create sockets");
+          }
+          else if (kind == STATIC && !static_supports(n))
+          {
+            print_skipped(kind, handler, n, READY[r],
+              "static reactor is not built for this number of sockets");
+          }
+          else
+          {
+            run_config(kind, handler, READY[r],
+              socks, peers, control, control_peer, messages);
+          }
+        }
+      }
+    }
+    delete_sockets(socks);
+    delete_sockets(peers);
+  }
+  printf("\n]\n");
+  return 0;
+}
@@ -14,8 +14,11 @@ for <a class="el" href="http://www.zeromq.org/">&Oslash;MQ</a> library.
   But all the functions must be defined when creating the reactor.</li>
   <li>Dynamic reactor is more flexible,
   it allows adding and removing handlers of any type in runtime,
-  but it imposes runtime overhead of creation a <b>tr1::function</b> wrapper and adding it to vector.
-  tr1::function may impose some little overhead both in memory usage and calling speed
+  but it imposes runtime overhead of creation a \ref ZmqReactor::InplaceHandler "InplaceHandler"
+  wrapper and adding it to vector. Typical functors are stored inside the wrapper without
+  memory allocation, and calling costs one indirect call.
+  Handler type (and its inline storage size) is a template parameter of
+  \ref ZmqReactor::BasicDynamic "BasicDynamic".
   </li>
   </ul>
 </li>
@@ -45,6 +48,8 @@ for <a class="el" href="http://www.zeromq.org/">&Oslash;MQ</a> library.
     <dd>
     - \ref ZmqReactor::StaticReactorBase "Static" reactor
     - \ref ZmqReactor::Dynamic "Dynamic" reactor
+    - \ref ZmqReactor::Epoll "Epoll" reactor
+    - \ref ZmqReactor::BasicReactorPool "Pool" of reactor threads
     - \ref ZmqReactor "All ZmqReactor namespace members"
     </dd>
   </li>
@@ -109,10 +114,19 @@ to be installed in order to generate documentation.
 Nothing comes for free, and our library introduces some little overhead
 over plain zeromq poll interface.
 
-To measure this overhead we may use \ref tests/ReactorsTest.cpp "ReactorsTest"
-with huge number of iterations and see the consumed time for each type of reactor.
+To measure this overhead use <i>bin/zmqreactor_bench</i> (bench/ReactorBench.cpp).
+It sweeps number of registered sockets (1 .. 10000), part of them ready in each round,
+handler type (function pointer, bound member function, functor with big bound parameter)
+and reactor (raw zmq poll loop, Dynamic, Static, Epoll, LibEvent),
+and prints JSON records with messages per second, wall-clock time,
+CPU time of reactor thread and p50/p99/p999 latency of message dispatching:
+\code
+$ bin/zmqreactor_bench 20000 > results.json
+\endcode
+Compare result files of two builds to catch regressions.
 
-We have made 10 launches with 1000000 iterations each and got the following summary (in seconds)
+Earlier measurements with ReactorsTest (process CPU time of 10 launches
+with 1000000 iterations each, in seconds):
 
 <table cellspacing=0 cellpadding=2>
 <tr>
@@ -137,6 +151,62 @@ We have made 10 launches with 1000000 iterations each and got the following summ
 
 </table>
 
+To see where reactor time goes in a real application, build the library
+and the application with <b>ZMQREACTOR_STATS</b> macro defined
+(<i>cmake -DZMQREACTOR_STATS=ON ..</i>) and take snapshots of counters
+with <i>stats()</i> function of any reactor (see ZmqReactor::ReactorStats):
+time spent in poll and in dispatching, number of empty wakeups,
+per-handler calls and log2 histograms of handler durations.
+Snapshots may be taken from a monitoring thread without locking.
+Without the macro counters are not collected and cost nothing.
+
+Dispatching state is laid out for cache efficiency: poll items are a dense
+cache line aligned array given to zmq::poll, handlers are a parallel aligned array.
+With \ref ZmqReactor::PackedHandler "PackedHandler" (two pointers: thunk and context)
+four handlers share one cache line.
+<i>bench/LayoutBench</i> compares dispatching costs of different layouts
+with many registered sockets and cold caches.
+
+Timeouts and counters use monotonic clock (not affected by system time changes),
+which is read without system calls. By default it is CLOCK_MONOTONIC.
+Cheaper clock may be selected with <i>cmake -DZMQREACTOR_CLOCK=COARSE ..</i>
+(CLOCK_MONOTONIC_COARSE, resolution of kernel tick, usually 1-4 ms)
+or <i>cmake -DZMQREACTOR_CLOCK=TSC ..</i> (CPU time stamp counter,
+calibrated on first use; x86 with invariant TSC only).
+
+For latency critical paths Dynamic and Static reactors may poll busily:
+before blocking in zmq::poll they spin on non-blocking polls for a spin window,
+so a message coming soon is handled without sleeping in kernel and being woken up.
+The window adapts to recent intervals between events (twice their moving average,
+up to given maximum), and spinning stops while events are rare.
+Counters of spin hits and blocking wakeups help to tune maximum window:
+\code
+  r.set_busy_poll(50); //spin up to 50 microseconds
+  ...
+  const ZmqReactor::BusyPollStats& bs = r.busy_poll_stats();
+\endcode
+Spinning costs CPU time of reactor's thread and needs precise clock
+(not COARSE).
+
+LibEvent reactor asks zmq socket for its state (ZMQ_EVENTS) after each
+handler call and on each edge of socket's descriptor. Socket may be used
+outside of its handlers (i.e. by other reactor's handlers or timers), so
+its state is always queried on edges. A handler which has received
+until EAGAIN may report it, so reactor does not query after it:
+\code
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    while (arg.socket->recv(&msg, ZMQ_NOBLOCK))
+    {
+      ...
+    }
+    reactor->set_remaining_events(0);
+    return true;
+  }
+\endcode
+Queries are counted in <i>events_queries</i> of ZmqReactor::ReactorStats.
+
 First of all, we need to say that this "application" does nothing
 but sending and receiving small messages and dispatching poll events, so it should be considered rather synthetic,
 and in real apps performance costs probably will be even more unnoticeable.
@@ -153,6 +223,7 @@ and in real apps performance costs probably will be even more unnoticeable.
   <li>\ref ref_make_static "Creating static reactor"</li>
   <li>\ref ref_make_dynamic "Creating dynamic reactor"</li>
   <li>\ref ref_timeout "Poll with timeout"</li>
+  <li>\ref ref_pool "Running reactors in many threads"</li>
 </ul>
 </div>
 
@@ -226,7 +297,10 @@ int main()
 }
 \endcode
 
-You can give up to 5 pairs of socket and handler.
+With C++11 compiler (variadic templates) you can give any number of pairs
+of socket and handler, handlers are dispatched through a table of
+per-item dispatchers generated at compile time.
+Otherwise you can give up to 5 pairs of socket and handler.
 If this limit is not enough you may create new make_static functions as
 defined in \ref Static.hpp
 
@@ -279,6 +353,89 @@ int main()
 }
 \endcode
 
+Single handler is removed by handle, returned by add_handler.
+The last handler is moved to its place, so removal is O(1).
+Removal from a handler is deferred till the end of current poll,
+stale handles are detected:
+
+\code
+  ZmqReactor::HandlerHandle h = r.add_handler(sock2, &on_message);
+  ...
+  r.remove_handler(h); //true
+  r.remove_handler(h); //false, already removed
+\endcode
+
+By default handlers are called in registration order, so under
+sustained load sockets added first are served first.
+Fair dispatch mode rotates the starting position between polls and
+limits number of handler calls (messages) per socket and per poll,
+bounding the latency of every registered socket:
+
+\code
+  r.set_dispatch_mode(ZmqReactor::Dynamic::FAIR);
+  r.set_fair_limits(16, 256); //16 messages per socket, 256 per poll
+\endcode
+
+Control sockets may be given higher priority than bulk data sockets
+(Dynamic, Static and LibEvent reactors; LibEvent maps them
+onto libevent event priorities): within a poll, ready higher priority
+handlers are called first, and with FAIR round limit
+low priority handlers are deferred to next polls.
+
+\code
+  r.add_handler(control, ZMQ_POLLIN | ZmqReactor::Poll::HIGH_PRIORITY, on_control);
+  r.add_handler(bulk, ZMQ_POLLIN | ZmqReactor::Poll::LOW_PRIORITY, on_data);
+\endcode
+
+Handlers which only receive a message may let reactor receive it
+(Dynamic, Epoll and LibEvent reactors). Message objects are taken from
+reactor's pool and reused, so no message objects are created per receive:
+
+\code
+bool on_query(ZmqReactor::Arg arg, zmq::message_t& query)
+{
+  //query is valid till return
+  return true;
+}
+
+  r.add_recv_handler(sock2, &on_query, ZmqReactor::Poll::BATCH);
+\endcode
+
+Multipart messages are received by reactor the same way: all frames
+are received into reused frames vector, handler gets their view
+(ZmqReactor::Multipart). For ROUTER/XREP and DEALER/XREQ sockets
+envelope (identity frames) and body (frames after empty delimiter)
+are split without copying, messages of other sockets are not split:
+
+\code
+bool on_request(ZmqReactor::Arg arg, ZmqReactor::Multipart msg)
+{
+  ZmqReactor::Multipart identity = msg.envelope();
+  ZmqReactor::Multipart body = msg.body();
+  ...
+  return true;
+}
+
+  r.add_multipart_handler(router, &on_request);
+\endcode
+
+To not block or drop messages when peer is slow (socket's HWM is reached),
+send them through socket's send queue (Dynamic and LibEvent reactors).
+Queued messages are sent when socket becomes writable:
+reactor polls socket for ZMQ_POLLOUT only while queue is not empty.
+Backpressure callback tells producers to slow down:
+
+\code
+void on_backpressure(ZmqReactor::SendQueue& queue, bool congested)
+{
+  congested ? r.disable_handler(input) : r.enable_handler(input);
+}
+
+  ZmqReactor::SendQueue& out = r.add_send_queue(sock3, 1000, &on_backpressure);
+  ...
+  out.send(msg); //never blocks
+\endcode
+
 \anchor ref_timeout
 <h3>Polling with timeout</h3>
 
@@ -341,6 +498,89 @@ int main()
 }
 \endcode
 
+Besides poll timeout, any number of timeout handlers may be added to
+Dynamic, Static and Epoll reactors.
+They are kept in a hierarchical timing wheel (O(1) add and cancel)
+and called from poll operations: poll waits not longer than the nearest
+timeout. Timeouts are taken in microseconds, but these reactors wait
+in zmq_poll or epoll_wait, which sleep in whole milliseconds, so timeouts
+and poll deadlines have millisecond resolution (\ref ZmqReactor::TIMEOUT_RESOLUTION).
+
+\code
+  bool on_deadline(ZmqReactor::Arg)
+  {
+    //Arg is filled with zeros for timeouts
+    return true;
+  }
+
+  ZmqReactor::TimeoutHandle h = dr.add_timeout(500000, on_deadline); //0.5 second
+  dr.add_timeout(100000, on_deadline, true); //every 0.1 second
+  ...
+  dr.cancel_timeout(h); //safe even if it has already expired
+\endcode
+
+LibEvent reactor takes microsecond timeouts with
+<i>add_timeout_usec(long usec, fun, persistent)</i> (returns HandlerDesc,
+removed with remove_handler; <i>add_timeout(long sec, ...)</i> still takes
+whole seconds). It uses libevent's precise timer (timerfd on Linux,
+libevent 2.1.2+), so its timeouts and run deadlines are accurate
+to microseconds, and timeouts of equal duration share one libevent timer,
+so many simultaneous timeouts cost one wakeup.
+Use LibEvent reactor for sub-millisecond deadlines.
+
+Tasks may be posted to running Dynamic, Epoll or LibEvent reactor
+from other threads. They are kept in a lock-free queue and called from
+poll operation in posting order; a burst of posts wakes reactor up once.
+
+\code
+  dr.enable_post(); //before other threads post
+
+  //in other thread:
+  dr.post(on_deadline);
+\endcode
+
+Signals may be handled in poll operation of Dynamic or LibEvent reactor
+instead of signal handlers: they are blocked and read from signalfd,
+all signals pending at wakeup with one read. Add signal handlers before
+other threads are started, so signals are blocked in all threads.
+
+\code
+  dr.add_signal_handler(SIGTERM, on_terminate); //bool (const signalfd_siginfo&)
+  dr.add_signal_handler(SIGCHLD, on_child_exit);
+\endcode
+
+Heavy handlers may be offloaded to a \ref ZmqReactor::WorkerPool "worker pool":
+reactor only receives messages, \ref ZmqReactor::Offload "Offload" passes them
+to handlers in worker threads, one at a time per socket (in receiving order).
+Socket is disabled while too many of its messages are in flight.
+
+\code
+  ZmqReactor::WorkerPool workers(4);
+  ZmqReactor::Offload<ZmqReactor::Dynamic> offload(dr, workers);
+  offload.add_handler(socket, heavy_handler); //void (ZmqReactor::OffloadMessage&)
+\endcode
+
+\anchor ref_pool
+<h3>Running reactors in many threads</h3>
+
+ZmqReactor::ReactorPool runs one Dynamic reactor per thread (shard).
+Handlers are distributed among shards when added
+(by least loaded shard or by hash of socket),
+so each socket is used by one thread only.
+Add handlers before the pool is started.
+
+\code
+  ZmqReactor::ReactorPool pool(4); //4 threads, 0 means number of processors
+  for (size_t i = 0; i < sockets.size(); ++i)
+  {
+    pool.add_handler(*sockets[i], handler);
+  }
+  pool.start();
+  ...
+  pool.stop(); //any handler returning false stops the pool too
+  ZmqReactor::PollResult res = pool.join();
+\endcode
+
 
 */
 
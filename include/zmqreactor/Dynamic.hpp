@@ -8,8 +8,16 @@
 #define ZMQREACTOR_DYNAMIC_HPP_
 
 #include "zmqreactor/details/Base.hpp"
+#include "zmqreactor/InplaceHandler.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+#include "zmqreactor/details/PostQueue.hpp"
+#include "zmqreactor/Multipart.hpp"
+#include "zmqreactor/SendQueue.hpp"
+#include "zmqreactor/details/SignalSet.hpp"
+#include "zmqreactor/details/SlotMap.hpp"
 
 #include <vector>
+#include <algorithm>
 #include <tr1/functional>
 
 namespace ZmqReactor
@@ -17,36 +25,151 @@ namespace ZmqReactor
   /**
    * @brief Dynamic reactor. Allows dynamic adding of handlers.
    *
-   * Should be created directly.
-   * Overhead: stores polymorphic functions in vector of tr1 function objects.
-   * They may use dynamic allocations for copies of large functors.
+   * Should be created directly, usually as \ref Dynamic.
+   * Overhead: stores polymorphic functions in vector of HandlerT objects.
+   * Default \ref InplaceHandler stores typical functors inline,
+   * so handlers vector is contiguous and adding handlers does not allocate.
+   * To reject functors which do not fit at compile time, use
+   * strict handler with bigger storage, i.e.:
+   * \code
+   * ZmqReactor::BasicDynamic<ZmqReactor::InplaceHandler<128, true> > r;
+   * \endcode
+   * The most compact (non-owning) handler type is \ref PackedHandler.
    * No virtual calls are performed.
+   * @tparam HandlerT function object, constructible from handler functors,
+   * with signature bool (Arg), i.e. \ref InplaceHandler
+   * or tr1::function<bool (Arg)>
    */
-  class Dynamic : public Private::ReactorBase
+  template <typename HandlerT = InplaceHandler<> >
+  class BasicDynamic : public Private::ReactorBase
   {
   private:
 
-    typedef std::tr1::function<bool (ZmqReactor::Arg)> HandlerFun;
-    typedef std::vector<HandlerFun> HandlersVec;
+    typedef HandlerT HandlerFun;
+
+    /**
+     * Parallel to poll items, starts at cache line boundary
+     */
+    typedef std::vector<
+      HandlerFun, Private::AlignedAllocator<HandlerFun> > HandlersVec;
 
     HandlersVec handlers_;
 
+    /**
+     * Handler, looked up by position on each call:
+     * handler may add handlers, reallocating handlers vector
+     */
+    struct HandlerAt
+    {
+      HandlersVec* handlers;
+      int idx;
+
+      inline bool
+      operator() (Arg arg)
+      {
+        return (*handlers)[idx](arg);
+      }
+    };
+
   public:
 
+    /**
+     * @brief How handlers are found after poll operation.
+     */
+    enum DispatchMode
+    {
+      /**
+       * Scan poll items calling handlers of matched ones,
+       * stop as soon as all items reported by poll are seen. Default.
+       * If some handler is added with priority flag (\ref Poll::HIGH_PRIORITY),
+       * works as READY_LIST.
+       */
+      SCAN,
+      /**
+       * Collect compact list of ready items first, then call their handlers
+       * (higher priorities first).
+       * Handlers' calling cost does not depend on registered items positions.
+       */
+      READY_LIST,
+      /**
+       * Like READY_LIST, but dispatch starts from a rotating position
+       * (next ready item after the one served first by previous poll),
+       * and each ready zmq socket handler is called while socket reports
+       * events, up to per-socket budget (see set_fair_limits).
+       * So no socket is favoured for its position, and a busy socket
+       * can not delay the others for more than budget calls.
+       * Rotation applies within each priority class.
+       */
+      FAIR
+    };
+
+    BasicDynamic() :
+      dispatch_mode_(SCAN), fair_budget_(DEFAULT_FAIR_BUDGET),
+      fair_round_limit_(0), fair_start_(0), dispatching_(false),
+      multiparts_(messages_)
+    {}
+
+    inline void
+    set_dispatch_mode(DispatchMode mode)
+    {
+      dispatch_mode_ = mode;
+    }
+
+    inline DispatchMode
+    dispatch_mode() const
+    {
+      return dispatch_mode_;
+    }
+
+    /**
+     * @brief Set limits of FAIR dispatch mode.
+     *
+     * With R ready sockets, handler of a ready socket is called after
+     * at most (R - 1) * socket_budget calls of other handlers.
+     * Round limit also bounds time between polls, so timeouts and
+     * new events are checked at least every round_limit calls;
+     * items not served in a poll are served first in the next one.
+     * @param socket_budget maximum number of handler calls (messages)
+     * for one socket per poll, at least 1
+     * @param round_limit maximum number of handler calls per poll,
+     * 0 for no limit
+     */
+    inline void
+    set_fair_limits(size_t socket_budget, size_t round_limit = 0)
+    {
+      fair_budget_ = socket_budget ? socket_budget : 1;
+      fair_round_limit_ = round_limit;
+    }
+
+    inline size_t
+    fair_budget() const
+    {
+      return fair_budget_;
+    }
+
+    inline size_t
+    fair_round_limit() const
+    {
+      return fair_round_limit_;
+    }
+
     /**
      * @brief Add poll handler for zmq socket.
      *
      * @tparam FunT functor with signature: bool (Arg);
      * @param socket bound socket
-     * @param events zmq events mask to handle, for example POLL::IN
+     * @param events zmq events mask to handle, for example POLL::IN.
+     * May be combined with Poll::BATCH flag.
      * @param fun functor. Must be copyable.
+     * @return handle to remove handler with
      */
     template <typename FunT>
-    void
+    HandlerHandle
     add_handler(zmq::socket_t& socket, short events, const FunT& fun)
     {
       add_socket(socket, events);
       handlers_.push_back(HandlerFun(fun));
+      return slots_.add();
     }
 
     /**
@@ -80,13 +203,15 @@ namespace ZmqReactor
      * @param fd unix file descriptor
      * @param events zmq events mask to handle, for example ZMQ_POLLIN
      * @param fun functor. Must be copyable.
+     * @return handle to remove handler with
      */
     template <typename FunT>
-    void
+    HandlerHandle
     add_handler(int fd, short events, const FunT& fun)
     {
       add_fd(fd, events);
       handlers_.push_back(HandlerFun(fun));
+      return slots_.add();
     }
 
     /**
@@ -94,10 +219,10 @@ namespace ZmqReactor
      * Overload for events = ZMQ_POLLIN
      */
     template <typename FunT>
-    inline void
+    inline HandlerHandle
     add_handler(zmq::socket_t& socket, const FunT& fun)
     {
-      add_handler(socket, ZMQ_POLLIN, fun);
+      return add_handler(socket, ZMQ_POLLIN, fun);
     }
 
     /**
@@ -116,10 +241,209 @@ namespace ZmqReactor
      * Overload for events = ZMQ_POLLIN
      */
     template <typename FunT>
-    inline void
+    inline HandlerHandle
     add_handler(int fd, const FunT& fun)
     {
-      add_handler(fd, ZMQ_POLLIN, fun);
+      return add_handler(fd, ZMQ_POLLIN, fun);
+    }
+
+    /**
+     * @brief Remove handler added by add_handler.
+     *
+     * The last handler is moved to its position (O(1)),
+     * so positions of handlers change, but their handles remain valid.
+     * May be called from handlers: then handler is not called anymore,
+     * and is actually removed at the end of current poll operation.
+     * @return false if handle is stale (handler is already removed)
+     */
+    bool
+    remove_handler(const HandlerHandle& handle);
+
+    /**
+     * @brief Check if handler of handle is not removed
+     */
+    inline bool
+    has_handler(const HandlerHandle& handle) const
+    {
+      return slots_.index(handle) >= 0;
+    }
+
+    /**
+     * @brief Stop polling socket until enable_handler is called.
+     *
+     * Handler is kept at its position. May be called from handlers.
+     * @return false if no handler is set for this socket
+     * or it is already disabled
+     */
+    inline bool
+    disable_handler(zmq::socket_t& socket)
+    {
+      const int idx = index_of(socket);
+      return idx >= 0 && disable_item(idx);
+    }
+
+    /**
+     * @brief Resume polling socket, disabled by disable_handler.
+     * @return false if no handler is set for this socket
+     * or it is not disabled
+     */
+    inline bool
+    enable_handler(zmq::socket_t& socket)
+    {
+      const int idx = index_of(socket);
+      return idx >= 0 && enable_item(idx);
+    }
+
+    /**
+     * @brief Check if handler for socket is set and not disabled
+     */
+    inline bool
+    enabled(zmq::socket_t& socket) const
+    {
+      const int idx = index_of(socket);
+      return idx >= 0 && item_enabled(idx);
+    }
+
+    /**
+     * @brief Add handler, receiving messages from zmq socket for it.
+     *
+     * On ZMQ_POLLIN reactor receives one message (ZMQ_NOBLOCK)
+     * into message object from its pool and passes it to handler.
+     * After handler returns, message object is kept for next receives:
+     * no message objects are constructed on receive path,
+     * and small messages are not allocated by zmq.
+     * Handler must not keep reference to message after return
+     * (but may move content out with zmq::message_t::move or copy).
+     * @tparam FunT functor with signature: bool (Arg, zmq::message_t&);
+     * FunT returns true to continue polling, false to break.
+     * @param socket bound socket
+     * @param fun functor. Must be copyable.
+     * @param flags Poll::BATCH and priority flags, ZMQ_POLLIN is implied
+     * @return handle to remove handler with
+     */
+    template <typename FunT>
+    inline HandlerHandle
+    add_recv_handler(zmq::socket_t& socket, const FunT& fun, short flags = 0)
+    {
+      return add_handler(socket, static_cast<short>(ZMQ_POLLIN | flags),
+        Private::RecvHandler<FunT>(messages_, fun));
+    }
+
+    /**
+     * @brief Add handler, receiving multipart messages from zmq socket for it.
+     *
+     * On ZMQ_POLLIN reactor receives all frames of one message
+     * (ZMQ_NOBLOCK) into reused frames vector of pooled message objects
+     * and passes their view (\ref Multipart) to handler.
+     * Frames are valid till handler returns.
+     * Envelope is split only if socket is ROUTER/XREP or DEALER/XREQ
+     * (socket's type is queried here).
+     * @tparam FunT functor with signature: bool (Arg, Multipart);
+     * FunT returns true to continue polling, false to break.
+     * @param socket bound socket
+     * @param fun functor. Must be copyable.
+     * @param flags Poll::BATCH and priority flags, ZMQ_POLLIN is implied
+     * @return handle to remove handler with
+     */
+    template <typename FunT>
+    inline HandlerHandle
+    add_multipart_handler(
+      zmq::socket_t& socket, const FunT& fun, short flags = 0)
+    {
+      return add_handler(socket, static_cast<short>(ZMQ_POLLIN | flags),
+        Private::MultipartHandler<FunT>(multiparts_, socket, fun));
+    }
+
+    /**
+     * @brief Add send queue of zmq socket, see SendQueue.
+     *
+     * Reactor polls socket for ZMQ_POLLOUT only while queue is not empty
+     * (with internal handler, counted in num_handlers()).
+     * Queue lives as long as reactor, but is not flushed anymore
+     * if its handler is removed (i.e. by remove_handlers_from).
+     * It is not updated by replace_socket.
+     * @param socket bound socket, may have its own handlers
+     * @param high_watermark see SendQueue::set_watermarks
+     * @param backpressure called when queue becomes congested and drained
+     * @param flags priority flags of queue's handler
+     */
+    SendQueue&
+    add_send_queue(
+      zmq::socket_t& socket,
+      size_t high_watermark = DEFAULT_SEND_QUEUE_LIMIT,
+      const SendQueue::BackpressureFun& backpressure =
+        SendQueue::BackpressureFun(),
+      short flags = 0)
+    {
+      SendQueue& queue =
+        send_queues_.add(socket, high_watermark, backpressure);
+      const Private::SendQueueFlusher flusher = {&queue};
+      const HandlerHandle handle = add_handler(socket,
+        static_cast<short>(ZMQ_POLLOUT | Private::SEND_QUEUE_FLAG | flags),
+        flusher);
+      disable_item(slots_.index(handle)); //till something is queued
+      queue.set_interest(std::tr1::bind(
+        &BasicDynamic::set_send_interest, this, handle,
+        std::tr1::placeholders::_1));
+      return queue;
+    }
+
+    /**
+     * @brief Allow posting tasks from other threads, see post().
+     *
+     * Adds internal handler of eventfd (it is counted in num_handlers()).
+     * Must be called before tasks are posted from other threads.
+     */
+    void
+    enable_post()
+    {
+      if (posts_.fd() == -1)
+      {
+        posts_.open();
+        add_handler(posts_.fd(), ZMQ_POLLIN, posts_.drainer());
+      }
+    }
+
+    /**
+     * @brief Post task to be called from poll operation.
+     *
+     * May be called from any thread (after enable_post()).
+     * Does not lock or allocate zmq messages: task is pushed to
+     * lock-free queue, and a burst of posts wakes reactor up once.
+     * Tasks are called in reactor's thread in posting order.
+     * @tparam FunT functor with signature: bool (Arg);
+     * called with Arg filled with zeros,
+     * returns true to continue polling, false to break.
+     * @param fun functor. Must be copyable.
+     */
+    template <typename FunT>
+    inline void
+    post(const FunT& fun)
+    {
+      posts_.post(fun);
+    }
+
+    /**
+     * @brief Handle signal in poll operation instead of signal handler.
+     *
+     * Signal is blocked in calling thread and read from signalfd,
+     * so it should be blocked in all threads of process
+     * (i.e. add signal handlers before other threads are started).
+     * All signals share one internal handler of signalfd
+     * (counted in num_handlers()), signals pending at wakeup
+     * are read at once. Signals remain blocked when reactor is destroyed.
+     * @param signo signal number, i.e. SIGTERM
+     * @param fun called with signal info, returns false to break polling.
+     * Replaces function of signal, if any.
+     * @throw zmq::error_t if signalfd can not be created
+     */
+    void
+    add_signal_handler(int signo, const SignalFun& fun)
+    {
+      if (signals_.add(signo, fun))
+      {
+        add_handler(signals_.fd(), ZMQ_POLLIN, signals_.reader());
+      }
     }
 
     /**
@@ -137,21 +461,22 @@ namespace ZmqReactor
      * i.e. if idx is 2:
      * handlers before: [0, 1, 2, 3]
      * handlers after: [0, 1]
+     * Handles of removed handlers become stale.
      */
     void
-    remove_handlers_from(int idx)
-    {
-      remove_from(idx);
-      handlers_.resize(idx);
-    }
+    remove_handlers_from(int idx);
 
     /**
      * @brief Perform one poll operation.
      *
      * @param timeout timeout in microseconds. No timeout by default
      */
-    PollResult
-    operator()(long timeout = -1);
+    inline PollResult
+    operator()(long timeout = -1)
+    {
+      Timer timer(timeout);
+      return poll(timer);
+    }
 
     /**
      * @brief Perform poll operations.
@@ -159,12 +484,93 @@ namespace ZmqReactor
      * Perform polls until either some handler cancels processing
      * (by returning false), timeout expires or some zmq poll error occurs.
      * @param timeout timeout in microseconds. No timeout by default
-     * @param max_events maximum number of events to handle before return.
-     * No limit (-1) by default.
+     * @param max_events maximum number of poll operations
+     * (not messages) before return. No limit (-1) by default.
      */
     PollResult
     run(long timeout = -1, int max_events = -1);
+
+  private:
+    DispatchMode dispatch_mode_;
+
+    size_t fair_budget_;
+
+    size_t fair_round_limit_;
+
+    /**
+     * FAIR mode: dispatch starts from the first ready item at this index
+     */
+    int fair_start_;
+
+    Private::SlotMap slots_;
+
+    /**
+     * Handlers and timeouts are being called
+     */
+    bool dispatching_;
+
+    /**
+     * Positions of handlers removed while dispatching
+     */
+    IndexVec removed_;
+
+    /**
+     * One poll operation, waiting not longer than remaining time of timer
+     */
+    PollResult
+    poll(Timer& timer);
+
+    PollResult
+    dispatch(int num_polled);
+
+    PollResult
+    dispatch_fair(int num_polled);
+
+    /**
+     * Remove handlers removed while dispatching
+     */
+    void
+    finish_dispatch();
+
+    void
+    erase_handler(int idx);
+
+    /**
+     * Poll socket of send queue for ZMQ_POLLOUT or stop
+     */
+    void
+    set_send_interest(const HandlerHandle& handle, bool on)
+    {
+      const int idx = slots_.index(handle);
+      if (idx >= 0)
+      {
+        on ? enable_item(idx) : disable_item(idx);
+      }
+    }
+
+    Private::PostQueue posts_;
+
+    /**
+     * Messages of add_recv_handler handlers
+     */
+    Private::MessagePool messages_;
+
+    /**
+     * Frames of add_multipart_handler handlers
+     */
+    Private::MultipartReceiver multiparts_;
+
+    Private::SendQueues send_queues_;
+
+    Private::SignalSet signals_;
   };
+
+  /**
+   * @brief Dynamic reactor with default handler type
+   */
+  typedef BasicDynamic<> Dynamic;
 }
 
+#include "zmqreactor/details/DynamicImpl.hpp"
+
 #endif /* ZMQREACTOR_DYNAMIC_HPP_ */
@@ -0,0 +1,469 @@
+/**
+ * @file Epoll.hpp
+ * @author askryabin
+ * @brief Interface of epoll-based reactor
+ */
+
+#ifndef ZMQREACTOR_EPOLL_HPP_
+#define ZMQREACTOR_EPOLL_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/Timer.hpp"
+#include "zmqreactor/details/TimerWheel.hpp"
+#include "zmqreactor/details/StatsCollector.hpp"
+#include "zmqreactor/details/PostQueue.hpp"
+#include "zmqreactor/Multipart.hpp"
+#include "zmqreactor/details/HashIndex.hpp"
+
+#include <vector>
+#include <tr1/functional>
+
+#include <sys/epoll.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Epoll-based reactor (Linux only).
+   *
+   * Has the same interface as \ref Dynamic reactor,
+   * so they may be switched with a typedef.
+   *
+   * Unlike zmq poll based reactors it keeps a persistent epoll set,
+   * so one poll operation costs O(ready handlers) instead of
+   * O(registered handlers).
+   * ZMQ sockets are watched through their ZMQ_FD descriptors
+   * (edge-triggered, actual events are taken from ZMQ_EVENTS,
+   * same as \ref LibEvent reactor does).
+   * Native file descriptors are watched level-triggered.
+   *
+   * Remove handlers before closing their sockets or descriptors.
+   */
+  class Epoll : private Private::NonCopyable
+  {
+  private:
+
+    typedef std::tr1::function<bool (ZmqReactor::Arg)> HandlerFun;
+    typedef std::vector<HandlerFun> HandlersVec;
+
+    struct Item
+    {
+      /**
+       * 0 for native descriptor
+       */
+      zmq::socket_t* socket;
+      /**
+       * ZMQ_FD for zmq socket, original descriptor otherwise
+       */
+      int fd;
+      /**
+       * Descriptor registered in epoll set: fd or its duplicate
+       * if fd is shared with another handler
+       */
+      int epoll_fd;
+      short events;
+      /**
+       * zmq socket is in pending_ list
+       */
+      bool pending;
+      /**
+       * Removed from epoll set by disable_handler
+       */
+      bool disabled;
+    };
+
+    typedef std::vector<Item> ItemsVec;
+
+    typedef std::vector<int> IndexVec;
+
+    typedef std::vector<struct epoll_event> EventsVec;
+
+    typedef Private::Timer Timer;
+
+    typedef Private::Clock Clock;
+
+    typedef Private::Stats Stats;
+
+    int epoll_fd_;
+
+    ItemsVec items_;
+
+    HandlersVec handlers_;
+
+    /**
+     * Indexes of zmq sockets, which may have unhandled events
+     * (edge has been consumed, but ZMQ_EVENTS is not checked yet
+     * or still reports events after last handler call).
+     */
+    IndexVec pending_;
+
+    /**
+     * Pending list being dispatched now
+     */
+    IndexVec dispatched_;
+
+    EventsVec events_;
+
+    const char* last_error_;
+
+    size_t batch_limit_;
+
+    Stats stats_;
+
+    Private::TimerWheel timers_;
+
+    Private::PostQueue posts_;
+
+    /**
+     * Messages of add_recv_handler handlers
+     */
+    Private::MessagePool messages_;
+
+    /**
+     * Frames of add_multipart_handler handlers
+     */
+    Private::MultipartReceiver multiparts_;
+
+    typedef Private::HashIndex<int> IndexMap;
+
+    /**
+     * Positions of items by socket or fd
+     */
+    IndexMap index_;
+
+    static inline IndexMap::Key
+    item_key(const Item& item)
+    {
+      return item.socket ?
+        IndexMap::socket_key(item.socket) : IndexMap::fd_key(item.fd);
+    }
+
+    void
+    add_item(zmq::socket_t* socket, int fd, short events);
+
+    void
+    reset_item(int idx, zmq::socket_t* socket, short events);
+
+    void
+    register_item(int idx);
+
+    void
+    unregister_item(int idx);
+
+    void
+    mark_pending(int idx);
+
+    short
+    actual_events(const Item& item);
+
+    bool
+    call_handler(int idx, Arg arg);
+
+    int
+    index_of(zmq::socket_t& socket) const;
+
+    PollResult
+    dispatch(int num_events, int& num_called);
+
+    /**
+     * One poll operation, waiting not longer than remaining time of timer
+     */
+    PollResult
+    poll(Timer& timer);
+
+  public:
+
+    Epoll();
+
+    ~Epoll();
+
+    /**
+     * If poll operation finished with PollResult::ERROR status,
+     * last error is saved and may be obtained.
+     */
+    inline
+    const char*
+    last_error() const
+    {
+      return last_error_;
+    }
+
+    /**
+     * Get snapshot of reactor counters.
+     * @see Private::ReactorBase::stats
+     */
+    inline
+    bool
+    stats(ReactorStats& out) const
+    {
+      return stats_.snapshot(out);
+    }
+
+    /**
+     * Set maximum number of calls of \ref Poll::BATCH handler
+     * per one poll operation.
+     */
+    inline
+    void
+    set_batch_limit(size_t limit)
+    {
+      batch_limit_ = limit;
+    }
+
+    inline
+    size_t
+    batch_limit() const
+    {
+      return batch_limit_;
+    }
+
+    /**
+     * @brief Add poll handler for zmq socket.
+     *
+     * @tparam FunT functor with signature: bool (Arg);
+     * @param socket bound socket
+     * @param events zmq events mask to handle, for example ZMQ_POLLIN.
+     * May be combined with Poll::BATCH flag.
+     * @param fun functor. Must be copyable.
+     */
+    template <typename FunT>
+    void
+    add_handler(zmq::socket_t& socket, short events, const FunT& fun)
+    {
+      handlers_.push_back(HandlerFun(fun));
+      add_item(&socket, 0, events);
+    }
+
+    /**
+     * @brief Replace poll handler for zmq socket to new handler.
+     * @return true if replaced, false if no handler is set for this socket
+     * @tparam FunT functor with signature: bool (Arg);
+     * @param socket bound socket
+     * @param events zmq events mask to handle, for example ZMQ_POLLIN
+     * @param fun functor. Must be copyable.
+     */
+    template <typename FunT>
+    bool
+    replace_handler(zmq::socket_t& socket, short events, const FunT& fun)
+    {
+      int idx = index_of(socket);
+      if (idx < 0)
+      {
+        return false;
+      }
+      handlers_[idx] = HandlerFun(fun);
+      reset_item(idx, &socket, events);
+      return true;
+    }
+
+    /**
+     * @brief Add poll handler for some file descriptor.
+     *
+     * Used for non-zmq pollable actions.
+     * @tparam FunT functor with signature: bool (Arg);
+     * FunT returns true to continue polling, false to break.
+     * @param fd unix file descriptor
+     * @param events zmq events mask to handle, for example ZMQ_POLLIN
+     * @param fun functor. Must be copyable.
+     */
+    template <typename FunT>
+    void
+    add_handler(int fd, short events, const FunT& fun)
+    {
+      handlers_.push_back(HandlerFun(fun));
+      add_item(0, fd, events);
+    }
+
+    /**
+     * @overload
+     * Overload for events = ZMQ_POLLIN
+     */
+    template <typename FunT>
+    inline void
+    add_handler(zmq::socket_t& socket, const FunT& fun)
+    {
+      add_handler(socket, ZMQ_POLLIN, fun);
+    }
+
+    /**
+     * @overload
+     * Overload for events = ZMQ_POLLIN
+     */
+    template <typename FunT>
+    inline bool
+    replace_handler(zmq::socket_t& socket, const FunT& fun)
+    {
+      return replace_handler(socket, ZMQ_POLLIN, fun);
+    }
+
+    /**
+     * @overload
+     * Overload for events = ZMQ_POLLIN
+     */
+    template <typename FunT>
+    inline void
+    add_handler(int fd, const FunT& fun)
+    {
+      add_handler(fd, ZMQ_POLLIN, fun);
+    }
+
+    /**
+     * @brief Add handler, receiving messages from zmq socket for it
+     * into pooled message objects.
+     * @see BasicDynamic::add_recv_handler
+     */
+    template <typename FunT>
+    inline void
+    add_recv_handler(zmq::socket_t& socket, const FunT& fun, short flags = 0)
+    {
+      add_handler(socket, static_cast<short>(ZMQ_POLLIN | flags),
+        Private::RecvHandler<FunT>(messages_, fun));
+    }
+
+    /**
+     * @brief Add handler, receiving multipart messages from zmq socket for it
+     * into pooled frames.
+     * @see BasicDynamic::add_multipart_handler
+     */
+    template <typename FunT>
+    inline void
+    add_multipart_handler(
+      zmq::socket_t& socket, const FunT& fun, short flags = 0)
+    {
+      add_handler(socket, static_cast<short>(ZMQ_POLLIN | flags),
+        Private::MultipartHandler<FunT>(multiparts_, socket, fun));
+    }
+
+    /**
+     * @brief Add timeout handler.
+     * @see Private::ReactorBase::add_timeout
+     */
+    template <typename FunT>
+    TimeoutHandle
+    add_timeout(long timeout, const FunT& fun, bool persistent = false)
+    {
+      return timers_.add(
+        Clock::now_usec(), timeout,
+        Private::TimerWheel::Callback(fun), persistent);
+    }
+
+    /**
+     * @brief Cancel timeout, added by add_timeout.
+     * @return false if timeout has already expired or has been cancelled
+     */
+    inline bool
+    cancel_timeout(const TimeoutHandle& handle)
+    {
+      return timers_.cancel(handle);
+    }
+
+    inline size_t
+    num_timeouts() const
+    {
+      return timers_.size();
+    }
+
+    /**
+     * @brief Stop polling socket until enable_handler is called.
+     * @see BasicDynamic::disable_handler
+     */
+    bool
+    disable_handler(zmq::socket_t& socket);
+
+    /**
+     * @brief Resume polling socket, disabled by disable_handler.
+     * @see BasicDynamic::enable_handler
+     */
+    bool
+    enable_handler(zmq::socket_t& socket);
+
+    /**
+     * @brief Check if handler for socket is set and not disabled
+     */
+    inline bool
+    enabled(zmq::socket_t& socket) const
+    {
+      const int idx = index_of(socket);
+      return idx >= 0 && !items_[idx].disabled;
+    }
+
+    /**
+     * @brief Allow posting tasks from other threads.
+     * @see BasicDynamic::enable_post
+     */
+    void
+    enable_post()
+    {
+      if (posts_.fd() == -1)
+      {
+        posts_.open();
+        add_handler(posts_.fd(), ZMQ_POLLIN, posts_.drainer());
+      }
+    }
+
+    /**
+     * @brief Post task to be called from poll operation.
+     * @see BasicDynamic::post
+     */
+    template <typename FunT>
+    inline void
+    post(const FunT& fun)
+    {
+      posts_.post(fun);
+    }
+
+    /**
+     * @brief Get number of registered handlers
+     */
+    inline size_t
+    num_handlers() const
+    {
+      return handlers_.size();
+    }
+
+    /**
+     * @brief Removes all handlers starting from idx.
+     *
+     * i.e. if idx is 2:
+     * handlers before: [0, 1, 2, 3]
+     * handlers after: [0, 1]
+     */
+    void
+    remove_handlers_from(int idx);
+
+    /**
+     * Replace old socket pointer to new value in all configured handlers.
+     * @see Private::ReactorBase::replace_socket
+     * @return number of actual replacements made
+     */
+    size_t
+    replace_socket(zmq::socket_t* old_ptr, zmq::socket_t* new_ptr);
+
+    /**
+     * @brief Perform one poll operation.
+     *
+     * Waits until at least one handler is called or timeout expires.
+     * @param timeout timeout in microseconds. No timeout by default
+     */
+    inline PollResult
+    operator()(long timeout = -1)
+    {
+      Timer timer(timeout);
+      return poll(timer);
+    }
+
+    /**
+     * @brief Perform poll operations.
+     *
+     * Perform polls until either some handler cancels processing
+     * (by returning false), timeout expires or some poll error occurs.
+     * @param timeout timeout in microseconds. No timeout by default
+     * @param max_events maximum number of events to handle before return.
+     * No limit (-1) by default.
+     */
+    PollResult
+    run(long timeout = -1, int max_events = -1);
+  };
+}
+
+#endif /* ZMQREACTOR_EPOLL_HPP_ */
@@ -0,0 +1,254 @@
+/**
+ * @file InplaceHandler.hpp
+ * @author askryabin
+ * Handler function object with inline storage of functors
+ */
+
+#ifndef ZMQREACTOR_INPLACEHANDLER_HPP_
+#define ZMQREACTOR_INPLACEHANDLER_HPP_
+
+#include "zmqreactor/common.hpp"
+
+#include <new>
+#include <cstddef>
+
+#include <boost/type_traits/decay.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/static_assert.hpp>
+
+namespace ZmqReactor
+{
+  /**
+   * Default size of handlers' inline storage:
+   * enough for bound member function with a couple of arguments
+   */
+  const size_t INPLACE_HANDLER_SIZE = 6 * sizeof(void*);
+
+  /**
+   * @brief Handler function object, replacement of tr1::function<bool (Arg)>.
+   *
+   * Functors not bigger than Size bytes are stored inline
+   * (no dynamic memory allocation on creation or copy).
+   * Bigger ones are allocated on heap, or, if Strict is true,
+   * rejected at compile time (BOOST_STATIC_ASSERT fails:
+   * increase Size or pass smaller functor).
+   * Handler is called with single indirect call.
+   */
+  template <size_t Size = INPLACE_HANDLER_SIZE, bool Strict = false>
+  class InplaceHandler
+  {
+  private:
+    union Storage
+    {
+      char buf[Size];
+      void* align_ptr;
+      long double align_ld;
+      long long align_ll;
+      void (*align_fp)();
+    };
+
+    typedef bool (*CallFun)(void* self, Arg arg);
+
+    struct Ops
+    {
+      CallFun call;
+      void (*clone)(const void* from, void* to);
+      void (*destroy)(void* self);
+    };
+
+    /**
+     * Functor is stored inside storage_
+     */
+    template <typename FunT>
+    struct InplaceOps
+    {
+      static bool
+      call(void* self, Arg arg)
+      {
+        return (*static_cast<FunT*>(self))(arg);
+      }
+
+      static void
+      clone(const void* from, void* to)
+      {
+        new (to) FunT(*static_cast<const FunT*>(from));
+      }
+
+      static void
+      destroy(void* self)
+      {
+        static_cast<FunT*>(self)->~FunT();
+      }
+
+      static void
+      create(void* to, const FunT& fun)
+      {
+        new (to) FunT(fun);
+      }
+
+      static const Ops ops;
+    };
+
+    /**
+     * Pointer to heap-allocated functor is stored inside storage_
+     */
+    template <typename FunT>
+    struct HeapOps
+    {
+      static bool
+      call(void* self, Arg arg)
+      {
+        return (**static_cast<FunT**>(self))(arg);
+      }
+
+      static void
+      clone(const void* from, void* to)
+      {
+        *static_cast<FunT**>(to) =
+          new FunT(**static_cast<FunT* const*>(from));
+      }
+
+      static void
+      destroy(void* self)
+      {
+        delete *static_cast<FunT**>(self);
+      }
+
+      static void
+      create(void* to, const FunT& fun)
+      {
+        *static_cast<FunT**>(to) = new FunT(fun);
+      }
+
+      static const Ops ops;
+    };
+
+    template <typename FunT, bool Fits>
+    struct SelectOps
+    {
+      typedef InplaceOps<FunT> type;
+    };
+
+    template <typename FunT>
+    struct SelectOps<FunT, false>
+    {
+      typedef HeapOps<FunT> type;
+    };
+
+    Storage storage_;
+
+    /**
+     * Copy of ops_->call: calling handler costs one indirect call
+     */
+    CallFun call_;
+
+    const Ops* ops_;
+
+  public:
+    /**
+     * Whether functor of type FunT is stored inline
+     */
+    template <typename FunT>
+    struct Fits
+    {
+      typedef typename boost::decay<FunT>::type Stored;
+
+      static const bool value =
+        sizeof(Stored) <= Size &&
+        boost::alignment_of<Storage>::value %
+          boost::alignment_of<Stored>::value == 0;
+    };
+
+    InplaceHandler() : call_(0), ops_(0) {}
+
+    template <typename FunT>
+    InplaceHandler(const FunT& fun) : call_(0), ops_(0)
+    {
+      //in strict mode functor must fit inline storage
+      BOOST_STATIC_ASSERT(!Strict || Fits<FunT>::value);
+
+      typedef typename Fits<FunT>::Stored Stored;
+      typedef typename SelectOps<Stored, Fits<FunT>::value>::type OpsT;
+      OpsT::create(storage_.buf, fun);
+      ops_ = &OpsT::ops;
+      call_ = ops_->call;
+    }
+
+    InplaceHandler(const InplaceHandler& other) : call_(0), ops_(0)
+    {
+      if (other.ops_)
+      {
+        other.ops_->clone(other.storage_.buf, storage_.buf);
+        ops_ = other.ops_;
+        call_ = other.call_;
+      }
+    }
+
+    ~InplaceHandler()
+    {
+      clear();
+    }
+
+    /**
+     * Basic exception guarantee: empty if copying of functor throws
+     */
+    InplaceHandler&
+    operator= (const InplaceHandler& other)
+    {
+      if (this != &other)
+      {
+        clear();
+        if (other.ops_)
+        {
+          other.ops_->clone(other.storage_.buf, storage_.buf);
+          ops_ = other.ops_;
+          call_ = other.call_;
+        }
+      }
+      return *this;
+    }
+
+    inline void
+    clear()
+    {
+      if (ops_)
+      {
+        ops_->destroy(storage_.buf);
+        ops_ = 0;
+        call_ = 0;
+      }
+    }
+
+    inline bool
+    empty() const
+    {
+      return !ops_;
+    }
+
+    inline bool
+    operator() (Arg arg)
+    {
+      return call_(storage_.buf, arg);
+    }
+  };
+
+  template <size_t Size, bool Strict>
+  template <typename FunT>
+  const typename InplaceHandler<Size, Strict>::Ops
+  InplaceHandler<Size, Strict>::InplaceOps<FunT>::ops = {
+    &InplaceOps<FunT>::call,
+    &InplaceOps<FunT>::clone,
+    &InplaceOps<FunT>::destroy
+  };
+
+  template <size_t Size, bool Strict>
+  template <typename FunT>
+  const typename InplaceHandler<Size, Strict>::Ops
+  InplaceHandler<Size, Strict>::HeapOps<FunT>::ops = {
+    &HeapOps<FunT>::call,
+    &HeapOps<FunT>::clone,
+    &HeapOps<FunT>::destroy
+  };
+}
+
+#endif /* ZMQREACTOR_INPLACEHANDLER_HPP_ */
@@ -21,13 +21,19 @@ namespace ZmqReactor
     {
     private:
       HandlerInfo* hi_;
+
+      /**
+       * Slot of handler's counters, -1 if not counted
+       */
+      int stats_slot_;
+
       friend class LibEvent;
 
       explicit
-      HandlerDesc(HandlerInfo* hi) : hi_(hi) {}
+      HandlerDesc(HandlerInfo* hi);
 
     public:
-      HandlerDesc() : hi_(0) {}
+      HandlerDesc() : hi_(0), stats_slot_(-1) {}
 
       inline
       bool
@@ -11,18 +11,29 @@
 #include "zmqreactor/LibEvent.fwd.hpp"
 #include "zmqreactor/details/NonCopyable.hpp"
 #include "zmqreactor/details/LinkedQueue.hpp"
-
-#include <tr1/functional>
+#include "zmqreactor/details/ObjectPool.hpp"
+#include "zmqreactor/InplaceHandler.hpp"
+#include "zmqreactor/details/StatsCollector.hpp"
+#include "zmqreactor/details/PostQueue.hpp"
+#include "zmqreactor/Multipart.hpp"
+#include "zmqreactor/SendQueue.hpp"
+#include "zmqreactor/details/SignalSet.hpp"
+#include "zmqreactor/details/HashIndex.hpp"
 
 #include <event2/event.h>
 #include <event2/event_struct.h>
 
+#include <map>
+
 namespace ZmqReactor
 {
   struct LibEventBase::HandlerInfo :
     public Private::LinkedBase<LibEventBase::HandlerInfo>
   {
-    typedef std::tr1::function<bool (ZmqReactor::Arg)> Fun;
+    /**
+     * Typical functors (bound member functions) are stored inline
+     */
+    typedef InplaceHandler<> Fun;
 
     Arg arg_; //socket, fd, events
     LibEvent* reactor_;
@@ -40,11 +51,32 @@ namespace ZmqReactor
 
     Status status_;
 
+    /**
+     * Priority class, also libevent priority of event_
+     */
+    int priority_;
+
+    /**
+     * Expected events of zmq socket, reported by the last ZMQ_EVENTS query
+     * (or by handler, see LibEvent::set_remaining_events).
+     * Used only right after handler's call, till the next handler
+     * of the socket is called. Edges of ZMQ_FD are always queried.
+     */
+    short cached_events_;
+    bool events_cached_;
+
+    /**
+     * Slot of counters in reactor's stats, -1 if not counted
+     */
+    int stats_slot_;
+
     template <typename Fun>
     inline
     HandlerInfo(LibEvent* reactor, const Fun& fun, short expected_events) :
       reactor_(reactor), fun_(fun),
-      expected_events_(expected_events), enabled_(true), status_(WAITING)
+      expected_events_(expected_events), enabled_(true), status_(WAITING),
+      priority_(Private::priority_of(expected_events)),
+      cached_events_(0), events_cached_(false), stats_slot_(-1)
     {}
 
     inline
@@ -66,17 +98,31 @@ namespace ZmqReactor
   };
 
   /**
-   * LibEvent-based reactor
+   * LibEvent-based reactor.
+   * Handlers are allocated from reactor's pool and reused,
+   * so adding and removing handlers and timeouts does not
+   * allocate memory in steady state (unless functor is too big
+   * to be stored inline, see InplaceHandler).
    */
   class LibEvent : public LibEventBase, private Private::NonCopyable
   {
   private:
     event_base* base_;
 
+    typedef Private::ObjectPool<HandlerInfo> HandlersPool;
+
+    /**
+     * Must be destroyed after queues
+     */
+    HandlersPool pool_;
+
     typedef Private::LinkedQueue<HandlerInfo> HandlerQueue;
 
     HandlerQueue waiting_handlers_;
-    HandlerQueue triggered_handlers_;
+    /**
+     * By priority class
+     */
+    HandlerQueue triggered_handlers_[PRIORITIES];
     HandlerQueue disabled_handlers_;
 
     HandlerInfo* now_handled_;
@@ -85,7 +131,50 @@ namespace ZmqReactor
 
     PollResult poll_result_; //modified from callbacks
 
-    struct event event_immediate_;
+    /**
+     * Zero timeout to handle triggered handlers of one priority class
+     * (with the same libevent priority)
+     */
+    struct Immediate
+    {
+      LibEvent* reactor;
+      int priority;
+      struct event event;
+    };
+
+    Immediate immediate_[PRIORITIES];
+
+    Private::Stats stats_;
+
+    Private::PostQueue posts_;
+
+    Private::SignalSet signals_;
+
+    /**
+     * Messages of add_recv_handler handlers
+     */
+    Private::MessagePool messages_;
+
+    /**
+     * Frames of add_multipart_handler handlers
+     */
+    Private::MultipartReceiver multiparts_;
+
+    Private::SendQueues send_queues_;
+
+    typedef Private::HashIndex<HandlerInfo*> IndexMap;
+
+    /**
+     * Socket and fd handlers (not timeouts) by socket or fd
+     */
+    IndexMap index_;
+
+    typedef std::map<long, const timeval*> CommonTimeoutsMap;
+
+    /**
+     * libevent common timeouts by duration in microseconds
+     */
+    CommonTimeoutsMap common_timeouts_;
 
     /**
      * Enum struct, never created
@@ -122,9 +211,26 @@ namespace ZmqReactor
     HandlerQueue&
     get_queue(HandlerInfo* hi);
 
+    inline
+    static
+    IndexMap::Key
+    handler_key(const HandlerInfo* hi)
+    {
+      return hi->is_zmq() ?
+        IndexMap::socket_key(hi->arg_.socket) :
+        IndexMap::fd_key(hi->arg_.fd);
+    }
+
     void
     update_immediate_timeout();
 
+    template <typename FunT>
+    HandlerInfo*
+    new_handler(const FunT& fun, short expected_events);
+
+    void
+    assign_event(HandlerInfo* hi, short libev_events);
+
     void
     do_add_handler(HandlerInfo* hi, short libev_events);
 
@@ -140,8 +246,32 @@ namespace ZmqReactor
     PollResult
     do_run(int mode, long timeout);
 
+    /**
+     * Query ZMQ_EVENTS, result is cached
+     */
+    HasEvents::Value
+    has_actual_events(HandlerInfo* hi);
+
+    /**
+     * Cached events if valid, otherwise query
+     */
+    inline
     HasEvents::Value
-    has_actual_events(HandlerInfo* hi) const;
+    known_events(HandlerInfo* hi)
+    {
+      if (hi->events_cached_)
+      {
+        return hi->cached_events_ ? HasEvents::YES : HasEvents::NO;
+      }
+      return has_actual_events(hi);
+    }
+
+    /**
+     * Operation is performed on socket: cached events of all its handlers
+     * are not valid anymore
+     */
+    void
+    invalidate_events(zmq::socket_t* socket);
 
     HasEvents::Value
     handle_event(
@@ -150,6 +280,20 @@ namespace ZmqReactor
     int
     fd_by_sock(zmq::socket_t& sock) const;
 
+    /**
+     * Watch socket of send queue for ZMQ_POLLOUT or stop
+     */
+    void
+    set_send_interest(HandlerInfo* hi, bool on);
+
+    /**
+     * Get libevent common timeout for duration (timers of the same
+     * duration are kept in one queue and share one internal timer event).
+     * @return 0 if there are too many different durations
+     */
+    const timeval*
+    common_timeout(long usec);
+
     size_t
     do_replace_descriptor(
       zmq::socket_t* old_ptr, int old_fd, zmq::socket_t* new_ptr, int new_fd);
@@ -207,14 +351,119 @@ namespace ZmqReactor
       return add_handler(fd, Poll::IN, fun);
     }
 
+    /**
+     * @brief Add handler, receiving messages from zmq socket for it
+     * into pooled message objects.
+     * @see BasicDynamic::add_recv_handler
+     */
+    template <typename FunT>
+    inline HandlerDesc
+    add_recv_handler(zmq::socket_t& socket, const FunT& fun, short flags = 0)
+    {
+      return add_handler(socket, static_cast<short>(ZMQ_POLLIN | flags),
+        Private::RecvHandler<FunT>(messages_, fun));
+    }
+
+    /**
+     * @brief Add handler, receiving multipart messages from zmq socket for it
+     * into pooled frames.
+     * @see BasicDynamic::add_multipart_handler
+     */
+    template <typename FunT>
+    inline HandlerDesc
+    add_multipart_handler(
+      zmq::socket_t& socket, const FunT& fun, short flags = 0)
+    {
+      return add_handler(socket, static_cast<short>(ZMQ_POLLIN | flags),
+        Private::MultipartHandler<FunT>(multiparts_, socket, fun));
+    }
+
+    /**
+     * @brief Add send queue of zmq socket, see SendQueue.
+     *
+     * Reactor watches socket for ZMQ_POLLOUT only while queue
+     * is not empty (with internal handler).
+     * Queue lives as long as reactor and is not updated by replace_socket.
+     * @see BasicDynamic::add_send_queue
+     */
+    SendQueue&
+    add_send_queue(
+      zmq::socket_t& socket,
+      size_t high_watermark = DEFAULT_SEND_QUEUE_LIMIT,
+      const SendQueue::BackpressureFun& backpressure =
+        SendQueue::BackpressureFun(),
+      short flags = 0);
+
+    /**
+     * @brief Allow posting tasks from other threads, see post().
+     *
+     * Adds internal handler of eventfd.
+     * Must be called before tasks are posted from other threads.
+     */
+    inline
+    void
+    enable_post()
+    {
+      if (posts_.fd() == -1)
+      {
+        posts_.open();
+        add_handler(posts_.fd(), Poll::IN, posts_.drainer());
+      }
+    }
+
+    /**
+     * @brief Post task to be called from event loop.
+     * @see BasicDynamic::post
+     */
+    template <typename FunT>
+    inline
+    void
+    post(const FunT& fun)
+    {
+      posts_.post(fun);
+    }
+
+    /**
+     * @brief Handle signal in event loop instead of signal handler.
+     * @see BasicDynamic::add_signal_handler
+     */
+    inline
+    void
+    add_signal_handler(int signo, const SignalFun& fun)
+    {
+      if (signals_.add(signo, fun))
+      {
+        add_handler(signals_.fd(), Poll::IN, signals_.reader());
+      }
+    }
+
     template <typename FunT>
     HandlerDesc
     add_timeout(const timeval& tv, const FunT& fun, bool persistent = false);
 
+    /**
+     * @brief Add timeout handler.
+     * @param sec timeout in whole seconds
+     * @see add_timeout_usec
+     */
     template <typename FunT>
     HandlerDesc
     add_timeout(long sec, const FunT& fun, bool persistent = false);
 
+    /**
+     * @brief Add timeout handler with microsecond timeout.
+     *
+     * Timeouts of equal duration are coalesced: they share one
+     * libevent timer, so many near-simultaneous timeouts
+     * cost one wakeup.
+     * @param usec timeout in microseconds
+     * @param fun functor, Arg is empty
+     * @param persistent fire every usec microseconds until removed
+     */
+    template <typename FunT>
+    HandlerDesc
+    add_timeout_usec(long usec, const FunT& fun, bool persistent = false);
+
     inline
     void
     remove_handler(HandlerDesc& hd)
@@ -254,6 +503,47 @@ namespace ZmqReactor
       return (hd.hi_ && hd.hi_->enabled_);
     }
 
+    /**
+     * Find handler of zmq socket (any one, if many are set)
+     * @return empty descriptor if not found
+     */
+    HandlerDesc
+    find_handler(zmq::socket_t& socket);
+
+    /**
+     * Disable handler of zmq socket.
+     * @return false if not found or already disabled
+     */
+    inline
+    bool
+    disable_handler(zmq::socket_t& socket)
+    {
+      HandlerDesc hd = find_handler(socket);
+      if (!enabled(hd))
+      {
+        return false;
+      }
+      disable_handler(hd);
+      return true;
+    }
+
+    /**
+     * Enable handler of zmq socket.
+     * @return false if not found or not disabled
+     */
+    inline
+    bool
+    enable_handler(zmq::socket_t& socket)
+    {
+      HandlerDesc hd = find_handler(socket);
+      if (hd.empty() || enabled(hd))
+      {
+        return false;
+      }
+      enable_handler(hd);
+      return true;
+    }
+
     /**
      * Force check if actual events are pending for the handler and
      * if so, update its status to TRIGGERED and schedule immediate timeout.
@@ -270,6 +560,27 @@ namespace ZmqReactor
       return HandlerDesc(now_handled_);
     }
 
+    /**
+     * @brief Report events of socket, remaining after handler's operations.
+     *
+     * Called from handler of zmq socket, i.e. with 0 after it has received
+     * until EAGAIN, or with Poll::IN if it knows more messages are queued.
+     * Reactor takes it instead of querying ZMQ_EVENTS after handler returns.
+     * Report only events known for sure: handler is not called
+     * for missed events until socket's state changes again.
+     */
+    inline
+    void
+    set_remaining_events(short events)
+    {
+      if (now_handled_ && now_handled_->is_zmq())
+      {
+        now_handled_->cached_events_ = static_cast<short>(
+          events & now_handled_->expected_events_ & Poll::EVENTS_MASK);
+        now_handled_->events_cached_ = true;
+      }
+    }
+
     /**
      * All HandlerDesc handles are preserved
      */
@@ -292,6 +603,11 @@ namespace ZmqReactor
       return do_run(EVLOOP_ONCE, timeout);
     }
 
+    /**
+     * @brief Run event loop until handler cancels or timeout expires.
+     *
+     * @param timeout timeout in microseconds. No timeout by default
+     */
     inline
     PollResult
     run(long timeout = -1)
@@ -305,17 +621,48 @@ namespace ZmqReactor
     {
       return "libevent error";
     }
+
+    /**
+     * Get snapshot of reactor counters (without per-handler counters).
+     * Poll time is event loop time, not spent in dispatching events.
+     * @see Private::ReactorBase::stats
+     */
+    inline
+    bool
+    stats(ReactorStats& out) const
+    {
+      return stats_.snapshot(out, false);
+    }
+
+    /**
+     * Get snapshot of handler counters.
+     * May be called from any thread. Counters of removed handler
+     * may be reused by handler added later.
+     * @return false if library is compiled without ZMQREACTOR_STATS
+     * (or handler is not counted)
+     */
+    inline
+    bool
+    handler_stats(const HandlerDesc& hd, HandlerStats& out) const
+    {
+      return stats_.snapshot(hd.stats_slot_, out);
+    }
   };
 
   /////////////////////// implementation /////////////////////
 
+  inline
+  LibEventBase::HandlerDesc::HandlerDesc(HandlerInfo* hi) :
+    hi_(hi), stats_slot_(hi ? hi->stats_slot_ : -1)
+  {}
+
   LibEvent::HandlerQueue&
   LibEvent::get_queue(HandlerInfo* hi)
   {
     switch (hi->status_)
     {
     case HandlerInfo::TRIGGERED:
-      return triggered_handlers_;
+      return triggered_handlers_[hi->priority_];
     case HandlerInfo::WAITING:
     default:
       return waiting_handlers_;
@@ -349,17 +696,37 @@ namespace ZmqReactor
       ((events & ZMQ_POLLERR) ? Poll::ERR : 0);
   }
 
+  template <typename FunT>
+  LibEvent::HandlerInfo*
+  LibEvent::new_handler(const FunT& fun, short expected_events)
+  {
+    void* p = pool_.allocate();
+    HandlerInfo* hi;
+    try
+    {
+      hi = new (p) HandlerInfo(this, fun, expected_events);
+    }
+    catch (...)
+    {
+      pool_.deallocate(p);
+      throw;
+    }
+    hi->stats_slot_ = stats_.acquire_slot();
+    return hi;
+  }
+
   template <typename FunT>
   LibEvent::HandlerDesc
   LibEvent::add_handler(zmq::socket_t& socket, short events, const FunT& fun)
   {
     const int fd = fd_by_sock(socket);
 
-    HandlerInfo* hi = new HandlerInfo(this, fun, events);
+    HandlerInfo* hi = new_handler(fun, events);
     hi->arg_.fd = fd;
     hi->arg_.socket = &socket;
 
     do_add_handler(hi, events_to_libev(events, true, true));
+    index_.insert(IndexMap::socket_key(&socket), hi);
     return HandlerDesc(hi);
   }
 
@@ -367,11 +734,12 @@ namespace ZmqReactor
   LibEvent::HandlerDesc
   LibEvent::add_handler(int fd, short events, const FunT& fun)
   {
-    HandlerInfo* hi = new HandlerInfo(this, fun, events);
+    HandlerInfo* hi = new_handler(fun, events);
 
     hi->arg_.fd = fd;
     hi->arg_.socket = 0;
     do_add_handler(hi, events_to_libev(events));
+    index_.insert(IndexMap::fd_key(fd), hi);
     return HandlerDesc(hi);
   }
 
@@ -380,7 +748,7 @@ namespace ZmqReactor
   LibEvent::add_timeout(
     const timeval& tv, const FunT& fun, bool persistent)
   {
-    HandlerInfo* hi = new HandlerInfo(this, fun, 0);
+    HandlerInfo* hi = new_handler(fun, 0);
 
     hi->arg_.fd = 0;
     hi->arg_.socket = 0;
@@ -403,6 +771,21 @@ namespace ZmqReactor
     tv.tv_usec = 0;
     return add_timeout(tv, fun, persistent);
   }
+
+  template <typename FunT>
+  LibEvent::HandlerDesc
+  LibEvent::add_timeout_usec(long usec, const FunT& fun, bool persistent)
+  {
+    if (const timeval* common = common_timeout(usec))
+    {
+      //pointer returned by libevent must be passed as is
+      return add_timeout(*common, fun, persistent);
+    }
+    timeval tv;
+    tv.tv_sec = usec / 1000000;
+    tv.tv_usec = usec % 1000000;
+    return add_timeout(tv, fun, persistent);
+  }
 }
 
 #endif /* ZMQREACTOR_LIBEVENT_HPP_ */
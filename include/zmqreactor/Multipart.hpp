@@ -0,0 +1,249 @@
+/**
+ * @file Multipart.hpp
+ * @author askryabin
+ * @brief Multipart message received by reactor for handler
+ */
+
+#ifndef ZMQREACTOR_MULTIPART_HPP_
+#define ZMQREACTOR_MULTIPART_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/MessagePool.hpp"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief View of frames of one multipart message, received by reactor.
+   *
+   * Frames are owned by reactor and valid till handler returns.
+   * View is cheap to copy. Frames may be sent further
+   * (zmq send moves content out of frame) or moved,
+   * but must not be referenced after handler returns.
+   *
+   * Messages from ROUTER/XREP sockets (and replies for DEALER/XREQ)
+   * start with envelope: identity frames, followed by empty delimiter frame.
+   * envelope() and body() give views of them without copying.
+   * Envelope is split only for messages of these socket types:
+   * messages of other sockets may contain empty frames as data,
+   * they have no envelope and their body() is the whole message.
+   * @see add_multipart_handler of reactors
+   */
+  class Multipart
+  {
+  private:
+    zmq::message_t* const* frames_;
+
+    size_t size_;
+
+    /**
+     * Index of empty delimiter frame, size_ if there is no envelope
+     */
+    size_t delimiter_;
+
+  public:
+    Multipart() : frames_(0), size_(0), delimiter_(0) {}
+
+    /**
+     * @param envelope split envelope: delimiter is the first empty frame
+     */
+    Multipart(zmq::message_t* const* frames, size_t size, bool envelope) :
+      frames_(frames), size_(size), delimiter_(envelope ? 0 : size)
+    {
+      while (delimiter_ < size_ && frames_[delimiter_]->size() != 0)
+      {
+        ++delimiter_;
+      }
+    }
+
+    /**
+     * Number of frames
+     */
+    inline size_t
+    size() const
+    {
+      return size_;
+    }
+
+    inline bool
+    empty() const
+    {
+      return size_ == 0;
+    }
+
+    inline zmq::message_t&
+    operator[] (size_t i) const
+    {
+      return *frames_[i];
+    }
+
+    /**
+     * @brief True if message has empty delimiter frame.
+     */
+    inline bool
+    has_envelope() const
+    {
+      return delimiter_ < size_;
+    }
+
+    /**
+     * @brief Identity frames before delimiter.
+     * Empty view if there is no envelope.
+     */
+    inline Multipart
+    envelope() const
+    {
+      return has_envelope() ?
+        Multipart(frames_, delimiter_, false) : Multipart();
+    }
+
+    /**
+     * @brief Frames after delimiter.
+     * All frames if there is no envelope.
+     */
+    inline Multipart
+    body() const
+    {
+      if (!has_envelope())
+      {
+        return *this;
+      }
+      Multipart res;
+      res.frames_ = frames_ + delimiter_ + 1;
+      res.size_ = size_ - delimiter_ - 1;
+      res.delimiter_ = res.size_; //body is not split further
+      return res;
+    }
+  };
+
+  namespace Private
+  {
+    /**
+     * Do messages of socket start with envelope (ROUTER/XREP, DEALER/XREQ)
+     */
+    inline bool
+    has_envelopes(zmq::socket_t& socket)
+    {
+      int type;
+      size_t sz = sizeof(type);
+      socket.getsockopt(ZMQ_TYPE, &type, &sz);
+      return type == ZMQ_XREP || type == ZMQ_XREQ;
+    }
+
+    /**
+     * Receives all frames of message into messages from pool.
+     * Frames vector is kept between messages, so in steady state
+     * receiving does not allocate.
+     * Not thread safe.
+     */
+    class MultipartReceiver : private NonCopyable
+    {
+    private:
+      typedef std::vector<zmq::message_t*> FramesVec;
+
+      MessagePool& pool_;
+
+      FramesVec frames_;
+
+    public:
+      explicit
+      MultipartReceiver(MessagePool& pool) : pool_(pool) {}
+
+      ~MultipartReceiver()
+      {
+        release();
+      }
+
+      /**
+       * Receive all frames of message without blocking.
+       * @return false if no message is queued in socket
+       */
+      bool
+      recv(zmq::socket_t& socket)
+      {
+        while (true)
+        {
+          frames_.push_back(pool_.acquire());
+          if (!socket.recv(frames_.back(), ZMQ_NOBLOCK))
+          {
+            pool_.release(frames_.back());
+            frames_.pop_back();
+            return !frames_.empty();
+          }
+          int64_t more;
+          size_t sz = sizeof(more);
+          socket.getsockopt(ZMQ_RCVMORE, &more, &sz);
+          if (!more)
+          {
+            return true;
+          }
+        }
+      }
+
+      inline Multipart
+      view(bool envelope) const
+      {
+        return Multipart(&frames_[0], frames_.size(), envelope);
+      }
+
+      /**
+       * Return frames to pool, in reverse order:
+       * next message gets the same objects at the same positions
+       */
+      void
+      release()
+      {
+        for (FramesVec::reverse_iterator it = frames_.rbegin();
+          it != frames_.rend(); ++it)
+        {
+          pool_.release(*it);
+        }
+        frames_.clear();
+      }
+    };
+
+    /**
+     * Reactor handler: receives all frames of message
+     * and passes their view to user functor.
+     * Socket type is queried once, when handler is created.
+     * @tparam FunT functor with signature: bool (Arg, Multipart)
+     */
+    template <typename FunT>
+    struct MultipartHandler
+    {
+      MultipartReceiver* receiver;
+      FunT fun;
+      bool envelope;
+
+      MultipartHandler(
+        MultipartReceiver& r, zmq::socket_t& socket, const FunT& f) :
+        receiver(&r), fun(f), envelope(has_envelopes(socket)) {}
+
+      bool
+      operator() (Arg arg)
+      {
+        struct Guard
+        {
+          MultipartReceiver* receiver;
+
+          ~Guard()
+          {
+            receiver->release();
+          }
+        } guard = {receiver};
+
+        if (!receiver->recv(*arg.socket))
+        {
+          return true; //spurious wakeup
+        }
+        return fun(arg, receiver->view(envelope));
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_MULTIPART_HPP_ */
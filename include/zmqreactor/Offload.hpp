@@ -0,0 +1,227 @@
+/**
+ * @file Offload.hpp
+ * @author askryabin
+ * @brief Handling messages of reactor's sockets in worker pool
+ */
+
+#ifndef ZMQREACTOR_OFFLOAD_HPP_
+#define ZMQREACTOR_OFFLOAD_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/WorkerPool.hpp"
+#include "zmqreactor/OffloadMessage.hpp"
+#include "zmqreactor/details/Mailbox.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/ContextHandler.hpp"
+
+#include <vector>
+#include <deque>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Default maximum number of messages of one socket
+   * received but not handled yet by offloaded handler.
+   */
+  const size_t DEFAULT_OFFLOAD_LIMIT = 1024;
+
+  /**
+   * @brief Registers offloaded handlers: reactor only receives messages,
+   * handlers are called in worker pool.
+   *
+   * Messages of one socket are handled one by one in receiving order
+   * (by any worker), messages of different sockets are handled
+   * in parallel. So slow handlers do not delay polling of other sockets.
+   *
+   * Backpressure: when socket has limit messages in flight
+   * (received, not handled yet), its reactor handler is disabled
+   * (so messages stay queued in zmq), and enabled again when
+   * half of them are handled.
+   *
+   * \code
+   * ZmqReactor::Dynamic reactor;
+   * ZmqReactor::WorkerPool workers(4);
+   * ZmqReactor::Offload<ZmqReactor::Dynamic> offload(reactor, workers);
+   * offload.add_handler(socket, heavy_handler); //void (OffloadMessage&)
+   * reactor.run();
+   * \endcode
+   * Handlers must not use sockets of the reactor.
+   * Exception thrown by handler is caught in worker thread:
+   * message is dropped, failure is counted (see failures())
+   * and reactor's poll operation is cancelled (returns CANCELLED).
+   * Remove reactor handlers before Offload is destroyed.
+   * @tparam ReactorT reactor with post() and disable_handler/enable_handler
+   * for sockets: Dynamic, Epoll or LibEvent.
+   */
+  template <typename ReactorT>
+  class Offload : private Private::NonCopyable
+  {
+  private:
+    typedef std::vector<Private::Mailbox*> MailboxesVec;
+
+    ReactorT& reactor_;
+
+    WorkerPool& pool_;
+
+    MailboxesVec mailboxes_;
+
+    /**
+     * Context of reactor handler of socket
+     */
+    struct Source
+    {
+      Private::Mailbox* mailbox;
+      ReactorT* reactor;
+    };
+
+    /**
+     * Not reallocated: reactor handlers refer to sources
+     */
+    std::deque<Source> sources_;
+
+    /**
+     * Reactor handler: receives messages into mailbox
+     */
+    static bool
+    read(Source* source, Arg arg)
+    {
+      if (source->mailbox->receive())
+      {
+        source->reactor->disable_handler(*arg.socket);
+      }
+      return true;
+    }
+
+    typedef Private::ContextHandler<Source, &Offload::read> Reader;
+
+    /**
+     * Task posted to reactor to enable paused socket
+     */
+    struct Resume
+    {
+      ReactorT* reactor;
+      zmq::socket_t* socket;
+
+      bool
+      operator() (Arg)
+      {
+        reactor->enable_handler(*socket);
+        return true;
+      }
+    };
+
+    /**
+     * Task posted to reactor when handler fails
+     */
+    struct Cancel
+    {
+      bool
+      operator() (Arg)
+      {
+        return false;
+      }
+    };
+
+    /**
+     * Called by mailbox in worker thread when handler fails
+     */
+    struct Failer
+    {
+      ReactorT* reactor;
+
+      void
+      operator() ()
+      {
+        reactor->post(Cancel());
+      }
+    };
+
+    /**
+     * Called by mailbox in worker thread
+     */
+    struct Resumer
+    {
+      ReactorT* reactor;
+      zmq::socket_t* socket;
+
+      void
+      operator() ()
+      {
+        Resume r = {reactor, socket};
+        reactor->post(r);
+      }
+    };
+
+  public:
+    /**
+     * Enables posting to reactor (see Dynamic::enable_post).
+     */
+    Offload(ReactorT& reactor, WorkerPool& pool) :
+      reactor_(reactor), pool_(pool)
+    {
+      reactor_.enable_post();
+    }
+
+    /**
+     * Waits until all received messages are handled.
+     */
+    ~Offload()
+    {
+      for (typename MailboxesVec::iterator it = mailboxes_.begin();
+        it != mailboxes_.end(); ++it)
+      {
+        delete *it;
+      }
+    }
+
+    /**
+     * @brief Add reactor handler for socket, which receives messages
+     * and passes them to fun in worker pool.
+     * @tparam FunT functor with signature: void (OffloadMessage&);
+     * called in worker threads (one at a time for a socket).
+     * @param socket bound socket
+     * @param fun functor. Must be copyable.
+     * @param limit maximum number of messages in flight
+     */
+    template <typename FunT>
+    void
+    add_handler(
+      zmq::socket_t& socket, const FunT& fun,
+      size_t limit = DEFAULT_OFFLOAD_LIMIT)
+    {
+      Resumer resumer = {&reactor_, &socket};
+      Failer failer = {&reactor_};
+      mailboxes_.push_back(0);
+      mailboxes_.back() = new Private::Mailbox(
+        socket, Private::Mailbox::Fun(fun), pool_, limit,
+        Private::Mailbox::ResumeFun(resumer),
+        Private::Mailbox::ErrorFun(failer));
+
+      const Source source = {mailboxes_.back(), &reactor_};
+      sources_.push_back(source);
+      const Reader r = {&sources_.back()};
+      reactor_.add_handler(socket, Poll::IN, r);
+    }
+
+    /**
+     * Get number of messages of n-th added socket in flight
+     */
+    inline size_t
+    in_flight(size_t n)
+    {
+      return mailboxes_[n]->in_flight();
+    }
+
+    /**
+     * Get number of messages of n-th added socket,
+     * handler threw exception on
+     */
+    inline size_t
+    failures(size_t n)
+    {
+      return mailboxes_[n]->failures();
+    }
+  };
+}
+
+#endif /* ZMQREACTOR_OFFLOAD_HPP_ */
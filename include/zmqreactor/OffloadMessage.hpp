@@ -0,0 +1,84 @@
+/**
+ * @file OffloadMessage.hpp
+ * @author askryabin
+ * @brief Message received by reactor for offloaded handler
+ */
+
+#ifndef ZMQREACTOR_OFFLOADMESSAGE_HPP_
+#define ZMQREACTOR_OFFLOADMESSAGE_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <vector>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief All parts of one (multipart) zmq message,
+   * received in reactor thread and handled in worker thread.
+   * @see Offload
+   */
+  class OffloadMessage : private Private::NonCopyable
+  {
+  private:
+    typedef std::vector<zmq::message_t*> PartsVec;
+
+    PartsVec parts_;
+
+    zmq::socket_t* socket_;
+
+  public:
+    explicit
+    OffloadMessage(zmq::socket_t* socket) : socket_(socket) {}
+
+    ~OffloadMessage()
+    {
+      for (PartsVec::iterator it = parts_.begin(); it != parts_.end(); ++it)
+      {
+        delete *it;
+      }
+    }
+
+    /**
+     * Receive all parts of message without blocking.
+     * @return false if no message is queued in socket
+     */
+    bool
+    recv(zmq::socket_t& socket);
+
+    /**
+     * Socket message has been received from.
+     * Must not be used in worker thread (zmq sockets are not thread safe),
+     * only to tell sources apart.
+     */
+    inline zmq::socket_t*
+    socket() const
+    {
+      return socket_;
+    }
+
+    /**
+     * Number of parts
+     */
+    inline size_t
+    size() const
+    {
+      return parts_.size();
+    }
+
+    inline zmq::message_t&
+    operator[] (size_t i)
+    {
+      return *parts_[i];
+    }
+
+    inline const zmq::message_t&
+    operator[] (size_t i) const
+    {
+      return *parts_[i];
+    }
+  };
+}
+
+#endif /* ZMQREACTOR_OFFLOADMESSAGE_HPP_ */
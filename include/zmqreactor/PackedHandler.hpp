@@ -0,0 +1,128 @@
+/**
+ * @file PackedHandler.hpp
+ * @author askryabin
+ * @brief Non-owning handler of two pointers: {thunk, context}
+ */
+
+#ifndef ZMQREACTOR_PACKEDHANDLER_HPP_
+#define ZMQREACTOR_PACKEDHANDLER_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/ContextHandler.hpp"
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Packed handler record: pointer to thunk function
+   * and pointer to its context.
+   *
+   * Handler type for \ref BasicDynamic with the most compact layout:
+   * four handlers share one cache line, and calling a handler touches
+   * only its record and the context object.
+   * \code
+   * ZmqReactor::BasicDynamic<ZmqReactor::PackedHandler> r;
+   * r.add_handler(sock, &free_function);
+   * r.add_handler(sock2,
+   *   ZmqReactor::PackedHandler::bind<Session, &Session::on_read>(session));
+   * \endcode
+   * Does not own context: bound objects must outlive the handler.
+   * Internal handlers of reactor (enable_post, add_send_queue,
+   * add_signal_handler) refer to reactor's objects the same way,
+   * but add_recv_handler and add_multipart_handler wrap functors
+   * and need owning handler type.
+   */
+  class PackedHandler
+  {
+  public:
+    typedef bool (*Thunk)(void* ctx, Arg arg);
+
+    typedef bool (*FunPtr)(Arg arg);
+
+  private:
+    Thunk thunk_;
+    void* ctx_;
+
+    static bool
+    call_fun(void* ctx, Arg arg)
+    {
+      return reinterpret_cast<FunPtr>(ctx)(arg);
+    }
+
+    template <typename Cls, bool (Cls::*Method)(Arg)>
+    static bool
+    call_method(void* ctx, Arg arg)
+    {
+      return (static_cast<Cls*>(ctx)->*Method)(arg);
+    }
+
+    template <typename FunT>
+    static bool
+    call_functor(void* ctx, Arg arg)
+    {
+      return (*static_cast<FunT*>(ctx))(arg);
+    }
+
+    template <typename Ctx, bool (*Fun)(Ctx*, Arg)>
+    static bool
+    call_context(void* ctx, Arg arg)
+    {
+      return Fun(static_cast<Ctx*>(ctx), arg);
+    }
+
+  public:
+    PackedHandler() : thunk_(0), ctx_(0) {}
+
+    PackedHandler(Thunk thunk, void* ctx) : thunk_(thunk), ctx_(ctx) {}
+
+    /**
+     * Free function handler
+     */
+    PackedHandler(FunPtr fun) :
+      thunk_(&call_fun), ctx_(reinterpret_cast<void*>(fun))
+    {}
+
+    /**
+     * Internal handler of reactor (post queue, send queue, signals):
+     * its context is referenced, as by bind
+     */
+    template <typename Ctx, bool (*Fun)(Ctx*, Arg)>
+    PackedHandler(const Private::ContextHandler<Ctx, Fun>& fun) :
+      thunk_(&call_context<Ctx, Fun>), ctx_(fun.ctx)
+    {}
+
+    /**
+     * Member function handler of object obj, i.e.
+     * PackedHandler::bind<Session, &Session::on_read>(session)
+     */
+    template <typename Cls, bool (Cls::*Method)(Arg)>
+    static PackedHandler
+    bind(Cls& obj)
+    {
+      return PackedHandler(&call_method<Cls, Method>, &obj);
+    }
+
+    /**
+     * Handler calling functor by reference
+     */
+    template <typename FunT>
+    static PackedHandler
+    ref(FunT& fun)
+    {
+      return PackedHandler(&call_functor<FunT>, &fun);
+    }
+
+    inline bool
+    empty() const
+    {
+      return !thunk_;
+    }
+
+    inline bool
+    operator() (Arg arg) const
+    {
+      return thunk_(ctx_, arg);
+    }
+  };
+}
+
+#endif /* ZMQREACTOR_PACKEDHANDLER_HPP_ */
@@ -0,0 +1,457 @@
+/**
+ * @file ReactorPool.hpp
+ * @author askryabin
+ * @brief Pool of reactor threads with sharded handlers
+ */
+
+#ifndef ZMQREACTOR_REACTORPOOL_HPP_
+#define ZMQREACTOR_REACTORPOOL_HPP_
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/ContextHandler.hpp"
+#include "zmqreactor/details/Atomic.hpp"
+
+#include <vector>
+#include <cerrno>
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Pool of threads, each running its own reactor (shard).
+   *
+   * Handlers are assigned to shards by policy when added,
+   * all handlers of one socket should be added to the same shard.
+   * Handlers must be added while pool is not running
+   * (sockets are then used by shard threads only).
+   * Pool finishes when some handler cancels processing
+   * (by returning false) or fails, when timeout expires in all shards,
+   * or when stop() is called.
+   *
+   * Each shard reactor has one internal handler (added first),
+   * which wakes it up on stop().
+   * @tparam ReactorT reactor type with add_handler(fd, events, fun)
+   * and run(timeout), i.e. Dynamic, Epoll or LibEvent.
+   */
+  template <typename ReactorT = Dynamic>
+  class BasicReactorPool : private Private::NonCopyable
+  {
+  public:
+    enum ShardPolicy
+    {
+      /**
+       * Shard is chosen by hash of socket address (or descriptor)
+       */
+      HASH,
+      /**
+       * Shard with the least number of handlers is chosen
+       */
+      LEAST_LOADED
+    };
+
+  private:
+    struct Shard;
+
+    static bool
+    stop_shard(Shard* shard, Arg)
+    {
+      uint64_t val;
+      while (::read(shard->stop_fd, &val, sizeof(val)) > 0)
+      {}
+      return false;
+    }
+
+    typedef Private::ContextHandler<Shard, &BasicReactorPool::stop_shard>
+      StopHandler;
+
+    struct Shard
+    {
+      BasicReactorPool* pool;
+      size_t index;
+      ReactorT reactor;
+      int stop_fd;
+      size_t load;
+      pthread_t thread;
+      PollResult result;
+
+      Shard(BasicReactorPool* p, size_t idx) :
+        pool(p), index(idx), stop_fd(::eventfd(0, EFD_NONBLOCK)), load(0),
+        result(NONE_MATCHED)
+      {
+        if (stop_fd == -1)
+        {
+          throw zmq::error_t();
+        }
+        StopHandler h = {this};
+        reactor.add_handler(stop_fd, Poll::IN, h);
+      }
+
+      ~Shard()
+      {
+        ::close(stop_fd);
+      }
+    };
+
+    typedef std::vector<Shard*> ShardsVec;
+
+    ShardsVec shards_;
+
+    ShardPolicy policy_;
+
+    bool pin_;
+
+    long timeout_;
+
+    bool running_;
+
+    int stopping_;
+
+    static void*
+    run_shard(void* arg);
+
+    size_t
+    select_shard(size_t key) const;
+
+    static inline size_t
+    hash(size_t key)
+    {
+      //fibonacci hashing: spreads aligned addresses
+      return (key >> 4) * static_cast<size_t>(0x9E3779B97F4A7C15ULL);
+    }
+
+  public:
+
+    /**
+     * @param num_threads number of shards (threads),
+     * 0 for number of online processors
+     * @param policy how shards are chosen for new handlers
+     * @param pin if true, thread of shard i is pinned to processor
+     * i (modulo number of processors)
+     */
+    explicit
+    BasicReactorPool(
+      size_t num_threads = 0, ShardPolicy policy = LEAST_LOADED,
+      bool pin = false);
+
+    ~BasicReactorPool();
+
+    inline size_t
+    num_shards() const
+    {
+      return shards_.size();
+    }
+
+    /**
+     * Get reactor of shard, i.e. to add timeouts.
+     * Must not be modified while pool is running.
+     */
+    inline ReactorT&
+    reactor(size_t shard)
+    {
+      return shards_[shard]->reactor;
+    }
+
+    /**
+     * Get number of handlers added to shard through the pool
+     */
+    inline size_t
+    load(size_t shard) const
+    {
+      return shards_[shard]->load;
+    }
+
+    /**
+     * @brief Add poll handler for zmq socket to the shard chosen by policy.
+     * @see Dynamic::add_handler
+     * @return shard index
+     */
+    template <typename FunT>
+    size_t
+    add_handler(zmq::socket_t& socket, short events, const FunT& fun)
+    {
+      return add_handler_to(
+        select_shard(reinterpret_cast<size_t>(&socket)), socket, events, fun);
+    }
+
+    /**
+     * @overload
+     * Overload for events = Poll::IN
+     */
+    template <typename FunT>
+    inline size_t
+    add_handler(zmq::socket_t& socket, const FunT& fun)
+    {
+      return add_handler(socket, Poll::IN, fun);
+    }
+
+    /**
+     * @brief Add poll handler for file descriptor to the shard chosen by policy.
+     * @return shard index
+     */
+    template <typename FunT>
+    size_t
+    add_handler(int fd, short events, const FunT& fun)
+    {
+      return add_handler_to(
+        select_shard(static_cast<size_t>(fd) << 4), fd, events, fun);
+    }
+
+    /**
+     * @brief Add poll handler for zmq socket to given shard.
+     * @return shard index
+     */
+    template <typename FunT>
+    size_t
+    add_handler_to(
+      size_t shard, zmq::socket_t& socket, short events, const FunT& fun)
+    {
+      shards_[shard]->reactor.add_handler(socket, events, fun);
+      ++shards_[shard]->load;
+      return shard;
+    }
+
+    /**
+     * @brief Add poll handler for file descriptor to given shard.
+     * @return shard index
+     */
+    template <typename FunT>
+    size_t
+    add_handler_to(size_t shard, int fd, short events, const FunT& fun)
+    {
+      shards_[shard]->reactor.add_handler(fd, events, fun);
+      ++shards_[shard]->load;
+      return shard;
+    }
+
+    /**
+     * @brief Start shard threads, each polls its reactor with timeout.
+     * @param timeout timeout in microseconds. No timeout by default
+     */
+    void
+    start(long timeout = -1);
+
+    /**
+     * @brief Request all shards to finish. May be called from any thread
+     * (including handlers). Does not wait for them: see join().
+     */
+    void
+    stop();
+
+    /**
+     * @brief Wait until all shards finish.
+     * @return aggregated result of shards:
+     * ERROR if any shard failed, otherwise CANCELLED if processing
+     * has been cancelled (by handler or stop()), otherwise OK
+     * if any handler has been called, NONE_MATCHED otherwise.
+     */
+    PollResult
+    join();
+
+    /**
+     * @brief Start shards and wait until they finish.
+     * @see start, join
+     */
+    inline PollResult
+    run(long timeout = -1)
+    {
+      start(timeout);
+      return join();
+    }
+
+    inline bool
+    running() const
+    {
+      return running_;
+    }
+
+    /**
+     * Get result of the last run of the shard
+     */
+    inline PollResult
+    result(size_t shard) const
+    {
+      return shards_[shard]->result;
+    }
+  };
+
+  /**
+   * @brief Pool of Dynamic reactors
+   */
+  typedef BasicReactorPool<> ReactorPool;
+
+  /////////////////////// implementation /////////////////////
+
+  template <typename ReactorT>
+  BasicReactorPool<ReactorT>::BasicReactorPool(
+    size_t num_threads, ShardPolicy policy, bool pin) :
+    policy_(policy), pin_(pin), timeout_(-1), running_(false), stopping_(0)
+  {
+    if (!num_threads)
+    {
+      const long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+      num_threads = (cpus > 0) ? cpus : 1;
+    }
+    shards_.reserve(num_threads);
+    try
+    {
+      for (size_t i = 0; i < num_threads; ++i)
+      {
+        shards_.push_back(new Shard(this, i));
+      }
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < shards_.size(); ++i)
+      {
+        delete shards_[i];
+      }
+      throw;
+    }
+  }
+
+  template <typename ReactorT>
+  BasicReactorPool<ReactorT>::~BasicReactorPool()
+  {
+    if (running_)
+    {
+      stop();
+      join();
+    }
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      delete shards_[i];
+    }
+  }
+
+  template <typename ReactorT>
+  size_t
+  BasicReactorPool<ReactorT>::select_shard(size_t key) const
+  {
+    if (policy_ == HASH)
+    {
+      return hash(key) % shards_.size();
+    }
+    size_t best = 0;
+    for (size_t i = 1; i < shards_.size(); ++i)
+    {
+      if (shards_[i]->load < shards_[best]->load)
+      {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  template <typename ReactorT>
+  void*
+  BasicReactorPool<ReactorT>::run_shard(void* arg)
+  {
+    Shard* shard = static_cast<Shard*>(arg);
+    BasicReactorPool* pool = shard->pool;
+
+    if (pool->pin_)
+    {
+      const long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(shard->index % ((cpus > 0) ? cpus : 1), &set);
+      ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    }
+
+    shard->result = shard->reactor.run(pool->timeout_);
+
+    if (shard->result != OK && shard->result != NONE_MATCHED &&
+      !Private::relaxed_load(pool->stopping_))
+    {
+      //finished by itself (cancelled or failed): stop others too
+      pool->stop();
+    }
+    return 0;
+  }
+
+  template <typename ReactorT>
+  void
+  BasicReactorPool<ReactorT>::start(long timeout)
+  {
+    if (running_)
+    {
+      return;
+    }
+    timeout_ = timeout;
+    Private::relaxed_store(stopping_, 0);
+
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      //forget stop requests of previous run
+      uint64_t val;
+      while (::read(shards_[i]->stop_fd, &val, sizeof(val)) > 0)
+      {}
+      shards_[i]->result = NONE_MATCHED;
+    }
+
+    running_ = true;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      const int err =
+        ::pthread_create(&shards_[i]->thread, 0, &run_shard, shards_[i]);
+      if (err)
+      {
+        //stop and wait already started ones
+        stop();
+        for (size_t j = 0; j < i; ++j)
+        {
+          ::pthread_join(shards_[j]->thread, 0);
+        }
+        running_ = false;
+        errno = err;
+        throw zmq::error_t();
+      }
+    }
+  }
+
+  template <typename ReactorT>
+  void
+  BasicReactorPool<ReactorT>::stop()
+  {
+    Private::relaxed_store(stopping_, 1);
+    const uint64_t val = 1;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      ssize_t res = ::write(shards_[i]->stop_fd, &val, sizeof(val));
+      (void)res;
+    }
+  }
+
+  template <typename ReactorT>
+  PollResult
+  BasicReactorPool<ReactorT>::join()
+  {
+    if (!running_)
+    {
+      return NONE_MATCHED;
+    }
+
+    //rank of results: NONE_MATCHED < OK < CANCELLED < ERROR
+    static const int RANKS[] = {3, 0, 2, 1}; //ERROR, NONE_MATCHED, CANCELLED, OK
+
+    PollResult res = NONE_MATCHED;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      ::pthread_join(shards_[i]->thread, 0);
+      if (RANKS[shards_[i]->result] > RANKS[res])
+      {
+        res = shards_[i]->result;
+      }
+    }
+    running_ = false;
+    return res;
+  }
+}
+
+#endif /* ZMQREACTOR_REACTORPOOL_HPP_ */
@@ -0,0 +1,235 @@
+/**
+ * @file SendQueue.hpp
+ * @author askryabin
+ * @brief Outbound messages queue of zmq socket, flushed by reactor
+ */
+
+#ifndef ZMQREACTOR_SENDQUEUE_HPP_
+#define ZMQREACTOR_SENDQUEUE_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/ContextHandler.hpp"
+#include "zmqreactor/details/MessagePool.hpp"
+
+#include <deque>
+#include <vector>
+#include <tr1/functional>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Default high watermark of SendQueue (number of messages parts).
+   */
+  const size_t DEFAULT_SEND_QUEUE_LIMIT = 1000;
+
+  /**
+   * @brief Outbound messages of zmq socket, sent when socket is writable.
+   *
+   * Created by reactor (add_send_queue), lives as long as reactor.
+   * send() never blocks: message is sent at once if nothing is queued
+   * and socket accepts it, otherwise it is queued and reactor polls
+   * socket for ZMQ_POLLOUT (only while queue is not empty), then flushes
+   * queue with ZMQ_NOBLOCK sends, up to batch limit messages per event.
+   *
+   * When number of queued messages reaches high watermark,
+   * backpressure callback is called with true (producers should slow down),
+   * when queue is drained to low watermark, it is called with false.
+   * Messages are never dropped.
+   * Not thread safe: used in reactor's thread.
+   */
+  class SendQueue : private Private::NonCopyable
+  {
+  public:
+    /**
+     * Called with true when queue becomes congested,
+     * with false when it is drained to low watermark.
+     */
+    typedef std::tr1::function<void (SendQueue&, bool)> BackpressureFun;
+
+    /**
+     * Set by reactor: called with true to start polling socket for
+     * ZMQ_POLLOUT, with false to stop.
+     */
+    typedef std::tr1::function<void (bool)> InterestFun;
+
+    SendQueue(
+      zmq::socket_t& socket, size_t high_watermark,
+      const BackpressureFun& backpressure);
+
+    ~SendQueue();
+
+    /**
+     * @brief Send message part or queue it, does not block.
+     *
+     * Message content is moved out of msg (as zmq send does).
+     * @param flags 0 or ZMQ_SNDMORE
+     * @return false if queue is congested (at or above high watermark)
+     */
+    bool
+    send(zmq::message_t& msg, int flags = 0);
+
+    /**
+     * Send queued messages while socket accepts them,
+     * up to batch limit. Called by reactor.
+     * @return true if queue is empty
+     */
+    bool
+    flush();
+
+    inline zmq::socket_t&
+    socket() const
+    {
+      return *socket_;
+    }
+
+    /**
+     * @brief Number of queued message parts
+     */
+    inline size_t
+    size() const
+    {
+      return queue_.size();
+    }
+
+    inline bool
+    empty() const
+    {
+      return queue_.empty();
+    }
+
+    inline bool
+    congested() const
+    {
+      return congested_;
+    }
+
+    /**
+     * @param high number of queued parts to call backpressure callback at.
+     * @param low number of queued parts to release backpressure at.
+     * Half of high watermark by default.
+     */
+    void
+    set_watermarks(size_t high, size_t low);
+
+    inline size_t
+    high_watermark() const
+    {
+      return high_;
+    }
+
+    inline size_t
+    low_watermark() const
+    {
+      return low_;
+    }
+
+    /**
+     * Set maximum number of message parts sent by one flush
+     */
+    inline void
+    set_batch_limit(size_t limit)
+    {
+      batch_limit_ = limit ? limit : 1;
+    }
+
+    inline size_t
+    batch_limit() const
+    {
+      return batch_limit_;
+    }
+
+    /**
+     * Set by reactor
+     */
+    inline void
+    set_interest(const InterestFun& interest)
+    {
+      interest_ = interest;
+    }
+
+  private:
+    struct Entry
+    {
+      zmq::message_t* msg;
+      int flags;
+    };
+
+    zmq::socket_t* socket_;
+
+    std::deque<Entry> queue_;
+
+    /**
+     * Queued message objects are reused
+     */
+    Private::MessagePool pool_;
+
+    size_t high_;
+
+    size_t low_;
+
+    size_t batch_limit_;
+
+    bool congested_;
+
+    BackpressureFun backpressure_;
+
+    InterestFun interest_;
+  };
+
+  namespace Private
+  {
+    inline bool
+    flush_send_queue(SendQueue* queue, Arg)
+    {
+      queue->flush();
+      return true;
+    }
+
+    /**
+     * Reactor handler flushing send queue on ZMQ_POLLOUT
+     */
+    typedef ContextHandler<SendQueue, &flush_send_queue> SendQueueFlusher;
+
+    /**
+     * Send queues, owned by reactor
+     */
+    class SendQueues : private NonCopyable
+    {
+    private:
+      typedef std::vector<SendQueue*> QueuesVec;
+
+      QueuesVec queues_;
+
+    public:
+      SendQueues() {}
+
+      ~SendQueues()
+      {
+        for (QueuesVec::iterator it = queues_.begin();
+          it != queues_.end(); ++it)
+        {
+          delete *it;
+        }
+      }
+
+      SendQueue&
+      add(zmq::socket_t& socket, size_t high_watermark,
+        const SendQueue::BackpressureFun& backpressure)
+      {
+        queues_.reserve(queues_.size() + 1);
+        queues_.push_back(
+          new SendQueue(socket, high_watermark, backpressure));
+        return *queues_.back();
+      }
+
+      inline size_t
+      size() const
+      {
+        return queues_.size();
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_SENDQUEUE_HPP_ */
@@ -9,9 +9,15 @@
 
 #include "zmqreactor/details/Base.hpp"
 
-#include <tr1/tuple>
 #include <memory>
 
+#ifdef ZMQREACTOR_HAS_VARIADIC
+# include <tuple>
+# include <utility>
+#else
+# include <tr1/tuple>
+#endif
+
 namespace ZmqReactor
 {
   class StaticReactorBase;
@@ -38,6 +44,15 @@ namespace ZmqReactor
   class StaticReactorBase : protected Private::ReactorBase
   {
   public:
+    using Private::ReactorBase::set_batch_limit;
+    using Private::ReactorBase::batch_limit;
+    using Private::ReactorBase::stats;
+    using Private::ReactorBase::add_timeout;
+    using Private::ReactorBase::cancel_timeout;
+    using Private::ReactorBase::num_timeouts;
+    using Private::ReactorBase::set_busy_poll;
+    using Private::ReactorBase::busy_poll;
+    using Private::ReactorBase::busy_poll_stats;
     /**
      * @brief Perform poll operations.
      *
@@ -81,6 +96,23 @@ namespace ZmqReactor
       r->add_socket(socket, events);
     }
 
+#ifdef ZMQREACTOR_HAS_VARIADIC
+    /**
+     * Compile-time sequence of poll item indexes
+     */
+    template <int... Nums>
+    struct IndexSeq {};
+
+    template <int N, int... Nums>
+    struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, Nums...> {};
+
+    template <int... Nums>
+    struct MakeIndexSeq<0, Nums...>
+    {
+      typedef IndexSeq<Nums...> type;
+    };
+#endif
+
     /**
      * @brief Concrete static reactor parameterized with tuple of handlers.
      *
@@ -103,6 +135,31 @@ namespace ZmqReactor
 
     private:
 
+#ifdef ZMQREACTOR_HAS_VARIADIC
+      /**
+       * Calls handler at offset Num.
+       * @return false if handler cancelled processing
+       */
+      typedef bool (*Dispatcher)(self& r);
+
+      template <int Num>
+      static bool
+      dispatch(self& r)
+      {
+        return r.call_handler(std::get<Num>(r.fun_tuple_), Num);
+      }
+
+      /**
+       * @brief Compile-time table of dispatchers indexed by poll item.
+       */
+      template <int... Nums>
+      static const Dispatcher*
+      dispatch_table(IndexSeq<Nums...>)
+      {
+        static constexpr Dispatcher table[] = {&self::dispatch<Nums>...};
+        return table;
+      }
+#else
       template <typename ReactorT, int TermSize, int Num>
       friend struct Caller;
 
@@ -113,8 +170,11 @@ namespace ZmqReactor
       template <typename ReactorT, int TermSize, int Num>
       struct Caller
       {
+        /**
+         * @param prio priority class of handlers to call, -1 for all
+         */
         inline static PollResult
-        call(self& r);
+        call(self& r, int prio);
       };
 
       /**
@@ -125,16 +185,28 @@ namespace ZmqReactor
       struct Caller<ReactorT, TermSize, TermSize>
       {
         inline static PollResult
-        call(self& r)
+        call(self& r, int prio)
         {
           return OK;
         }
       };
+#endif
 
     protected:
 
       virtual PollResult
-      poll(long timeout = -1);
+      poll(long timeout = -1)
+      {
+        Timer timer(timeout);
+        return poll(timer);
+      }
+
+    private:
+      /**
+       * One poll operation, waiting not longer than remaining time of timer
+       */
+      PollResult
+      poll(Timer& timer);
     };
   }
 
@@ -145,6 +217,111 @@ namespace ZmqReactor
 
   ///static reactor makers
 
+#ifdef ZMQREACTOR_HAS_VARIADIC
+  namespace Private
+  {
+    /**
+     * Socket and events of one handler, collected by make_static
+     */
+    struct StaticItem
+    {
+      zmq::socket_t* socket;
+      short events;
+    };
+
+    typedef std::vector<StaticItem> StaticItemsVec;
+
+    template <typename... Funs>
+    inline
+    StaticPtr
+    build_static(StaticItemsVec& items, std::tuple<Funs...>&& funs)
+    {
+      typedef std::tuple<Funs...> tuple_t;
+      StaticPtr p(
+        new StaticReactor<tuple_t, sizeof...(Funs)>(std::move(funs))
+      );
+      for (StaticItemsVec::const_iterator it = items.begin();
+        it != items.end(); ++it)
+      {
+        add_socket(p.get(), *it->socket, it->events);
+      }
+      return p;
+    }
+
+    /**
+     * socket, handler, events, ...
+     */
+    template <typename... Funs, typename Fun, typename... Rest>
+    inline
+    StaticPtr
+    build_static(
+      StaticItemsVec& items, std::tuple<Funs...>&& funs,
+      zmq::socket_t& s, Fun fun, short events, Rest&&... rest)
+    {
+      StaticItem item = {&s, events};
+      items.push_back(item);
+      return build_static(
+        items, std::tuple_cat(std::move(funs), std::make_tuple(fun)),
+        std::forward<Rest>(rest)...);
+    }
+
+    /**
+     * socket, handler, next socket, ... (events = ZMQ_POLLIN)
+     */
+    template <typename... Funs, typename Fun, typename... Rest>
+    inline
+    StaticPtr
+    build_static(
+      StaticItemsVec& items, std::tuple<Funs...>&& funs,
+      zmq::socket_t& s, Fun fun, zmq::socket_t& next, Rest&&... rest)
+    {
+      StaticItem item = {&s, ZMQ_POLLIN};
+      items.push_back(item);
+      return build_static(
+        items, std::tuple_cat(std::move(funs), std::make_tuple(fun)),
+        next, std::forward<Rest>(rest)...);
+    }
+
+    /**
+     * last socket, handler (events = ZMQ_POLLIN)
+     */
+    template <typename... Funs, typename Fun>
+    inline
+    StaticPtr
+    build_static(
+      StaticItemsVec& items, std::tuple<Funs...>&& funs,
+      zmq::socket_t& s, Fun fun)
+    {
+      StaticItem item = {&s, ZMQ_POLLIN};
+      items.push_back(item);
+      return build_static(
+        items, std::tuple_cat(std::move(funs), std::make_tuple(fun)));
+    }
+  }
+
+  /**
+   * Create static reactor for given sockets, handlers and ZMQ events.
+   * Takes any number of groups: socket, handler[, events].
+   * Events may be omitted, ZMQ_POLLIN is used then.
+   * Handler functor must be of signature bool (Arg)
+   * \code
+   * make_static(s1, fun1, ZMQ_POLLOUT, s2, fun2, s3, fun3, ZMQ_POLLIN);
+   * \endcode
+   * @return auto-pointer to dynamically allocated concrete reactor.
+   */
+  template <typename Fun1, typename... Rest>
+  inline
+  StaticPtr
+  make_static(zmq::socket_t& s1, Fun1 fun1, Rest&&... rest)
+  {
+    Private::StaticItemsVec items;
+    items.reserve(1 + sizeof...(Rest) / 2);
+    return Private::build_static(
+      items, std::tuple<>(), s1, fun1, std::forward<Rest>(rest)...);
+  }
+#else
+  ///static reactor makers
+
   /**
    * Create static reactor for given sockets, handlers and ZMQ events.
    * Handler functor must be of signature bool (Arg)
@@ -329,6 +506,7 @@ namespace ZmqReactor
   }
 
   //TODO copy make_static functions for more arguments if needed
+#endif
 }
 
 #include "zmqreactor/details/StaticImpl.hpp"
@@ -0,0 +1,108 @@
+/**
+ * @file Stats.hpp
+ * @author askryabin
+ * @brief Reactors' instrumentation counters
+ *
+ * Counters are collected only if library and application are compiled
+ * with ZMQREACTOR_STATS macro defined
+ * (cmake -DZMQREACTOR_STATS=ON), otherwise collecting costs nothing.
+ */
+
+#ifndef ZMQREACTOR_STATS_HPP_
+#define ZMQREACTOR_STATS_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Number of buckets in handler duration histogram.
+   *
+   * Bucket i counts calls lasting [2^i, 2^(i+1)) nanoseconds,
+   * last bucket counts all longer calls.
+   */
+  const int STATS_BUCKETS = 32;
+
+  /**
+   * @brief Counters of one handler.
+   */
+  struct HandlerStats
+  {
+    /**
+     * Number of handler calls
+     */
+    uint64_t calls;
+    /**
+     * Total time spent in handler, nanoseconds
+     */
+    uint64_t total_ns;
+    /**
+     * log2 histogram of handler call durations
+     */
+    uint64_t histogram[STATS_BUCKETS];
+  };
+
+  /**
+   * @brief Snapshot of reactor counters.
+   */
+  struct ReactorStats
+  {
+    /**
+     * Number of poll operations
+     */
+    uint64_t polls;
+    /**
+     * Number of poll operations finished by timeout
+     */
+    uint64_t timeouts;
+    /**
+     * Number of wakeups with events reported,
+     * but no handler called (no actual events)
+     */
+    uint64_t empty_wakeups;
+    /**
+     * Number of ZMQ_EVENTS queries of zmq sockets' state
+     */
+    uint64_t events_queries;
+    /**
+     * Time spent waiting in poll, nanoseconds
+     */
+    uint64_t poll_ns;
+    /**
+     * Time spent dispatching events (including handlers), nanoseconds
+     */
+    uint64_t dispatch_ns;
+    /**
+     * Counters of handlers by their index
+     * (empty for \ref LibEvent reactor, see LibEvent::handler_stats)
+     */
+    std::vector<HandlerStats> handlers;
+  };
+
+  /**
+   * @brief Counters of busy polling (see set_busy_poll of reactors).
+   *
+   * Collected in busy poll mode regardless of ZMQREACTOR_STATS.
+   * Many blocking wakeups with spin window not exhausted by timeouts
+   * mean the window is too short for the traffic, and vice versa.
+   */
+  struct BusyPollStats
+  {
+    /**
+     * Number of polls, which found events while spinning
+     */
+    uint64_t spin_hits;
+    /**
+     * Number of polls, which found events in blocking poll
+     * (after spin window has elapsed or when spinning is off)
+     */
+    uint64_t blocking_wakeups;
+    /**
+     * Current spin window, microseconds
+     */
+    long window;
+  };
+}
+
+#endif /* ZMQREACTOR_STATS_HPP_ */
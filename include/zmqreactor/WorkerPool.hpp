@@ -0,0 +1,127 @@
+/**
+ * @file WorkerPool.hpp
+ * @author askryabin
+ * @brief Pool of worker threads with work stealing
+ */
+
+#ifndef ZMQREACTOR_WORKERPOOL_HPP_
+#define ZMQREACTOR_WORKERPOOL_HPP_
+
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+
+#include <pthread.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Pool of threads executing jobs, submitted from any thread.
+   *
+   * Each worker has its own queue of jobs. Jobs submitted by a worker
+   * (i.e. job resubmitting itself) go to its own queue, other jobs
+   * are distributed round robin. Idle workers steal jobs from
+   * queues of busy ones, so one long job does not delay jobs queued
+   * after it while other workers are idle.
+   * Jobs are {function, context} records, no allocation per job
+   * (beyond queue growth).
+   * @see Offload
+   */
+  class WorkerPool : private Private::NonCopyable
+  {
+  public:
+    typedef void (*JobFun)(void* ctx);
+
+  private:
+    struct Job
+    {
+      JobFun fun;
+      void* ctx;
+    };
+
+    struct Worker
+    {
+      WorkerPool* pool;
+      size_t index;
+      pthread_t thread;
+      pthread_mutex_t lock;
+      std::deque<Job> jobs;
+    };
+
+    typedef std::vector<Worker*> WorkersVec;
+
+    WorkersVec workers_;
+
+    /**
+     * Number of submitted jobs, not taken by workers yet
+     */
+    long pending_;
+
+    /**
+     * Number of workers waiting for jobs
+     */
+    long sleeping_;
+
+    /**
+     * Number of jobs which threw exceptions
+     */
+    long failed_;
+
+    size_t next_;
+
+    bool stopping_;
+
+    pthread_mutex_t idle_lock_;
+
+    pthread_cond_t idle_cond_;
+
+    static void*
+    run_worker(void* arg);
+
+    bool
+    take(Worker* w, Job& job);
+
+    void
+    stop_and_join(size_t num_started);
+
+  public:
+    /**
+     * @param num_threads number of workers,
+     * 0 for number of online processors
+     * @throw zmq::error_t if threads can not be started
+     */
+    explicit
+    WorkerPool(size_t num_threads = 0);
+
+    /**
+     * Waits until all submitted jobs are done
+     */
+    ~WorkerPool();
+
+    inline size_t
+    num_threads() const
+    {
+      return workers_.size();
+    }
+
+    /**
+     * @brief Submit job: fun(ctx) is called in some worker thread.
+     *
+     * May be called from any thread, including workers.
+     * Exception thrown by job is caught and counted (see failed_jobs()),
+     * so jobs should handle their errors themselves.
+     */
+    void
+    submit(JobFun fun, void* ctx);
+
+    /**
+     * Number of jobs which threw exceptions
+     */
+    long
+    failed_jobs() const;
+  };
+}
+
+#endif /* ZMQREACTOR_WORKERPOOL_HPP_ */
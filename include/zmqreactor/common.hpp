@@ -9,6 +9,14 @@
 
 #include <zmq.hpp>
 
+/**
+ * Defined when compiler supports variadic templates (C++11),
+ * which enables unbounded \ref ZmqReactor::make_static "make_static".
+ */
+#if __cplusplus >= 201103L
+# define ZMQREACTOR_HAS_VARIADIC 1
+#endif
+
 namespace ZmqReactor
 {
   namespace Poll
@@ -17,10 +25,84 @@ namespace ZmqReactor
     {
       IN = 1,
       OUT = 2,
-      ERR = 4
+      ERR = 4,
+      /**
+       * Mask of actual poll events
+       */
+      EVENTS_MASK = IN | OUT | ERR,
+      /**
+       * Handler flag, not an event. May be combined with events
+       * given to add_handler (or make_static):
+       * after handler is called, reactor keeps calling it while
+       * zmq socket still reports expected events in ZMQ_EVENTS
+       * (up to reactor's batch limit calls), so queued messages
+       * are drained without a poll operation per message.
+       * Ignored for native file descriptors.
+       */
+      BATCH = 0x100,
+      /**
+       * Handler priority flag, may be combined with events:
+       * ready handlers of higher priority are called before
+       * ready handlers of lower priority (within one poll operation).
+       * Supported by Dynamic, Static and LibEvent reactors.
+       * Handlers without priority flags have normal priority.
+       */
+      HIGH_PRIORITY = 0x200,
+      /**
+       * Handler priority flag, see \ref HIGH_PRIORITY.
+       * Low priority handlers are the first to be deferred to next poll
+       * when poll's budget is exhausted (i.e. in Dynamic::FAIR mode).
+       */
+      LOW_PRIORITY = 0x400
     };
   }
 
+  /**
+   * @brief Number of handler priority classes: high, normal, low
+   */
+  const int PRIORITIES = 3;
+
+  namespace Private
+  {
+    /**
+     * Internal handler flag of send queue flushers (see SendQueue):
+     * they are not found by socket, i.e. by disable_handler
+     */
+    const short SEND_QUEUE_FLAG = 0x1000;
+
+    /**
+     * Priority class of handler by its events flags, 0 is the highest
+     */
+    inline int
+    priority_of(short events)
+    {
+      return (events & Poll::HIGH_PRIORITY) ? 0 :
+        ((events & Poll::LOW_PRIORITY) ? PRIORITIES - 1 : 1);
+    }
+  }
+
+  /**
+   * @brief Default maximum number of calls of \ref Poll::BATCH handler
+   * per one poll operation.
+   */
+  const size_t DEFAULT_BATCH_LIMIT = 64;
+
+  /**
+   * @brief Default maximum number of handler calls for one socket
+   * per poll operation in fair dispatch mode.
+   */
+  const size_t DEFAULT_FAIR_BUDGET = 8;
+
+  /**
+   * @brief Resolution of timeouts of Dynamic, Static and Epoll reactors
+   * in microseconds.
+   *
+   * They wait in zmq_poll or epoll_wait, which take milliseconds.
+   * LibEvent reactor is accurate to microseconds
+   * (see LibEvent::add_timeout_usec).
+   */
+  const long TIMEOUT_RESOLUTION = 1000;
+
   /**
    * @brief Argument passed to event handlers from reactors.
    */
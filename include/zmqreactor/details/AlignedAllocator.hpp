@@ -0,0 +1,126 @@
+/**
+ * @file AlignedAllocator.hpp
+ * @author askryabin
+ * STL allocator of aligned memory
+ */
+
+#ifndef ZMQREACTOR_ALIGNEDALLOCATOR_HPP_
+#define ZMQREACTOR_ALIGNEDALLOCATOR_HPP_
+
+#include <new>
+#include <limits>
+#include <cstddef>
+#include <cstdlib>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Size of CPU cache line
+     */
+    const size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * Allocator of memory aligned to Align bytes (power of 2,
+     * multiple of sizeof(void*)).
+     * Used to start reactors' hot arrays at cache line boundary,
+     * so neighbouring items do not share lines with unrelated data.
+     */
+    template <typename T, size_t Align = CACHE_LINE_SIZE>
+    class AlignedAllocator
+    {
+    public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+
+      template <typename U>
+      struct rebind
+      {
+        typedef AlignedAllocator<U, Align> other;
+      };
+
+      AlignedAllocator() throw() {}
+
+      AlignedAllocator(const AlignedAllocator&) throw() {}
+
+      template <typename U>
+      AlignedAllocator(const AlignedAllocator<U, Align>&) throw() {}
+
+      pointer
+      address(reference x) const
+      {
+        return &x;
+      }
+
+      const_pointer
+      address(const_reference x) const
+      {
+        return &x;
+      }
+
+      pointer
+      allocate(size_type n, const void* = 0)
+      {
+        if (n > max_size())
+        {
+          throw std::bad_alloc();
+        }
+        const size_t bytes = n * sizeof(T);
+        void* p = 0;
+        if (::posix_memalign(&p, Align, bytes ? bytes : 1))
+        {
+          throw std::bad_alloc();
+        }
+        return static_cast<pointer>(p);
+      }
+
+      void
+      deallocate(pointer p, size_type)
+      {
+        ::free(p);
+      }
+
+      size_type
+      max_size() const throw()
+      {
+        return std::numeric_limits<size_type>::max() / sizeof(T);
+      }
+
+      void
+      construct(pointer p, const T& val)
+      {
+        new (static_cast<void*>(p)) T(val);
+      }
+
+      void
+      destroy(pointer p)
+      {
+        p->~T();
+      }
+    };
+
+    template <typename T1, typename T2, size_t Align>
+    inline bool
+    operator== (
+      const AlignedAllocator<T1, Align>&, const AlignedAllocator<T2, Align>&)
+    {
+      return true;
+    }
+
+    template <typename T1, typename T2, size_t Align>
+    inline bool
+    operator!= (
+      const AlignedAllocator<T1, Align>&, const AlignedAllocator<T2, Align>&)
+    {
+      return false;
+    }
+  }
+}
+
+#endif /* ZMQREACTOR_ALIGNEDALLOCATOR_HPP_ */
@@ -0,0 +1,148 @@
+/**
+ * @file Atomic.hpp
+ * @author askryabin
+ * Minimal atomic access helpers (gcc builtins)
+ */
+
+#ifndef ZMQREACTOR_ATOMIC_HPP_
+#define ZMQREACTOR_ATOMIC_HPP_
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Load value, which may be concurrently stored by other thread.
+     * No ordering guarantees.
+     */
+    template <typename T>
+    inline
+    T
+    relaxed_load(const T& v)
+    {
+#ifdef __ATOMIC_RELAXED
+      return __atomic_load_n(&v, __ATOMIC_RELAXED);
+#else
+      return *static_cast<const volatile T*>(&v);
+#endif
+    }
+
+    /**
+     * Store value, which may be concurrently loaded by other thread.
+     * No ordering guarantees.
+     */
+    template <typename T>
+    inline
+    void
+    relaxed_store(T& v, T val)
+    {
+#ifdef __ATOMIC_RELAXED
+      __atomic_store_n(&v, val, __ATOMIC_RELAXED);
+#else
+      *static_cast<volatile T*>(&v) = val;
+#endif
+    }
+
+    /**
+     * Load value, published by release_store.
+     * Acquire ordering: sees data written before publishing.
+     */
+    template <typename T>
+    inline
+    T
+    acquire_load(const T& v)
+    {
+#ifdef __ATOMIC_ACQUIRE
+      return __atomic_load_n(&v, __ATOMIC_ACQUIRE);
+#else
+      const T res = *static_cast<const volatile T*>(&v);
+      __sync_synchronize();
+      return res;
+#endif
+    }
+
+    /**
+     * Publish value: data written before are seen by acquire_load.
+     */
+    template <typename T>
+    inline
+    void
+    release_store(T& v, T val)
+    {
+#ifdef __ATOMIC_RELEASE
+      __atomic_store_n(&v, val, __ATOMIC_RELEASE);
+#else
+      __sync_synchronize();
+      *static_cast<volatile T*>(&v) = val;
+#endif
+    }
+
+    /**
+     * Increment counter, which has single writer thread.
+     */
+    template <typename T>
+    inline
+    void
+    relaxed_add(T& v, T delta)
+    {
+      relaxed_store(v, static_cast<T>(relaxed_load(v) + delta));
+    }
+
+    /**
+     * Add delta to value, modified by many threads.
+     * Full barrier.
+     * @return new value
+     */
+    template <typename T>
+    inline
+    T
+    atomic_add(T& v, T delta)
+    {
+      return __sync_add_and_fetch(&v, delta);
+    }
+
+    /**
+     * Replace v with desired if it equals expected,
+     * otherwise load current value to expected.
+     * Release ordering on success.
+     * @return true if replaced
+     */
+    template <typename T>
+    inline
+    bool
+    compare_exchange(T& v, T& expected, T desired)
+    {
+#ifdef __ATOMIC_RELEASE
+      return __atomic_compare_exchange_n(
+        &v, &expected, desired, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+#else
+      const T prev = __sync_val_compare_and_swap(&v, expected, desired);
+      if (prev == expected)
+      {
+        return true;
+      }
+      expected = prev;
+      return false;
+#endif
+    }
+
+    /**
+     * Store val to v, return previous value.
+     * Acquire ordering: sees data released by compare_exchange.
+     */
+    template <typename T>
+    inline
+    T
+    exchange(T& v, T val)
+    {
+#ifdef __ATOMIC_ACQUIRE
+      return __atomic_exchange_n(&v, val, __ATOMIC_ACQUIRE);
+#else
+      __sync_synchronize();
+      return __sync_lock_test_and_set(&v, val);
+#endif
+    }
+  }
+}
+
+#endif /* ZMQREACTOR_ATOMIC_HPP_ */
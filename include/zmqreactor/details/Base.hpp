@@ -8,10 +8,15 @@
 #define ZMQREACTOR_BASE_HPP_
 
 #include <vector>
-#include "sys/time.h"
 
 #include <zmqreactor/common.hpp>
 #include <zmqreactor/details/NonCopyable.hpp>
+#include <zmqreactor/details/Timer.hpp>
+#include <zmqreactor/details/TimerWheel.hpp>
+#include <zmqreactor/details/AlignedAllocator.hpp>
+#include <zmqreactor/details/StatsCollector.hpp>
+#include <zmqreactor/details/HashIndex.hpp>
+#include <zmqreactor/details/BusyPoll.hpp>
 
 /**
  * @namespace ZmqReactor
@@ -35,8 +40,31 @@ namespace ZmqReactor
     private:
       const char* last_error_;
 
+      size_t batch_limit_;
+
+    protected:
+      typedef Private::Timer Timer;
+
     public:
 
+      /**
+       * Set maximum number of calls of \ref Poll::BATCH handler
+       * per one poll operation.
+       */
+      inline
+      void
+      set_batch_limit(size_t limit)
+      {
+        batch_limit_ = limit;
+      }
+
+      inline
+      size_t
+      batch_limit() const
+      {
+        return batch_limit_;
+      }
+
       /**
        * If poll operation finished with PollResult::ERROR status,
        * last error is saved and may be obtained.
@@ -48,6 +76,56 @@ namespace ZmqReactor
         return last_error_;
       }
 
+      /**
+       * Get snapshot of reactor counters.
+       * May be called from any thread while reactor polls,
+       * adds and removes handlers (without locking).
+       * Only the first 65536 handlers are counted.
+       * @return false if library is compiled without ZMQREACTOR_STATS
+       */
+      inline
+      bool
+      stats(ReactorStats& out) const
+      {
+        return stats_.snapshot(out);
+      }
+
+      /**
+       * @brief Turn busy polling on (or off).
+       *
+       * Before blocking in poll, reactor spins on non-blocking polls
+       * for spin window, so events coming soon are handled without
+       * the cost of sleeping in kernel and being woken up.
+       * Spin window adapts to recent intervals between events
+       * (see Private::BusyPoll), up to max_window.
+       * Costs CPU time: reactor's thread spins while waiting.
+       * @param max_window maximum spin window in microseconds,
+       * 0 (default) turns busy polling off
+       */
+      inline
+      void
+      set_busy_poll(long max_window)
+      {
+        busy_.set_max_window(max_window, Clock::now_usec());
+      }
+
+      inline
+      long
+      busy_poll() const
+      {
+        return busy_.max_window();
+      }
+
+      /**
+       * @brief Get counters of busy polling and current spin window.
+       */
+      inline
+      const BusyPollStats&
+      busy_poll_stats() const
+      {
+        return busy_.stats();
+      }
+
       /**
        * Replace old socket pointer to new value in all configured handlers.
        * Use it if you reopened a socket
@@ -58,37 +136,258 @@ namespace ZmqReactor
       size_t
       replace_socket(zmq::socket_t* old_ptr, zmq::socket_t* new_ptr);
 
+      /**
+       * @brief Add timeout handler.
+       *
+       * Handler is called from poll operation after timeout expires
+       * (with Arg filled with zeros). Poll waits not longer than
+       * the nearest timeout, so no separate thread is needed.
+       * Resolution is \ref TIMEOUT_RESOLUTION.
+       * @tparam FunT functor with signature: bool (Arg);
+       * returns true to continue polling, false to break.
+       * @param timeout timeout in microseconds
+       * @param fun functor. Must be copyable.
+       * @param persistent if true, handler is called every timeout
+       * microseconds until cancelled.
+       * @return handle to cancel timeout with
+       */
+      template <typename FunT>
+      TimeoutHandle
+      add_timeout(long timeout, const FunT& fun, bool persistent = false)
+      {
+        return timers_.add(
+          Clock::now_usec(), timeout, TimerWheel::Callback(fun), persistent);
+      }
+
+      /**
+       * @brief Cancel timeout, added by add_timeout.
+       * @return false if timeout has already expired or has been cancelled
+       */
+      inline bool
+      cancel_timeout(const TimeoutHandle& handle)
+      {
+        return timers_.cancel(handle);
+      }
+
+      /**
+       * @brief Get number of active timeouts
+       */
+      inline size_t
+      num_timeouts() const
+      {
+        return timers_.size();
+      }
+
     protected:
-      ReactorBase() {}
+      ReactorBase() :
+        last_error_(0), batch_limit_(DEFAULT_BATCH_LIMIT),
+        prioritized_(false),
+        timers_(TIMEOUT_RESOLUTION, Clock::now_usec())
+      {}
 
-      typedef std::vector<zmq::pollitem_t> PollItemsVec;
+      /**
+       * Dense array for zmq::poll, starting at cache line boundary
+       */
+      typedef std::vector<
+        zmq::pollitem_t, AlignedAllocator<zmq::pollitem_t> > PollItemsVec;
 
       PollItemsVec poll_items_;
 
       typedef std::vector<zmq::socket_t*> SocketsVec;
       SocketsVec sockets_;
 
+      typedef std::vector<short> FlagsVec;
+
+      /**
+       * Internal flag of disabled item
+       */
+      static const short DISABLED = 0x4000;
+
+      /**
+       * Internal flag of item, excluded from index (being removed)
+       */
+      static const short DETACHED = 0x2000;
+
+      /**
+       * Handler flags (i.e. Poll::BATCH) given with events
+       */
+      FlagsVec flags_;
+
+      typedef std::vector<int> IndexVec;
+
+      Stats stats_;
+
+      /**
+       * Indexes of items with matched events, filled by collect_ready
+       */
+      IndexVec ready_;
+
+      /**
+       * Some handler has been added with priority flag
+       */
+      bool prioritized_;
+
+      /**
+       * Scratch list for order_ready
+       */
+      IndexVec ordered_;
+
+      TimerWheel timers_;
+
+      BusyPoll busy_;
+
+      typedef HashIndex<int> IndexMap;
+
+      /**
+       * Positions of items by socket or fd
+       */
+      IndexMap index_;
+
+      /**
+       * Index key of item, IndexMap::EMPTY if detached
+       */
+      inline IndexMap::Key
+      item_key(int idx) const
+      {
+        if (flags_[idx] & DETACHED)
+        {
+          return 0;
+        }
+        return sockets_[idx] ?
+          IndexMap::socket_key(sockets_[idx]) :
+          IndexMap::fd_key(poll_items_[idx].fd);
+      }
+
       /**
        * Perform zmq poll once.
+       * Waits not longer than remaining time of timer
+       * and the nearest timeout.
+       * Timer is ticked (clock is read) only if zmq poll returns
+       * before its remaining time without events.
        * @return number of events matched.
        * -1 on poll error
-       * 0 if timeout expired and no events matched.
+       * 0 if timeout expired or some timeouts (see add_timeout) expired
+       * and no events matched.
        */
       int
-      do_poll(long timeout);
+      do_poll(Timer& timer);
+
+      /**
+       * Poll without blocking until events are found
+       * or window (in microseconds) elapses.
+       * @return number of events matched, 0 if window elapsed
+       */
+      int
+      spin(long window);
+
+      /**
+       * Fill ready_ with indexes of items with matched events.
+       * Stops as soon as all items reported by poll are seen.
+       * @param num_polled number of items with events, returned by do_poll
+       */
+      void
+      collect_ready(int num_polled);
+
+      /**
+       * Reorder ready_ by priority classes (the highest first),
+       * each class starts from the first item at or after start position,
+       * then wraps around.
+       */
+      void
+      order_ready(int start);
+
+      /**
+       * Call handlers of expired timeouts.
+       * @return number of called handlers,
+       * -1 if some handler returned false
+       */
+      inline int
+      expire_timeouts()
+      {
+        return timers_.empty() ? 0 : timers_.expire(Clock::now_usec());
+      }
 
+      /**
+       * @param fun handler, called again for batch: must stay valid
+       * if handler adds or removes handlers
+       */
       template <typename FunT>
       inline bool
       call_handler(FunT& fun, int item_num)
+      {
+        size_t calls;
+        return call_handler(
+          fun, item_num,
+          (flags_[item_num] & Poll::BATCH) ? batch_limit_ : 1, calls);
+      }
+
+      /**
+       * Call handler, then keep calling it while zmq socket
+       * reports expected events, up to limit calls in total.
+       * @param calls set to number of handler calls
+       */
+      template <typename FunT>
+      inline bool
+      call_handler(FunT& fun, int item_num, size_t limit, size_t& calls)
       {
         Arg arg = {
           sockets_[item_num],
           poll_items_[item_num].fd,
           poll_items_[item_num].revents
         };
-        return fun(arg);
+        calls = 1;
+        Stats::Stamp st = Stats::start();
+        const bool res = fun(arg);
+        stats_.handler_called(item_num, st);
+        if (!res)
+        {
+          return false;
+        }
+        if (limit > 1)
+        {
+          return call_batch(fun, item_num, limit, calls);
+        }
+        return true;
       }
 
+      /**
+       * Keep calling handler of zmq socket while it reports expected events.
+       * @param calls number of calls made, incremented
+       */
+      template <typename FunT>
+      bool
+      call_batch(FunT& fun, int item_num, size_t limit, size_t& calls)
+      {
+        for (; calls < limit; ++calls)
+        {
+          //handler may have removed or disabled itself
+          if (item_num >= static_cast<int>(sockets_.size()) ||
+            !sockets_[item_num] || !item_enabled(item_num))
+          {
+            break;
+          }
+          Arg arg = {sockets_[item_num], 0, actual_events(item_num)};
+          if (!arg.events)
+          {
+            break;
+          }
+          Stats::Stamp st = Stats::start();
+          const bool res = fun(arg);
+          stats_.handler_called(item_num, st);
+          if (!res)
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      /**
+       * Get expected events of zmq socket item, reported by ZMQ_EVENTS.
+       */
+      short
+      actual_events(int item_num);
+
       void
       add_socket(zmq::socket_t& socket, short events);
 
@@ -104,54 +403,45 @@ namespace ZmqReactor
       void
       remove_from(int idx);
 
+      /**
+       * Remove item, moving the last item to its position
+       */
+      void
+      swap_remove(int idx);
+
+      /**
+       * Exclude item from index (and socket lookup): it will be removed.
+       */
+      void
+      detach_item(int idx);
+
+      /**
+       * Stop polling item: its events are kept in flags_
+       * with DISABLED flag.
+       * @return false if already disabled
+       */
+      bool
+      disable_item(int idx);
+
+      /**
+       * Restore events of item, disabled by disable_item
+       * @return false if not disabled
+       */
+      bool
+      enable_item(int idx);
+
       inline bool
-      event_matches(PollItemsVec::const_reference item) const
+      item_enabled(int idx) const
       {
-        return (item.revents & item.events);
+        return !(flags_[idx] & DISABLED);
       }
 
-      class Timer
+      inline bool
+      event_matches(PollItemsVec::const_reference item) const
       {
-      private:
-        long remaining_;
-        struct timeval last_ev_;
-
-      public:
-
-        explicit
-        Timer(long timeout) :
-          remaining_(timeout)
-        {
-          if (remaining_ > 0)
-          {
-            ::gettimeofday(&last_ev_, 0);
-          }
-        }
-
-        void
-        tick()
-        {
-          if (remaining_ > 0)
-          {
-            struct timeval end;
-            ::gettimeofday(&end, 0);
-            struct timeval elapsed;
-            timersub(&end, &last_ev_, &elapsed);
-            remaining_ -= (elapsed.tv_sec * 1000000 + elapsed.tv_usec);
-            if (remaining_ <= 0)
-            {
-              remaining_ = 0;
-            }
-            last_ev_ = end;
-          }
-        }
+        return (item.revents & item.events);
+      }
 
-        long
-        remaining() const
-        {
-          return remaining_;
-        }
-      };
     };
   }
 }
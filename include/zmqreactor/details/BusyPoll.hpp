@@ -0,0 +1,130 @@
+/**
+ * @file BusyPoll.hpp
+ * @author askryabin
+ * Adaptive spin window of busy polling reactors
+ */
+
+#ifndef ZMQREACTOR_BUSYPOLL_HPP_
+#define ZMQREACTOR_BUSYPOLL_HPP_
+
+#include "zmqreactor/Stats.hpp"
+
+#include <stdint.h>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Spin window of busy poll, adapted to traffic.
+     * Tracks moving average (EWMA) of intervals between polls with events.
+     * Window is twice the average interval (the next event
+     * is likely to come while spinning), up to maximum window.
+     * If events come rarer than that, spinning is pointless
+     * and window is 0, until events become frequent again.
+     */
+    class BusyPoll
+    {
+    private:
+      /**
+       * Weight of new interval is 1/EWMA_WEIGHT
+       */
+      static const long EWMA_WEIGHT = 8;
+
+      long max_window_;
+
+      /**
+       * Average interval between polls with events, microseconds,
+       * multiplied by EWMA_WEIGHT (to not lose precision)
+       */
+      long scaled_average_;
+
+      uint64_t last_event_;
+
+      BusyPollStats stats_;
+
+      inline void
+      update_window()
+      {
+        const long window = 2 * scaled_average_ / EWMA_WEIGHT;
+        stats_.window = (window <= max_window_) ? window : 0;
+      }
+
+    public:
+      BusyPoll() : max_window_(0), scaled_average_(0), last_event_(0)
+      {
+        stats_.spin_hits = 0;
+        stats_.blocking_wakeups = 0;
+        stats_.window = 0;
+      }
+
+      /**
+       * @param max_window maximum spin window, microseconds,
+       * 0 turns busy polling off
+       */
+      void
+      set_max_window(long max_window, uint64_t now)
+      {
+        max_window_ = (max_window > 0) ? max_window : 0;
+        //start with maximum window
+        scaled_average_ = max_window_ / 2 * EWMA_WEIGHT;
+        last_event_ = now;
+        update_window();
+      }
+
+      inline long
+      max_window() const
+      {
+        return max_window_;
+      }
+
+      inline bool
+      enabled() const
+      {
+        return max_window_ > 0;
+      }
+
+      /**
+       * Current spin window
+       */
+      inline long
+      window() const
+      {
+        return stats_.window;
+      }
+
+      /**
+       * Poll found events
+       * @param spin_hit while spinning
+       */
+      void
+      woken(uint64_t now, bool spin_hit)
+      {
+        if (spin_hit)
+        {
+          ++stats_.spin_hits;
+        }
+        else
+        {
+          ++stats_.blocking_wakeups;
+        }
+        //long idle periods are clamped, so average recovers quickly
+        const uint64_t limit = 4 * static_cast<uint64_t>(max_window_);
+        const uint64_t elapsed = (now > last_event_) ? now - last_event_ : 0;
+        const long interval = static_cast<long>(
+          elapsed < limit ? elapsed : limit);
+        last_event_ = now;
+        scaled_average_ += interval - scaled_average_ / EWMA_WEIGHT;
+        update_window();
+      }
+
+      inline const BusyPollStats&
+      stats() const
+      {
+        return stats_;
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_BUSYPOLL_HPP_ */
@@ -0,0 +1,137 @@
+/**
+ * @file Clock.hpp
+ * @author askryabin
+ * Monotonic clocks used by reactors for timeouts and counters.
+ *
+ * Clock policy is selected at compile time:
+ * \li ZMQREACTOR_CLOCK_COARSE - CLOCK_MONOTONIC_COARSE:
+ * fastest, but has resolution of kernel tick (1-4 ms)
+ * \li ZMQREACTOR_CLOCK_TSC - calibrated TSC (x86 with invariant TSC only)
+ * \li default - CLOCK_MONOTONIC
+ *
+ * All of them are not affected by wall-clock (NTP) steps and
+ * do not perform system calls (vDSO or rdtsc).
+ */
+
+#ifndef ZMQREACTOR_CLOCK_HPP_
+#define ZMQREACTOR_CLOCK_HPP_
+
+#include <stdint.h>
+#include <time.h>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    template <clockid_t Id>
+    struct PosixClock
+    {
+      static inline
+      uint64_t
+      now_nsec()
+      {
+        struct timespec ts;
+        ::clock_gettime(Id, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+      }
+
+      static inline
+      uint64_t
+      now_usec()
+      {
+        return now_nsec() / 1000;
+      }
+    };
+
+    typedef PosixClock<CLOCK_MONOTONIC> MonotonicClock;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    typedef PosixClock<CLOCK_MONOTONIC_COARSE> CoarseMonotonicClock;
+#else
+    typedef MonotonicClock CoarseMonotonicClock;
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    /**
+     * TSC based clock. Calibrated against CLOCK_MONOTONIC on first use.
+     */
+    struct TscClock
+    {
+    private:
+      static inline
+      uint64_t
+      rdtsc()
+      {
+        uint32_t lo, hi;
+        __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+      }
+
+      /**
+       * Fixed point nanoseconds per tick (32 fractional bits)
+       */
+      struct Calibration
+      {
+        uint64_t base_tsc;
+        uint64_t base_nsec;
+        uint64_t nsec_per_tick;
+
+        Calibration()
+        {
+          const uint64_t calibration_nsec = 2000000;
+          base_nsec = MonotonicClock::now_nsec();
+          base_tsc = rdtsc();
+          uint64_t nsec;
+          do
+          {
+            nsec = MonotonicClock::now_nsec();
+          }
+          while (nsec - base_nsec < calibration_nsec);
+          const uint64_t ticks = rdtsc() - base_tsc;
+          nsec_per_tick = ((nsec - base_nsec) << 32) / (ticks ? ticks : 1);
+        }
+      };
+
+      static inline
+      const Calibration&
+      calibration()
+      {
+        static const Calibration c;
+        return c;
+      }
+
+    public:
+      static inline
+      uint64_t
+      now_nsec()
+      {
+        const Calibration& c = calibration();
+        const uint64_t ticks = rdtsc() - c.base_tsc;
+        //split multiplication to avoid overflow
+        return c.base_nsec +
+          (ticks >> 32) * c.nsec_per_tick +
+          (((ticks & 0xffffffffULL) * c.nsec_per_tick) >> 32);
+      }
+
+      static inline
+      uint64_t
+      now_usec()
+      {
+        return now_nsec() / 1000;
+      }
+    };
+#else
+    typedef MonotonicClock TscClock;
+#endif
+
+#if defined(ZMQREACTOR_CLOCK_TSC)
+    typedef TscClock Clock;
+#elif defined(ZMQREACTOR_CLOCK_COARSE)
+    typedef CoarseMonotonicClock Clock;
+#else
+    typedef MonotonicClock Clock;
+#endif
+  }
+}
+
+#endif /* ZMQREACTOR_CLOCK_HPP_ */
@@ -0,0 +1,37 @@
+/**
+ * @file ContextHandler.hpp
+ * @author askryabin
+ * Internal handlers of reactors: function and pointer to its context
+ */
+
+#ifndef ZMQREACTOR_CONTEXTHANDLER_HPP_
+#define ZMQREACTOR_CONTEXTHANDLER_HPP_
+
+#include "zmqreactor/common.hpp"
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Handler calling Fun with its context (post queue, send queue,
+     * signal set, ...), which outlives the handler.
+     * Plain functor for owning handler types, and is converted
+     * by PackedHandler to {thunk, context} without copying,
+     * so internal handlers can be added to reactor of any handler type.
+     */
+    template <typename Ctx, bool (*Fun)(Ctx*, Arg)>
+    struct ContextHandler
+    {
+      Ctx* ctx;
+
+      inline bool
+      operator() (Arg arg) const
+      {
+        return Fun(ctx, arg);
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_CONTEXTHANDLER_HPP_ */
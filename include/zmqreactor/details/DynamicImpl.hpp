@@ -0,0 +1,250 @@
+/**
+ * @file DynamicImpl.hpp
+ * @author askryabin
+ *
+ */
+
+#ifndef ZMQREACTOR_DYNAMICIMPL_HPP_
+#define ZMQREACTOR_DYNAMICIMPL_HPP_
+
+////////////////////////////////////////////////////
+///     definition of templates
+////////////////////////////////////////////////////
+
+namespace ZmqReactor
+{
+  template <typename HandlerT>
+  PollResult
+  BasicDynamic<HandlerT>::poll(Timer& timer)
+  {
+    int ret = do_poll(timer);
+
+    if (ret == -1)
+    {
+      return ERROR;
+    }
+
+    dispatching_ = true;
+    PollResult res;
+    try
+    {
+      res = dispatch(ret);
+    }
+    catch (...)
+    {
+      finish_dispatch();
+      throw;
+    }
+    finish_dispatch();
+    return res;
+  }
+
+  template <typename HandlerT>
+  PollResult
+  BasicDynamic<HandlerT>::dispatch(int ret)
+  {
+    const int expired = expire_timeouts();
+    if (expired < 0)
+    {
+      return CANCELLED;
+    }
+    if (ret == 0)
+    {
+      return expired ? OK : NONE_MATCHED;
+    }
+
+    Private::DispatchScope scope(stats_);
+
+    if (dispatch_mode_ == FAIR)
+    {
+      return dispatch_fair(ret);
+    }
+
+    if (dispatch_mode_ == READY_LIST || prioritized_)
+    {
+      collect_ready(ret);
+      if (prioritized_)
+      {
+        order_ready(0);
+      }
+      for (IndexVec::const_iterator it = ready_.begin();
+        it != ready_.end(); ++it)
+      {
+        //handlers may be removed or disabled by previous handler
+        if (*it >= static_cast<int>(handlers_.size()) || !item_enabled(*it))
+        {
+          continue;
+        }
+        HandlerAt fun = {&handlers_, *it};
+        if (!call_handler(fun, *it))
+        {
+          return CANCELLED;
+        }
+      }
+      return OK;
+    }
+
+    for (int n = 0; n < static_cast<int>(poll_items_.size()) && ret > 0; ++n)
+    {
+      if (poll_items_[n].revents)
+      {
+        --ret;
+        if (event_matches(poll_items_[n]))
+        {
+          HandlerAt fun = {&handlers_, n};
+          bool should_continue = call_handler(fun, n);
+          if (!should_continue)
+          {
+            return CANCELLED;
+          }
+        }
+      }
+    }
+    return OK;
+  }
+
+  template <typename HandlerT>
+  PollResult
+  BasicDynamic<HandlerT>::dispatch_fair(int num_polled)
+  {
+    collect_ready(num_polled);
+    order_ready(fair_start_);
+
+    size_t calls = 0;
+    for (size_t k = 0; k < ready_.size(); ++k)
+    {
+      const int idx = ready_[k];
+      if (fair_round_limit_ && calls >= fair_round_limit_)
+      {
+        //round is over, not served items (of lower priorities)
+        //go first next time
+        fair_start_ = idx;
+        return OK;
+      }
+      if (k == 0)
+      {
+        fair_start_ = idx + 1;
+      }
+      //handlers may be removed or disabled by previous handler
+      if (idx >= static_cast<int>(handlers_.size()) || !item_enabled(idx))
+      {
+        continue;
+      }
+      size_t budget = fair_budget_;
+      if (fair_round_limit_ && budget > fair_round_limit_ - calls)
+      {
+        budget = fair_round_limit_ - calls;
+      }
+      HandlerAt fun = {&handlers_, idx};
+      size_t n;
+      if (!call_handler(fun, idx, budget, n))
+      {
+        return CANCELLED;
+      }
+      calls += n;
+    }
+    return OK;
+  }
+
+  template <typename HandlerT>
+  void
+  BasicDynamic<HandlerT>::finish_dispatch()
+  {
+    dispatching_ = false;
+    if (removed_.empty())
+    {
+      return;
+    }
+    //from the end, so moved last handler is never a removed one
+    std::sort(removed_.begin(), removed_.end());
+    for (IndexVec::const_reverse_iterator it = removed_.rbegin();
+      it != removed_.rend(); ++it)
+    {
+      erase_handler(*it);
+    }
+    removed_.clear();
+  }
+
+  template <typename HandlerT>
+  void
+  BasicDynamic<HandlerT>::erase_handler(int idx)
+  {
+    const int last = handlers_.size() - 1;
+    if (idx != last)
+    {
+      handlers_[idx] = handlers_[last];
+    }
+    handlers_.pop_back();
+    swap_remove(idx);
+    slots_.swap_remove(idx);
+  }
+
+  template <typename HandlerT>
+  bool
+  BasicDynamic<HandlerT>::remove_handler(const HandlerHandle& handle)
+  {
+    const int idx = slots_.index(handle);
+    if (idx < 0)
+    {
+      return false;
+    }
+    slots_.release(idx);
+    if (dispatching_)
+    {
+      //keep positions until poll operation is finished
+      disable_item(idx);
+      detach_item(idx);
+      removed_.push_back(idx);
+    }
+    else
+    {
+      erase_handler(idx);
+    }
+    return true;
+  }
+
+  template <typename HandlerT>
+  void
+  BasicDynamic<HandlerT>::remove_handlers_from(int idx)
+  {
+    //pending removals of truncated handlers are dropped
+    IndexVec::iterator keep = removed_.begin();
+    for (IndexVec::const_iterator it = removed_.begin();
+      it != removed_.end(); ++it)
+    {
+      if (*it < idx)
+      {
+        *keep++ = *it;
+      }
+    }
+    removed_.erase(keep, removed_.end());
+    slots_.truncate(idx);
+    remove_from(idx);
+    handlers_.resize(idx);
+  }
+
+  template <typename HandlerT>
+  PollResult
+  BasicDynamic<HandlerT>::run(long timeout, int max_events)
+  {
+    PollResult res = NONE_MATCHED;
+    //deadline is computed once, clock is read once per operation
+    Timer timer(timeout);
+    for (int i = 0; i < max_events || max_events == -1; ++i)
+    {
+      res = poll(timer);
+      if (res != OK && res != NONE_MATCHED)
+      {
+        break;
+      }
+      timer.tick();
+      if (timeout >=0 && timer.remaining() <= 0)
+      {
+        break;
+      }
+    }
+    return res;
+  }
+}
+
+#endif /* ZMQREACTOR_DYNAMICIMPL_HPP_ */
@@ -0,0 +1,255 @@
+/**
+ * @file HashIndex.hpp
+ * @author askryabin
+ * Open addressing hash index of handlers by socket or file descriptor
+ */
+
+#ifndef ZMQREACTOR_HASHINDEX_HPP_
+#define ZMQREACTOR_HASHINDEX_HPP_
+
+#include <vector>
+#include <cstddef>
+
+#include <stdint.h>
+
+#include <zmq.hpp>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Multimap from zmq socket pointer or file descriptor to handler
+     * (position or pointer), with linear probing in power of 2 table.
+     * Table is kept at most half full (including removed entries),
+     * so insert, erase and lookup are O(1) on average.
+     *
+     * Sockets and descriptors share key space: socket pointers
+     * are aligned (even), descriptors are encoded as odd numbers.
+     * Not thread safe.
+     * @tparam ValueT copyable, comparable value type (int or pointer)
+     */
+    template <typename ValueT>
+    class HashIndex
+    {
+    public:
+      typedef uintptr_t Key;
+
+      static inline Key
+      socket_key(const zmq::socket_t* socket)
+      {
+        return reinterpret_cast<Key>(socket);
+      }
+
+      static inline Key
+      fd_key(int fd)
+      {
+        return (static_cast<Key>(static_cast<unsigned>(fd)) << 1) | 1;
+      }
+
+    private:
+      /**
+       * Key of never used entry, also "no key"
+       */
+      static const Key EMPTY = 0;
+
+      /**
+       * Key of erased entry: probing continues past it
+       */
+      static const Key ERASED = 2;
+
+      static const size_t MIN_CAPACITY = 16;
+
+      struct Entry
+      {
+        Key key;
+        ValueT value;
+      };
+
+      typedef std::vector<Entry> EntriesVec;
+
+      EntriesVec table_;
+
+      size_t size_;
+
+      /**
+       * Live and erased entries
+       */
+      size_t used_;
+
+      inline size_t
+      mask() const
+      {
+        return table_.size() - 1;
+      }
+
+      inline size_t
+      slot_of(Key key) const
+      {
+        //Fibonacci hashing: pointers differ mostly in middle bits
+        const uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(h >> 32) & mask();
+      }
+
+      void
+      rehash(size_t capacity)
+      {
+        EntriesVec old(capacity);
+        old.swap(table_); //new table is zero filled, i.e. EMPTY
+        used_ = size_;
+        for (typename EntriesVec::const_iterator it = old.begin();
+          it != old.end(); ++it)
+        {
+          if (it->key != EMPTY && it->key != ERASED)
+          {
+            put(it->key, it->value);
+          }
+        }
+      }
+
+      inline void
+      put(Key key, const ValueT& value)
+      {
+        size_t i = slot_of(key);
+        while (table_[i].key != EMPTY)
+        {
+          i = (i + 1) & mask();
+        }
+        table_[i].key = key;
+        table_[i].value = value;
+      }
+
+    public:
+      HashIndex() : size_(0), used_(0) {}
+
+      /**
+       * @brief Number of entries
+       */
+      inline size_t
+      size() const
+      {
+        return size_;
+      }
+
+      /**
+       * Add entry, keys may repeat. EMPTY key is ignored.
+       */
+      void
+      insert(Key key, const ValueT& value)
+      {
+        if (key == EMPTY)
+        {
+          return;
+        }
+        if ((used_ + 1) * 2 > table_.size())
+        {
+          size_t capacity = table_.empty() ? MIN_CAPACITY : table_.size();
+          //grow if mostly live entries, otherwise just drop erased ones
+          while ((size_ + 1) * 4 > capacity)
+          {
+            capacity *= 2;
+          }
+          rehash(capacity);
+        }
+        put(key, value);
+        ++size_;
+        ++used_;
+      }
+
+      /**
+       * Find next entry with key.
+       * @param pos position of previous found entry, -1 to start.
+       * Set to position of found entry.
+       * @return false if there are no more entries with the key
+       */
+      inline bool
+      find_next(Key key, int& pos) const
+      {
+        if (table_.empty() || key == EMPTY)
+        {
+          return false;
+        }
+        size_t i = (pos < 0) ? slot_of(key) : ((pos + 1) & mask());
+        for (; table_[i].key != EMPTY; i = (i + 1) & mask())
+        {
+          if (table_[i].key == key)
+          {
+            pos = i;
+            return true;
+          }
+        }
+        return false;
+      }
+
+      /**
+       * Value of entry found by find_next
+       */
+      inline const ValueT&
+      value(int pos) const
+      {
+        return table_[pos].value;
+      }
+
+      /**
+       * Find entry by key and value
+       * @return -1 if not found
+       */
+      inline int
+      find(Key key, const ValueT& value) const
+      {
+        int pos = -1;
+        while (find_next(key, pos))
+        {
+          if (table_[pos].value == value)
+          {
+            return pos;
+          }
+        }
+        return -1;
+      }
+
+      /**
+       * Erase entry with key and value
+       * @return false if not found
+       */
+      bool
+      erase(Key key, const ValueT& value)
+      {
+        const int pos = find(key, value);
+        if (pos < 0)
+        {
+          return false;
+        }
+        table_[pos].key = ERASED;
+        --size_;
+        return true;
+      }
+
+      /**
+       * Replace value of entry with key and old_value
+       * @return false if not found
+       */
+      bool
+      update(Key key, const ValueT& old_value, const ValueT& new_value)
+      {
+        const int pos = find(key, old_value);
+        if (pos < 0)
+        {
+          return false;
+        }
+        table_[pos].value = new_value;
+        return true;
+      }
+
+      void
+      clear()
+      {
+        EntriesVec().swap(table_);
+        size_ = 0;
+        used_ = 0;
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_HASHINDEX_HPP_ */
@@ -0,0 +1,128 @@
+/**
+ * @file Mailbox.hpp
+ * @author askryabin
+ * Queue of messages of one socket, handled by worker pool in order
+ */
+
+#ifndef ZMQREACTOR_MAILBOX_HPP_
+#define ZMQREACTOR_MAILBOX_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/OffloadMessage.hpp"
+#include "zmqreactor/WorkerPool.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <deque>
+#include <vector>
+#include <tr1/functional>
+
+#include <pthread.h>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Mailbox of socket (actor style): reactor thread receives messages
+     * into it, worker pool calls handler for them one by one.
+     * At most one worker handles mailbox at a time,
+     * so messages are handled in receiving order.
+     *
+     * When number of messages in flight (received, not handled yet)
+     * reaches limit, receive() asks to pause the source;
+     * when it drops to half of limit, resume function is called
+     * (from worker thread).
+     *
+     * Exception thrown by handler is caught in worker thread:
+     * message is dropped, failure is counted and error function is called.
+     */
+    class Mailbox : private NonCopyable
+    {
+    public:
+      typedef std::tr1::function<void (OffloadMessage&)> Fun;
+
+      typedef std::tr1::function<void ()> ResumeFun;
+
+      typedef std::tr1::function<void ()> ErrorFun;
+
+    private:
+      zmq::socket_t* socket_;
+
+      Fun fun_;
+
+      ResumeFun resume_;
+
+      ErrorFun error_;
+
+      WorkerPool* pool_;
+
+      size_t limit_;
+
+      /**
+       * Received by last receive(), reactor thread only
+       */
+      std::vector<OffloadMessage*> batch_;
+
+      pthread_mutex_t lock_;
+
+      pthread_cond_t idle_cond_;
+
+      //guarded by lock_:
+
+      std::deque<OffloadMessage*> queue_;
+
+      size_t in_flight_;
+
+      /**
+       * Job is submitted to pool or running
+       */
+      bool scheduled_;
+
+      /**
+       * Source is asked to pause
+       */
+      bool paused_;
+
+      /**
+       * Number of messages, handler failed on
+       */
+      size_t failures_;
+
+      static void
+      run(void* ctx);
+
+    public:
+      Mailbox(
+        zmq::socket_t& socket, const Fun& fun, WorkerPool& pool,
+        size_t limit, const ResumeFun& resume,
+        const ErrorFun& error = ErrorFun());
+
+      /**
+       * Waits until worker finishes with the mailbox
+       */
+      ~Mailbox();
+
+      /**
+       * Receive queued messages (up to limit) and schedule handling.
+       * Called from reactor thread.
+       * @return true if source must be paused
+       */
+      bool
+      receive();
+
+      /**
+       * Number of received messages, not handled yet
+       */
+      size_t
+      in_flight();
+
+      /**
+       * Number of messages, handler threw exception on
+       */
+      size_t
+      failures();
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_MAILBOX_HPP_ */
@@ -0,0 +1,143 @@
+/**
+ * @file MessagePool.hpp
+ * @author askryabin
+ * Reusable zmq messages for handlers, receiving in reactor
+ */
+
+#ifndef ZMQREACTOR_MESSAGEPOOL_HPP_
+#define ZMQREACTOR_MESSAGEPOOL_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <vector>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Messages bigger than this are rebuilt (their buffers freed)
+   * when returned to reactor's message pool.
+   */
+  const size_t MAX_POOLED_MESSAGE_SIZE = 4096;
+
+  namespace Private
+  {
+    /**
+     * Free list of zmq messages, owned by reactor.
+     * Message objects are created once and then only received into:
+     * zmq releases previous content on receive, small messages
+     * are stored inside message object, so steady state
+     * receiving does not allocate.
+     * Not thread safe.
+     */
+    class MessagePool : private NonCopyable
+    {
+    private:
+      typedef std::vector<zmq::message_t*> MessagesVec;
+
+      MessagesVec free_;
+
+    public:
+      MessagePool() {}
+
+      ~MessagePool()
+      {
+        for (MessagesVec::iterator it = free_.begin(); it != free_.end(); ++it)
+        {
+          delete *it;
+        }
+      }
+
+      inline zmq::message_t*
+      acquire()
+      {
+        if (free_.empty())
+        {
+          return new zmq::message_t;
+        }
+        zmq::message_t* msg = free_.back();
+        free_.pop_back();
+        return msg;
+      }
+
+      inline void
+      release(zmq::message_t* msg)
+      {
+        if (msg->size() > MAX_POOLED_MESSAGE_SIZE)
+        {
+          msg->rebuild();
+        }
+        try
+        {
+          free_.push_back(msg);
+        }
+        catch (...)
+        {
+          delete msg;
+        }
+      }
+
+      /**
+       * Number of free messages
+       */
+      inline size_t
+      size() const
+      {
+        return free_.size();
+      }
+    };
+
+    /**
+     * Message taken from pool for scope
+     */
+    class PooledMessage : private NonCopyable
+    {
+    private:
+      MessagePool& pool_;
+
+      zmq::message_t* msg_;
+
+    public:
+      explicit
+      PooledMessage(MessagePool& pool) : pool_(pool), msg_(pool.acquire()) {}
+
+      ~PooledMessage()
+      {
+        pool_.release(msg_);
+      }
+
+      inline zmq::message_t&
+      get()
+      {
+        return *msg_;
+      }
+    };
+
+    /**
+     * Reactor handler: receives one message into pooled message
+     * and passes it to user functor.
+     * @tparam FunT functor with signature: bool (Arg, zmq::message_t&)
+     */
+    template <typename FunT>
+    struct RecvHandler
+    {
+      MessagePool* pool;
+      FunT fun;
+
+      RecvHandler(MessagePool& p, const FunT& f) : pool(&p), fun(f) {}
+
+      bool
+      operator() (Arg arg)
+      {
+        PooledMessage msg(*pool);
+        if (!arg.socket->recv(&msg.get(), ZMQ_NOBLOCK))
+        {
+          return true; //spurious wakeup
+        }
+        return fun(arg, msg.get());
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_MESSAGEPOOL_HPP_ */
@@ -0,0 +1,115 @@
+/**
+ * @file ObjectPool.hpp
+ * @author askryabin
+ * Slab allocator with free list for objects of one type
+ */
+
+#ifndef ZMQREACTOR_OBJECTPOOL_HPP_
+#define ZMQREACTOR_OBJECTPOOL_HPP_
+
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <new>
+#include <vector>
+#include <cstddef>
+
+#include <boost/static_assert.hpp>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Allocates memory for objects of type T in slabs of SlabSize objects.
+     * Released memory is kept in free list and reused,
+     * so in steady state allocation and release are just list operations.
+     * Memory is returned to the system only when pool is destroyed.
+     * Objects are constructed and destroyed by the user
+     * (with placement new and explicit destructor call).
+     * Not thread safe.
+     */
+    template <typename T, size_t SlabSize = 64>
+    class ObjectPool : private NonCopyable
+    {
+    private:
+      BOOST_STATIC_ASSERT(sizeof(T) >= sizeof(void*));
+
+      union Slot
+      {
+        Slot* next;
+        char obj[sizeof(T)];
+      };
+
+      typedef std::vector<Slot*> SlabsVec;
+
+      SlabsVec slabs_;
+
+      Slot* free_;
+
+      void
+      add_slab()
+      {
+        slabs_.push_back(0);
+        //::operator new returns memory aligned for any object
+        Slot* slab =
+          static_cast<Slot*>(::operator new(SlabSize * sizeof(Slot)));
+        slabs_.back() = slab;
+        for (size_t i = 0; i < SlabSize; ++i)
+        {
+          slab[i].next = free_;
+          free_ = &slab[i];
+        }
+      }
+
+    public:
+      ObjectPool() : free_(0) {}
+
+      ~ObjectPool()
+      {
+        for (typename SlabsVec::iterator it = slabs_.begin();
+          it != slabs_.end(); ++it)
+        {
+          ::operator delete(*it);
+        }
+      }
+
+      /**
+       * Get memory for one object
+       */
+      void*
+      allocate()
+      {
+        if (!free_)
+        {
+          add_slab();
+        }
+        Slot* slot = free_;
+        free_ = slot->next;
+        return slot;
+      }
+
+      /**
+       * Return memory of (already destroyed) object to the pool
+       */
+      void
+      deallocate(void* p)
+      {
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = free_;
+        free_ = slot;
+      }
+
+      /**
+       * Destroy object and return its memory to the pool
+       */
+      void
+      destroy(T* obj)
+      {
+        obj->~T();
+        deallocate(obj);
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_OBJECTPOOL_HPP_ */
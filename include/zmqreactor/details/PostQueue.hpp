@@ -0,0 +1,129 @@
+/**
+ * @file PostQueue.hpp
+ * @author askryabin
+ * Lock-free queue of tasks posted to reactor from other threads
+ */
+
+#ifndef ZMQREACTOR_POSTQUEUE_HPP_
+#define ZMQREACTOR_POSTQUEUE_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/InplaceHandler.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/ContextHandler.hpp"
+#include "zmqreactor/details/Atomic.hpp"
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Multiple producers, single consumer queue of tasks with eventfd
+     * to wake up consumer (reactor).
+     *
+     * Producers push tasks to lock-free stack. Only the producer which
+     * finds the stack empty signals eventfd, so a burst of posts
+     * results in one wakeup. Consumer (eventfd handler in reactor thread)
+     * takes the whole stack at once and calls tasks in posting order.
+     *
+     * Tasks are functors with handler signature: bool (Arg),
+     * called with Arg filled with zeros, returning false to cancel polling.
+     */
+    class PostQueue : private NonCopyable
+    {
+    public:
+      typedef InplaceHandler<> Task;
+
+      static inline bool
+      drain_queue(PostQueue* queue, Arg)
+      {
+        return queue->drain();
+      }
+
+      /**
+       * Handler of eventfd, to be added to reactor
+       */
+      typedef ContextHandler<PostQueue, &PostQueue::drain_queue> Drainer;
+
+    private:
+      struct Node
+      {
+        Node* next;
+        Task task;
+
+        template <typename FunT>
+        explicit
+        Node(const FunT& fun) : next(0), task(fun) {}
+      };
+
+      /**
+       * Top of stack of posted tasks (the latest first). Shared.
+       */
+      Node* head_;
+
+      /**
+       * Taken tasks, not called yet (in posting order). Consumer only.
+       */
+      Node* taken_;
+
+      int fd_;
+
+      void
+      push(Node* node);
+
+      void
+      wakeup();
+
+      static void
+      destroy_list(Node* node);
+
+    public:
+      PostQueue();
+
+      ~PostQueue();
+
+      /**
+       * Create eventfd. Must happen before any concurrent post().
+       * @throw zmq::error_t if eventfd can not be created
+       */
+      void
+      open();
+
+      /**
+       * Eventfd to poll for input, -1 if not opened
+       */
+      inline int
+      fd() const
+      {
+        return fd_;
+      }
+
+      inline Drainer
+      drainer()
+      {
+        Drainer d = {this};
+        return d;
+      }
+
+      /**
+       * Add task. May be called from any thread.
+       */
+      template <typename FunT>
+      void
+      post(const FunT& fun)
+      {
+        push(new Node(fun));
+      }
+
+      /**
+       * Call all tasks posted so far. Called by consumer only.
+       * @return false if some task returned false
+       * (the rest of tasks are called on next drain)
+       */
+      bool
+      drain();
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_POSTQUEUE_HPP_ */
@@ -0,0 +1,42 @@
+/**
+ * @file ScopedLock.hpp
+ * @author askryabin
+ * Mutex held for a scope
+ */
+
+#ifndef ZMQREACTOR_SCOPEDLOCK_HPP_
+#define ZMQREACTOR_SCOPEDLOCK_HPP_
+
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <pthread.h>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Locks mutex in constructor, unlocks in destructor,
+     * so it is released when locked code throws
+     */
+    class ScopedLock : private NonCopyable
+    {
+    private:
+      pthread_mutex_t* mutex_;
+
+    public:
+      explicit
+      ScopedLock(pthread_mutex_t& mutex) : mutex_(&mutex)
+      {
+        ::pthread_mutex_lock(mutex_);
+      }
+
+      ~ScopedLock()
+      {
+        ::pthread_mutex_unlock(mutex_);
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_SCOPEDLOCK_HPP_ */
@@ -0,0 +1,113 @@
+/**
+ * @file SignalSet.hpp
+ * @author askryabin
+ * Signals handled in reactor's thread with signalfd
+ */
+
+#ifndef ZMQREACTOR_SIGNALSET_HPP_
+#define ZMQREACTOR_SIGNALSET_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+#include "zmqreactor/details/ContextHandler.hpp"
+
+#include <vector>
+#include <tr1/functional>
+
+#include <signal.h>
+#include <sys/signalfd.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Signal handler, called in reactor's thread.
+   *
+   * Called with signal info (ssi_signo, ssi_pid, ...),
+   * returns true to continue polling, false to break.
+   */
+  typedef std::tr1::function<bool (const signalfd_siginfo&)> SignalFun;
+
+  namespace Private
+  {
+    /**
+     * Signals blocked for normal delivery and read from signalfd.
+     * One signalfd serves all signals of reactor,
+     * all signals pending at wakeup are read with one read.
+     * Not thread safe.
+     */
+    class SignalSet : private NonCopyable
+    {
+    public:
+      static inline bool
+      read_signals(SignalSet* set, Arg)
+      {
+        return set->read();
+      }
+
+      /**
+       * Handler of signalfd, to be added to reactor
+       */
+      typedef ContextHandler<SignalSet, &SignalSet::read_signals> Reader;
+
+      /**
+       * Maximum number of signals taken by one read
+       */
+      static const int BATCH = 16;
+
+    private:
+      int fd_;
+
+      sigset_t mask_;
+
+      /**
+       * Functions, indexed by signal number
+       */
+      std::vector<SignalFun> funs_;
+
+    public:
+      SignalSet();
+
+      /**
+       * Closes signalfd. Signals remain blocked.
+       */
+      ~SignalSet();
+
+      /**
+       * Block signal in calling thread and read it from signalfd.
+       * Function of already added signal is replaced.
+       * @return true if signalfd has just been created
+       * (and its reader should be added to reactor)
+       * @throw zmq::error_t if signal is invalid
+       * or signalfd can not be created
+       */
+      bool
+      add(int signo, const SignalFun& fun);
+
+      /**
+       * Signalfd to poll for input, -1 if no signals are added
+       */
+      inline int
+      fd() const
+      {
+        return fd_;
+      }
+
+      inline Reader
+      reader()
+      {
+        Reader r = {this};
+        return r;
+      }
+
+      /**
+       * Read pending signals (up to BATCH) and call their functions.
+       * @return false if some function returned false
+       * (functions of the rest of read signals are called anyway)
+       */
+      bool
+      read();
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_SIGNALSET_HPP_ */
@@ -0,0 +1,147 @@
+/**
+ * @file SlotMap.hpp
+ * @author askryabin
+ * Stable handles of items kept in dense arrays
+ */
+
+#ifndef ZMQREACTOR_SLOTMAP_HPP_
+#define ZMQREACTOR_SLOTMAP_HPP_
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Handle of handler added to Dynamic reactor.
+   *
+   * Remains valid while handler is moved inside reactor.
+   * Stale handles (of removed handlers) are recognized
+   * by generation number.
+   */
+  struct HandlerHandle
+  {
+    int id;
+    uint32_t gen;
+
+    HandlerHandle() : id(-1), gen(0) {}
+
+    HandlerHandle(int i, uint32_t g) : id(i), gen(g) {}
+  };
+
+  namespace Private
+  {
+    /**
+     * Maps handles to positions of items in dense arrays.
+     * Items are appended and removed by moving the last item
+     * into the hole (swap-and-pop), all operations are O(1).
+     * Slots of removed items are reused with incremented generation.
+     */
+    class SlotMap
+    {
+    private:
+      struct Slot
+      {
+        int index; //-1 if free
+        uint32_t gen;
+      };
+
+      std::vector<Slot> slots_;
+
+      /**
+       * Slot id of each item, -1 if released
+       */
+      std::vector<int> item_slots_;
+
+      std::vector<int> free_;
+
+    public:
+      /**
+       * Register item appended to arrays
+       */
+      inline HandlerHandle
+      add()
+      {
+        int id;
+        if (free_.empty())
+        {
+          Slot s = {-1, 0};
+          slots_.push_back(s);
+          id = slots_.size() - 1;
+        }
+        else
+        {
+          id = free_.back();
+          free_.pop_back();
+        }
+        item_slots_.push_back(id);
+        slots_[id].index = item_slots_.size() - 1;
+        return HandlerHandle(id, slots_[id].gen);
+      }
+
+      /**
+       * @return position of item, -1 if handle is stale
+       */
+      inline int
+      index(const HandlerHandle& h) const
+      {
+        if (h.id < 0 || h.id >= static_cast<int>(slots_.size()) ||
+          slots_[h.id].gen != h.gen)
+        {
+          return -1;
+        }
+        return slots_[h.id].index;
+      }
+
+      /**
+       * Invalidate handle of item, item itself stays in place
+       */
+      inline void
+      release(int idx)
+      {
+        const int id = item_slots_[idx];
+        if (id >= 0)
+        {
+          slots_[id].index = -1;
+          ++slots_[id].gen;
+          free_.push_back(id);
+          item_slots_[idx] = -1;
+        }
+      }
+
+      /**
+       * Last item is moved to idx (released before), size decreases
+       */
+      inline void
+      swap_remove(int idx)
+      {
+        const int last = item_slots_.size() - 1;
+        if (idx != last)
+        {
+          item_slots_[idx] = item_slots_[last];
+          if (item_slots_[idx] >= 0)
+          {
+            slots_[item_slots_[idx]].index = idx;
+          }
+        }
+        item_slots_.pop_back();
+      }
+
+      /**
+       * Release and remove all items starting from idx
+       */
+      inline void
+      truncate(int idx)
+      {
+        for (int i = idx; i < static_cast<int>(item_slots_.size()); ++i)
+        {
+          release(i);
+        }
+        item_slots_.resize(idx);
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_SLOTMAP_HPP_ */
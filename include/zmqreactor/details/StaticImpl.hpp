@@ -21,10 +21,11 @@ namespace ZmqReactor
     {
       //check all socks
       PollResult res;
+      //deadline is computed once, clock is read once per operation
       Timer timer(timeout);
       while (true)
       {
-        res = this->poll(timer.remaining());
+        res = poll(timer);
         if (res != OK && res != NONE_MATCHED)
         {
           break;
@@ -38,13 +39,62 @@ namespace ZmqReactor
       return res;
     }
 
+#ifdef ZMQREACTOR_HAS_VARIADIC
+    template <typename FunTupleT, int Size>
+    PollResult
+    StaticReactor<FunTupleT, Size>::poll(Timer& timer)
+    {
+      int ret = do_poll(timer);
+
+      if (ret == -1) return ERROR;
+
+      const int expired = expire_timeouts();
+      if (expired < 0) return CANCELLED;
+      if (ret == 0) return expired ? OK : NONE_MATCHED;
+
+      Private::DispatchScope scope(this->stats_);
+
+      const Dispatcher* table =
+        dispatch_table(typename MakeIndexSeq<Size>::type());
+
+      if (this->prioritized_)
+      {
+        collect_ready(ret);
+        order_ready(0);
+        for (IndexVec::const_iterator it = ready_.begin();
+          it != ready_.end(); ++it)
+        {
+          if (!table[*it](*this))
+          {
+            return CANCELLED;
+          }
+        }
+        return OK;
+      }
+
+      //stop as soon as all items reported by poll are seen
+      for (int n = 0; n < Size && ret > 0; ++n)
+      {
+        if (poll_items_[n].revents)
+        {
+          --ret;
+          if (event_matches(poll_items_[n]) && !table[n](*this))
+          {
+            return CANCELLED;
+          }
+        }
+      }
+      return OK;
+    }
+#else
     template <typename FunTupleT, int Size>
     template <typename ReactorT, int TermSize, int Num>
     PollResult
     StaticReactor<FunTupleT, Size>
-    ::Caller<ReactorT, TermSize, Num>::call(self& r)
+    ::Caller<ReactorT, TermSize, Num>::call(self& r, int prio)
     {
-      if (r.event_matches(r.poll_items_[Num]))
+      if (r.event_matches(r.poll_items_[Num]) &&
+        (prio < 0 || priority_of(r.flags_[Num]) == prio))
       {
         bool should_continue = r.call_handler(
             std::tr1::get<Num>(r.fun_tuple_), Num
@@ -52,20 +102,38 @@ namespace ZmqReactor
         if (!should_continue)
           return CANCELLED;
       }
-      return Caller<ReactorT, TermSize, Num+1>::call(r);
+      return Caller<ReactorT, TermSize, Num+1>::call(r, prio);
     }
 
     template <typename FunTupleT, int Size>
     PollResult
-    StaticReactor<FunTupleT, Size>::poll(long timeout)
+    StaticReactor<FunTupleT, Size>::poll(Timer& timer)
     {
-      int ret = do_poll(timeout);
+      int ret = do_poll(timer);
 
       if (ret == -1) return ERROR;
-      if (ret == 0) return NONE_MATCHED;
 
-      return Caller<self, Size, 0>::call(*this);
+      const int expired = expire_timeouts();
+      if (expired < 0) return CANCELLED;
+      if (ret == 0) return expired ? OK : NONE_MATCHED;
+
+      Private::DispatchScope scope(this->stats_);
+
+      if (!this->prioritized_)
+      {
+        return Caller<self, Size, 0>::call(*this, -1);
+      }
+      for (int prio = 0; prio < PRIORITIES; ++prio)
+      {
+        const PollResult res = Caller<self, Size, 0>::call(*this, prio);
+        if (res != OK)
+        {
+          return res;
+        }
+      }
+      return OK;
     }
+#endif
   }
 }
 
@@ -0,0 +1,532 @@
+/**
+ * @file StatsCollector.hpp
+ * @author askryabin
+ * Compile-time selected collector of reactors' counters
+ */
+
+#ifndef ZMQREACTOR_STATSCOLLECTOR_HPP_
+#define ZMQREACTOR_STATSCOLLECTOR_HPP_
+
+#include "zmqreactor/Stats.hpp"
+#include "zmqreactor/details/Atomic.hpp"
+#include "zmqreactor/details/Clock.hpp"
+
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <vector>
+#include <new>
+#include <cstring>
+
+#ifdef ZMQREACTOR_STATS
+# define ZMQREACTOR_STATS_ENABLED true
+#else
+# define ZMQREACTOR_STATS_ENABLED false
+#endif
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Collects counters (Enabled = true) or does nothing (Enabled = false).
+     * Counters are written by reactor thread only and may be read
+     * by snapshot from any thread without locking,
+     * also while handlers are added or removed.
+     *
+     * Handlers' counters are addressed either by handler's index
+     * (add_handler, remove_from, swap_remove follow handlers vector),
+     * or by slot (acquire_slot, release_slot) for reactors without indexes.
+     */
+    template <bool Enabled>
+    class StatsCollector;
+
+    /**
+     * Counters of handlers in chunks, which are never moved or freed
+     * while collector lives. Chunk pointers and number of counters
+     * are published by reactor thread, so snapshot reads only
+     * initialized counters.
+     */
+    class HandlerCounters : private NonCopyable
+    {
+    public:
+      static const size_t CHUNK = 64;
+
+      static const size_t MAX_CHUNKS = 1024;
+
+      /**
+       * Handlers beyond capacity are not counted
+       */
+      static const size_t CAPACITY = CHUNK * MAX_CHUNKS;
+
+    private:
+      HandlerStats* chunks_[MAX_CHUNKS];
+
+      /**
+       * Allocated chunks, reactor thread only
+       */
+      size_t num_chunks_;
+
+      /**
+       * Number of counters, available for snapshot
+       */
+      size_t size_;
+
+    public:
+      HandlerCounters() : num_chunks_(0), size_(0)
+      {
+        std::memset(chunks_, 0, sizeof(chunks_));
+      }
+
+      ~HandlerCounters()
+      {
+        for (size_t i = 0; i < num_chunks_; ++i)
+        {
+          delete[] chunks_[i];
+        }
+      }
+
+      /**
+       * Allocate chunk of counter at idx, if needed. Reactor thread.
+       * @return false if idx is beyond capacity or memory is exhausted
+       */
+      bool
+      reserve(size_t idx)
+      {
+        if (idx >= CAPACITY)
+        {
+          return false;
+        }
+        while (num_chunks_ <= idx / CHUNK)
+        {
+          HandlerStats* chunk = new (std::nothrow) HandlerStats[CHUNK];
+          if (!chunk)
+          {
+            return false;
+          }
+          std::memset(chunk, 0, CHUNK * sizeof(HandlerStats));
+          release_store(chunks_[num_chunks_], chunk);
+          ++num_chunks_;
+        }
+        return true;
+      }
+
+      inline
+      HandlerStats&
+      at(size_t idx)
+      {
+        return chunks_[idx / CHUNK][idx % CHUNK];
+      }
+
+      inline
+      const HandlerStats&
+      at(size_t idx) const
+      {
+        return relaxed_load(chunks_[idx / CHUNK])[idx % CHUNK];
+      }
+
+      /**
+       * Make counters before size available for snapshot.
+       * Counters must be reserved.
+       */
+      inline
+      void
+      publish(size_t size)
+      {
+        release_store(size_, size);
+      }
+
+      /**
+       * Number of counters, available for snapshot. Any thread.
+       */
+      inline
+      size_t
+      published() const
+      {
+        return acquire_load(size_);
+      }
+    };
+
+    template <>
+    class StatsCollector<false>
+    {
+    public:
+      typedef int Stamp;
+
+      static inline Stamp start() { return 0; }
+
+      inline void polled(Stamp, int) {}
+
+      inline void dispatched(Stamp) {}
+
+      inline void looped(Stamp, uint64_t) {}
+
+      inline uint64_t dispatch_time() const { return 0; }
+
+      inline void handler_called(int, Stamp) {}
+
+      inline void events_queried() {}
+
+      inline void add_handler() {}
+
+      inline void remove_from(size_t) {}
+
+      inline void swap_remove(size_t) {}
+
+      inline int acquire_slot() { return -1; }
+
+      inline void release_slot(int) {}
+
+      inline bool snapshot(ReactorStats&, bool = true) const { return false; }
+
+      inline bool snapshot(int, HandlerStats&) const { return false; }
+    };
+
+    template <>
+    class StatsCollector<true>
+    {
+    public:
+      typedef uint64_t Stamp;
+
+    private:
+      /**
+       * Reactor's counters, handlers are not used
+       */
+      ReactorStats counters_;
+
+      HandlerCounters handlers_;
+
+      /**
+       * Number of handlers (indexed) or slots, reactor thread only
+       */
+      size_t num_handlers_;
+
+      /**
+       * Number of the first handlers with counters, reactor thread only.
+       * Less than num_handlers_ if counters could not be allocated.
+       */
+      size_t counted_;
+
+      /**
+       * Released slots
+       */
+      std::vector<int> free_slots_;
+
+      /**
+       * Handler calls since last dispatched()
+       */
+      int dispatch_calls_;
+
+      static inline
+      uint64_t
+      now()
+      {
+        return Clock::now_nsec();
+      }
+
+      static inline
+      int
+      bucket(uint64_t ns)
+      {
+        const int b = 63 - __builtin_clzll(ns | 1);
+        return (b < STATS_BUCKETS) ? b : STATS_BUCKETS - 1;
+      }
+
+      /**
+       * Both from and to may be read concurrently
+       */
+      static inline
+      void
+      copy(const HandlerStats& from, HandlerStats& to)
+      {
+        relaxed_store(to.calls, relaxed_load(from.calls));
+        relaxed_store(to.total_ns, relaxed_load(from.total_ns));
+        for (int i = 0; i < STATS_BUCKETS; ++i)
+        {
+          relaxed_store(to.histogram[i], relaxed_load(from.histogram[i]));
+        }
+      }
+
+      static inline
+      void
+      reset(HandlerStats& h)
+      {
+        relaxed_store<uint64_t>(h.calls, 0);
+        relaxed_store<uint64_t>(h.total_ns, 0);
+        for (int i = 0; i < STATS_BUCKETS; ++i)
+        {
+          relaxed_store<uint64_t>(h.histogram[i], 0);
+        }
+      }
+
+      inline
+      void
+      handler_called(HandlerStats& h, Stamp st)
+      {
+        const uint64_t ns = now() - st;
+        relaxed_add<uint64_t>(h.calls, 1);
+        relaxed_add(h.total_ns, ns);
+        relaxed_add<uint64_t>(h.histogram[bucket(ns)], 1);
+      }
+
+    public:
+      StatsCollector() :
+        num_handlers_(0), counted_(0), dispatch_calls_(0)
+      {
+        counters_.polls = 0;
+        counters_.timeouts = 0;
+        counters_.empty_wakeups = 0;
+        counters_.events_queries = 0;
+        counters_.poll_ns = 0;
+        counters_.dispatch_ns = 0;
+      }
+
+      static inline
+      Stamp
+      start()
+      {
+        return now();
+      }
+
+      /**
+       * Poll operation started at st returned num_events
+       */
+      inline
+      void
+      polled(Stamp st, int num_events)
+      {
+        relaxed_add<uint64_t>(counters_.polls, 1);
+        relaxed_add(counters_.poll_ns, now() - st);
+        if (num_events == 0)
+        {
+          relaxed_add<uint64_t>(counters_.timeouts, 1);
+        }
+      }
+
+      /**
+       * Dispatching of events started at st is finished
+       */
+      inline
+      void
+      dispatched(Stamp st)
+      {
+        relaxed_add(counters_.dispatch_ns, now() - st);
+        if (!dispatch_calls_)
+        {
+          relaxed_add<uint64_t>(counters_.empty_wakeups, 1);
+        }
+        dispatch_calls_ = 0;
+      }
+
+      /**
+       * Event loop started at st is finished,
+       * dispatch time was dispatch_before at start.
+       * Loop time, not spent in dispatching, is counted as poll time.
+       */
+      inline
+      void
+      looped(Stamp st, uint64_t dispatch_before)
+      {
+        const uint64_t dispatch = dispatch_time() - dispatch_before;
+        const uint64_t elapsed = now() - st;
+        relaxed_add<uint64_t>(counters_.polls, 1);
+        relaxed_add<uint64_t>(
+          counters_.poll_ns, (elapsed > dispatch) ? elapsed - dispatch : 0);
+      }
+
+      inline
+      uint64_t
+      dispatch_time() const
+      {
+        return counters_.dispatch_ns;
+      }
+
+      /**
+       * Handler at index (or slot) idx, called at st, returned.
+       * Handler may have removed itself, then it is not counted.
+       */
+      inline
+      void
+      handler_called(int idx, Stamp st)
+      {
+        ++dispatch_calls_;
+        if (idx >= 0 && static_cast<size_t>(idx) < counted_)
+        {
+          handler_called(handlers_.at(idx), st);
+        }
+      }
+
+      inline
+      void
+      events_queried()
+      {
+        relaxed_add<uint64_t>(counters_.events_queries, 1);
+      }
+
+      /**
+       * Handler is appended. It is not counted if its counters
+       * can not be allocated (and handlers after it).
+       */
+      inline
+      void
+      add_handler()
+      {
+        if (counted_ == num_handlers_ && handlers_.reserve(counted_))
+        {
+          reset(handlers_.at(counted_));
+          ++counted_;
+        }
+        ++num_handlers_;
+        handlers_.publish(counted_);
+      }
+
+      inline
+      void
+      remove_from(size_t idx)
+      {
+        if (idx < num_handlers_)
+        {
+          num_handlers_ = idx;
+          counted_ = (counted_ < idx) ? counted_ : idx;
+          handlers_.publish(counted_);
+        }
+      }
+
+      /**
+       * Counters of the last handler are moved to idx
+       */
+      inline
+      void
+      swap_remove(size_t idx)
+      {
+        const size_t last = num_handlers_ - 1;
+        if (idx < counted_ && idx != last)
+        {
+          if (last < counted_)
+          {
+            copy(handlers_.at(last), handlers_.at(idx));
+          }
+          else
+          {
+            reset(handlers_.at(idx)); //counted from now
+          }
+        }
+        --num_handlers_;
+        counted_ = (counted_ < num_handlers_) ? counted_ : num_handlers_;
+        handlers_.publish(counted_);
+      }
+
+      /**
+       * Get slot for counters of new handler.
+       * @return -1 if handler is not counted
+       */
+      int
+      acquire_slot()
+      {
+        int slot = -1;
+        if (!free_slots_.empty())
+        {
+          slot = free_slots_.back();
+          free_slots_.pop_back();
+        }
+        else if (handlers_.reserve(counted_))
+        {
+          try
+          {
+            //release_slot does not allocate
+            free_slots_.reserve(counted_ + 1);
+          }
+          catch (...)
+          {
+            return -1;
+          }
+          slot = counted_++;
+          num_handlers_ = counted_;
+          handlers_.publish(counted_);
+        }
+        else
+        {
+          return -1;
+        }
+        reset(handlers_.at(slot));
+        return slot;
+      }
+
+      /**
+       * Slot of removed handler may be reused.
+       */
+      inline
+      void
+      release_slot(int slot)
+      {
+        if (slot >= 0)
+        {
+          free_slots_.push_back(slot);
+        }
+      }
+
+      /**
+       * Take counters of reactor (and its indexed handlers).
+       * May be called from any thread.
+       */
+      bool
+      snapshot(ReactorStats& out, bool with_handlers = true) const
+      {
+        out.polls = relaxed_load(counters_.polls);
+        out.timeouts = relaxed_load(counters_.timeouts);
+        out.empty_wakeups = relaxed_load(counters_.empty_wakeups);
+        out.events_queries = relaxed_load(counters_.events_queries);
+        out.poll_ns = relaxed_load(counters_.poll_ns);
+        out.dispatch_ns = relaxed_load(counters_.dispatch_ns);
+        out.handlers.resize(with_handlers ? handlers_.published() : 0);
+        for (size_t i = 0; i < out.handlers.size(); ++i)
+        {
+          copy(handlers_.at(i), out.handlers[i]);
+        }
+        return true;
+      }
+
+      /**
+       * Take counters of handler by slot (or index).
+       * May be called from any thread.
+       */
+      bool
+      snapshot(int slot, HandlerStats& out) const
+      {
+        if (slot < 0 || static_cast<size_t>(slot) >= handlers_.published())
+        {
+          return false;
+        }
+        copy(handlers_.at(slot), out);
+        return true;
+      }
+    };
+
+    /**
+     * Collector used by reactors
+     */
+    typedef StatsCollector<ZMQREACTOR_STATS_ENABLED> Stats;
+
+    /**
+     * Counts time of dispatching events while in scope
+     */
+    class DispatchScope
+    {
+    private:
+      Stats& stats_;
+      const Stats::Stamp start_;
+
+    public:
+      explicit
+      DispatchScope(Stats& stats) :
+        stats_(stats), start_(Stats::start())
+      {}
+
+      ~DispatchScope()
+      {
+        stats_.dispatched(start_);
+      }
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_STATSCOLLECTOR_HPP_ */
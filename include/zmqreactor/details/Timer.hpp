@@ -0,0 +1,66 @@
+/**
+ * @file Timer.hpp
+ * @author askryabin
+ * Poll loop timeout tracking, shared by all reactors
+ */
+
+#ifndef ZMQREACTOR_TIMER_HPP_
+#define ZMQREACTOR_TIMER_HPP_
+
+#include "zmqreactor/details/Clock.hpp"
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Tracks remaining time (in microseconds) of reactor's run loop.
+     * Negative timeout means infinite.
+     * Deadline is computed once on construction, so remaining time
+     * does not accumulate rounding errors of intermediate steps.
+     * @tparam ClockT monotonic clock, see Clock.hpp
+     */
+    template <typename ClockT>
+    class BasicTimer
+    {
+    private:
+      long remaining_;
+      uint64_t deadline_;
+
+    public:
+
+      explicit
+      BasicTimer(long timeout) :
+        remaining_(timeout), deadline_(0)
+      {
+        if (remaining_ > 0)
+        {
+          deadline_ = ClockT::now_usec() + remaining_;
+        }
+      }
+
+      /**
+       * Update remaining time (reads clock once)
+       */
+      void
+      tick()
+      {
+        if (remaining_ > 0)
+        {
+          const uint64_t now = ClockT::now_usec();
+          remaining_ = (now < deadline_) ? static_cast<long>(deadline_ - now) : 0;
+        }
+      }
+
+      long
+      remaining() const
+      {
+        return remaining_;
+      }
+    };
+
+    typedef BasicTimer<Clock> Timer;
+  }
+}
+
+#endif /* ZMQREACTOR_TIMER_HPP_ */
@@ -0,0 +1,213 @@
+/**
+ * @file TimerWheel.hpp
+ * @author askryabin
+ * Hierarchical timing wheel, used by reactors for timeouts
+ */
+
+#ifndef ZMQREACTOR_TIMERWHEEL_HPP_
+#define ZMQREACTOR_TIMERWHEEL_HPP_
+
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/NonCopyable.hpp"
+
+#include <vector>
+#include <tr1/functional>
+
+#include <stdint.h>
+
+namespace ZmqReactor
+{
+  /**
+   * @brief Handle of timeout added to reactor.
+   *
+   * Remains safe to cancel after timeout has expired or has been cancelled:
+   * stale handles are recognized by generation number.
+   */
+  struct TimeoutHandle
+  {
+    int idx;
+    uint32_t gen;
+
+    TimeoutHandle() : idx(-1), gen(0) {}
+
+    TimeoutHandle(int i, uint32_t g) : idx(i), gen(g) {}
+  };
+
+  namespace Private
+  {
+    /**
+     * Hierarchical timing wheel: LEVELS levels of SLOTS slots each,
+     * slot of level L covers SLOTS^L ticks.
+     * Insert and cancel are O(1), timers are moved to lower levels
+     * (cascaded) when time reaches their slot.
+     * Empty periods are skipped using slot bitmaps,
+     * so advancing time costs O(levels) per non-empty slot reached.
+     *
+     * Timeouts never expire earlier than requested,
+     * but may expire up to one tick later.
+     */
+    class TimerWheel : private NonCopyable
+    {
+    public:
+      typedef std::tr1::function<bool (ZmqReactor::Arg)> Callback;
+
+      static const int SLOT_BITS = 6;
+      static const int SLOTS = 1 << SLOT_BITS;
+      static const int LEVELS = 4;
+
+      /**
+       * @param resolution_usec length of one tick in microseconds
+       * @param now_usec current time of monotonic clock
+       */
+      TimerWheel(long resolution_usec, uint64_t now_usec);
+
+      /**
+       * Add timeout expiring after timeout_usec from now_usec.
+       * @param persistent if true, timeout is rescheduled with the same
+       * period after each expiration, until cancelled.
+       */
+      TimeoutHandle
+      add(uint64_t now_usec, long timeout_usec,
+        const Callback& fun, bool persistent);
+
+      /**
+       * @return false if handle is stale (timeout already expired or cancelled)
+       */
+      bool
+      cancel(const TimeoutHandle& handle);
+
+      inline size_t
+      size() const
+      {
+        return size_;
+      }
+
+      inline bool
+      empty() const
+      {
+        return size_ == 0;
+      }
+
+      /**
+       * Move time forward to now_usec, collecting expired timeouts.
+       * @return true if there are expired timeouts to fire
+       */
+      bool
+      advance(uint64_t now_usec);
+
+      /**
+       * Get poll timeout, limited by next timer event.
+       * @param timeout user timeout in microseconds, negative for infinite.
+       * @return min of timeout and time to the next timer event
+       */
+      long
+      poll_timeout(uint64_t now_usec, long timeout) const;
+
+      /**
+       * Call callbacks of expired timeouts (collected by advance).
+       * If some callback returns false, remaining expired timeouts
+       * are fired on the next call.
+       * @return number of called callbacks, -1 if some callback returned false
+       */
+      int
+      fire();
+
+      /**
+       * Advance time to now_usec and fire expired timeouts.
+       * @return same as fire()
+       */
+      inline int
+      expire(uint64_t now_usec)
+      {
+        advance(now_usec);
+        return fire();
+      }
+
+    private:
+      enum
+      {
+        /**
+         * List of expired timeouts
+         */
+        DUE_LIST = LEVELS * SLOTS,
+        NUM_LISTS,
+        /**
+         * Node is in free list
+         */
+        NO_LIST = -1
+      };
+
+      struct Node
+      {
+        /**
+         * Expiration tick
+         */
+        uint64_t expires;
+        /**
+         * Period in ticks for persistent timeouts, 0 otherwise
+         */
+        uint64_t period;
+        Callback fun;
+        uint32_t gen;
+        int list;
+        int prev;
+        int next;
+      };
+
+      typedef std::vector<Node> NodesVec;
+
+      const long resolution_;
+
+      /**
+       * Current tick: slots reached up to it (inclusive) are processed
+       */
+      uint64_t now_tick_;
+
+      NodesVec nodes_;
+
+      int free_;
+
+      size_t size_;
+
+      int heads_[NUM_LISTS];
+
+      /**
+       * Bit per non-empty slot of each level
+       */
+      uint64_t bitmaps_[LEVELS];
+
+      int
+      alloc_node();
+
+      void
+      free_node(int idx);
+
+      void
+      link(int idx, int list);
+
+      void
+      unlink(int idx);
+
+      /**
+       * Put node to the slot according to its expiration tick
+       */
+      void
+      schedule(int idx);
+
+      /**
+       * Tick of the next wheel event (expiration or cascade),
+       * UINT64_MAX if wheel is empty
+       */
+      uint64_t
+      next_tick() const;
+
+      /**
+       * Process slots of all levels reached at now_tick_
+       */
+      void
+      process_tick();
+    };
+  }
+}
+
+#endif /* ZMQREACTOR_TIMERWHEEL_HPP_ */
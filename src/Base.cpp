@@ -7,65 +7,79 @@
 #include "zmqreactor/details/Base.hpp"
 #include "zmqreactor/Static.hpp"
 
-#include <time.h>
-#include <sys/time.h>
+#include <algorithm>
 
 namespace ZmqReactor
 {
   namespace Private
   {
-    /**
-     * Get timeout (in microseconds) as a distance from the two timevals.
-     * (0 if 'from' is after 'to')
-     */
-    static inline
-    long timeout_usec(const struct timeval& from, const struct timeval& to)
-    {
-      struct timeval res;
-      if (timercmp(&from, &to, > ))
-      {
-        return 0;
-      }
-      timersub(&to, &from, &res);
-
-      return res.tv_sec * 1000000 + res.tv_usec;
-    }
-
     size_t
     ReactorBase::replace_socket(
       zmq::socket_t* old_ptr, zmq::socket_t* new_ptr)
     {
-      size_t rep = 0;
       void* old_content_ptr = static_cast<void*>(*old_ptr);
+      const IndexMap::Key old_key = IndexMap::socket_key(old_ptr);
 
-      for (size_t i = 0; i < sockets_.size(); ++i)
+      IndexVec found;
+      for (int pos = -1; index_.find_next(old_key, pos); )
       {
-        if (sockets_[i] == old_ptr && poll_items_[i].socket == old_content_ptr)
+        const int i = index_.value(pos);
+        if (poll_items_[i].socket == old_content_ptr)
         {
-          sockets_[i] = new_ptr;
-          poll_items_[i].socket = static_cast<void*>(*new_ptr);
-          ++rep;
+          found.push_back(i);
         }
       }
-      return rep;
+      for (IndexVec::const_iterator it = found.begin();
+        it != found.end(); ++it)
+      {
+        index_.erase(old_key, *it);
+        sockets_[*it] = new_ptr;
+        poll_items_[*it].socket = static_cast<void*>(*new_ptr);
+        index_.insert(IndexMap::socket_key(new_ptr), *it);
+      }
+      return found.size();
     }
 
     int
-    ReactorBase::do_poll(long timeout)
+    ReactorBase::do_poll(Timer& timer)
     {
-      // 0MQ poll workaround for proper handling of zmq::poll timeout
-      timeval start, stop;
+      // 0MQ poll workaround for proper handling of zmq::poll timeout:
+      // poll may return 0 before timeout expires.
+      // Deadline is kept by caller's timer, clock is read here only
+      // if that happens (or if there are timeouts).
+      const long timeout = timer.remaining();
       int res = -1;
-      for(int nstep = 0; ; ++nstep)
+      Stats::Stamp st = Stats::start();
+      bool spun = false;
+      bool spin_hit = false;
+      while (true)
       {
-        if(timeout > 0)
+        long wait = timer.remaining();
+        if (!timers_.empty())
         {
-          ::gettimeofday(&start, 0);
+          wait = timers_.poll_timeout(Clock::now_usec(), wait);
         }
 
         try
         {
-          res = zmq::poll(&poll_items_[0], poll_items_.size(), timeout);
+          res = 0;
+          //spin once per operation, then block for the rest of wait
+          if (!spun && wait != 0 && busy_.window() > 0)
+          {
+            spun = true;
+            const long window = (wait > 0 && wait < busy_.window()) ?
+              wait : busy_.window();
+            res = spin(window);
+            spin_hit = (res != 0);
+            if (wait > 0)
+            {
+              wait -= window;
+            }
+          }
+          if (res == 0)
+          {
+            res = zmq::poll(&poll_items_[0], poll_items_.size(), wait);
+          }
         }
         catch (const zmq::error_t& e)
         {
@@ -73,64 +87,223 @@ namespace ZmqReactor
           return -1;
         }
 
-        if (res != 0 || timeout == -1 || (nstep == 0 && timeout == 0))
+        if (res != 0 || timeout == 0)
         {
           break;
         }
 
-        ::gettimeofday(&stop, 0);
-        long usecs_elapsed = timeout_usec(start, stop);
-
-        if (usecs_elapsed >= timeout)
+        if (!timers_.empty())
+        {
+          if (timers_.advance(Clock::now_usec()))
+          {
+            break; //caller fires expired timeouts
+          }
+        }
+        else if (timeout < 0)
         {
           break;
         }
 
-        timeout -= usecs_elapsed;
+        timer.tick();
+        if (timer.remaining() <= 0)
+        {
+          break;
+        }
+      }
+      stats_.polled(st, res);
+      if (res > 0 && busy_.enabled())
+      {
+        busy_.woken(Clock::now_usec(), spin_hit);
       }
       return res;
     }
 
+    int
+    ReactorBase::spin(long window)
+    {
+      const uint64_t deadline = Clock::now_usec() + window;
+      do
+      {
+        const int res = zmq::poll(&poll_items_[0], poll_items_.size(), 0);
+        if (res != 0)
+        {
+          return res;
+        }
+      }
+      while (Clock::now_usec() < deadline);
+      return 0;
+    }
+
+    void
+    ReactorBase::collect_ready(int num_polled)
+    {
+      ready_.clear();
+      const int size = poll_items_.size();
+      for (int n = 0; n < size && num_polled > 0; ++n)
+      {
+        const zmq::pollitem_t& item = poll_items_[n];
+        if (item.revents)
+        {
+          --num_polled;
+          if (event_matches(item))
+          {
+            ready_.push_back(n);
+          }
+        }
+      }
+    }
+
+    void
+    ReactorBase::order_ready(int start)
+    {
+      const IndexVec::const_iterator from =
+        std::lower_bound(ready_.begin(), ready_.end(), start);
+      const int classes = prioritized_ ? PRIORITIES : 1;
+      ordered_.clear();
+      for (int prio = 0; prio < classes; ++prio)
+      {
+        for (IndexVec::const_iterator it = from; it != ready_.end(); ++it)
+        {
+          if (!prioritized_ || priority_of(flags_[*it]) == prio)
+          {
+            ordered_.push_back(*it);
+          }
+        }
+        for (IndexVec::const_iterator it = ready_.begin(); it != from; ++it)
+        {
+          if (!prioritized_ || priority_of(flags_[*it]) == prio)
+          {
+            ordered_.push_back(*it);
+          }
+        }
+      }
+      ready_.swap(ordered_);
+    }
+
+    short
+    ReactorBase::actual_events(int item_num)
+    {
+      stats_.events_queried();
+      uint32_t events;
+      size_t sz = sizeof(events);
+      sockets_[item_num]->getsockopt(ZMQ_EVENTS, &events, &sz);
+      return static_cast<short>(events) & poll_items_[item_num].events;
+    }
+
     void
     ReactorBase::add_socket(zmq::socket_t& socket, short events)
     {
       zmq::pollitem_t item;
       item.socket = static_cast<void*>(socket);
       item.fd = 0;
-      item.events = events;
+      item.events = events & Poll::EVENTS_MASK;
       item.revents = 0;
 
       poll_items_.push_back(item);
       sockets_.push_back(&socket);
+      flags_.push_back(events & ~Poll::EVENTS_MASK);
+      prioritized_ |= (priority_of(events) != 1);
+      stats_.add_handler();
+      index_.insert(IndexMap::socket_key(&socket), poll_items_.size() - 1);
     }
 
     void
     ReactorBase::replace_socket(int idx, zmq::socket_t& socket, short events)
     {
+      index_.erase(item_key(idx), idx);
+      index_.insert(IndexMap::socket_key(&socket), idx);
       poll_items_[idx].socket = static_cast<void*>(socket);
       poll_items_[idx].fd = 0;
-      poll_items_[idx].events = events;
+      poll_items_[idx].events = events & Poll::EVENTS_MASK;
       poll_items_[idx].revents = 0;
       sockets_[idx] = &socket;
+      flags_[idx] = events & ~Poll::EVENTS_MASK;
+      prioritized_ |= (priority_of(events) != 1);
     }
 
     int
     ReactorBase::index_of(zmq::socket_t& socket) const
     {
-      SocketsVec::const_iterator it =
-        std::find(sockets_.begin(), sockets_.end(), &socket);
-      if (it == sockets_.end())
+      //the first one if socket has many handlers, send queues are skipped
+      int res = -1;
+      const IndexMap::Key key = IndexMap::socket_key(&socket);
+      for (int pos = -1; index_.find_next(key, pos); )
       {
-        return -1;
+        const int idx = index_.value(pos);
+        if (flags_[idx] & SEND_QUEUE_FLAG)
+        {
+          continue;
+        }
+        if (res < 0 || idx < res)
+        {
+          res = idx;
+        }
       }
-      return std::distance(sockets_.begin(), it);
+      return res;
     }
 
     void
     ReactorBase::remove_from(int idx)
     {
+      for (int i = idx; i < static_cast<int>(poll_items_.size()); ++i)
+      {
+        index_.erase(item_key(i), i);
+      }
       poll_items_.resize(idx);
       sockets_.resize(idx);
+      flags_.resize(idx);
+      stats_.remove_from(idx);
+    }
+
+    void
+    ReactorBase::swap_remove(int idx)
+    {
+      const int last = poll_items_.size() - 1;
+      index_.erase(item_key(idx), idx);
+      if (idx != last)
+      {
+        index_.update(item_key(last), last, idx);
+      }
+      poll_items_[idx] = poll_items_[last];
+      sockets_[idx] = sockets_[last];
+      flags_[idx] = flags_[last];
+      poll_items_.pop_back();
+      sockets_.pop_back();
+      flags_.pop_back();
+      stats_.swap_remove(idx);
+    }
+
+    void
+    ReactorBase::detach_item(int idx)
+    {
+      index_.erase(item_key(idx), idx);
+      flags_[idx] |= DETACHED;
+      sockets_[idx] = 0;
+    }
+
+    bool
+    ReactorBase::disable_item(int idx)
+    {
+      if (flags_[idx] & DISABLED)
+      {
+        return false;
+      }
+      flags_[idx] |= DISABLED | poll_items_[idx].events;
+      poll_items_[idx].events = 0;
+      poll_items_[idx].revents = 0;
+      return true;
+    }
+
+    bool
+    ReactorBase::enable_item(int idx)
+    {
+      if (!(flags_[idx] & DISABLED))
+      {
+        return false;
+      }
+      poll_items_[idx].events = flags_[idx] & Poll::EVENTS_MASK;
+      flags_[idx] &= ~(DISABLED | Poll::EVENTS_MASK);
+      return true;
     }
 
     void
@@ -139,11 +312,15 @@ namespace ZmqReactor
       zmq::pollitem_t item;
       item.socket = 0;
       item.fd = fd;
-      item.events = events;
+      item.events = events & Poll::EVENTS_MASK;
       item.revents = 0;
 
       poll_items_.push_back(item);
       sockets_.push_back(0);
+      flags_.push_back(events & ~Poll::EVENTS_MASK);
+      prioritized_ |= (priority_of(events) != 1);
+      stats_.add_handler();
+      index_.insert(IndexMap::fd_key(fd), poll_items_.size() - 1);
     }
   }
 }//NS
@@ -0,0 +1,489 @@
+/**
+ * @file Epoll.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/Epoll.hpp"
+
+#include <climits>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace ZmqReactor
+{
+  /**
+   * Maximum number of epoll events taken by one epoll_wait call
+   */
+  static const size_t EPOLL_MAX_EVENTS = 64;
+
+  /**
+   * Convert timeout in microseconds to epoll milliseconds, rounding up
+   */
+  static inline
+  int
+  timeout_msec(long timeout)
+  {
+    if (timeout < 0)
+    {
+      return -1;
+    }
+    const long msec = timeout / 1000 + ((timeout % 1000) ? 1 : 0);
+    return (msec > INT_MAX) ? INT_MAX : static_cast<int>(msec);
+  }
+
+  static inline
+  uint32_t
+  events_to_epoll(short events)
+  {
+    return
+      ((events & ZMQ_POLLIN) ? EPOLLIN : 0) |
+      ((events & ZMQ_POLLOUT) ? EPOLLOUT : 0);
+  }
+
+  static inline
+  short
+  epoll_to_events(uint32_t events)
+  {
+    return
+      ((events & EPOLLIN) ? ZMQ_POLLIN : 0) |
+      ((events & EPOLLOUT) ? ZMQ_POLLOUT : 0) |
+      ((events & ~(EPOLLIN | EPOLLOUT)) ? ZMQ_POLLERR : 0);
+  }
+
+  Epoll::Epoll() :
+    epoll_fd_(::epoll_create(EPOLL_MAX_EVENTS)),
+    events_(EPOLL_MAX_EVENTS),
+    last_error_(0),
+    batch_limit_(DEFAULT_BATCH_LIMIT),
+    timers_(TIMEOUT_RESOLUTION, Clock::now_usec()),
+    multiparts_(messages_)
+  {
+    if (epoll_fd_ == -1)
+    {
+      throw zmq::error_t();
+    }
+  }
+
+  Epoll::~Epoll()
+  {
+    remove_handlers_from(0);
+    ::close(epoll_fd_);
+  }
+
+  void
+  Epoll::add_item(zmq::socket_t* socket, int fd, short events)
+  {
+    Item item = {socket, fd, -1, events, false, false};
+    items_.push_back(item);
+
+    const int idx = items_.size() - 1;
+    try
+    {
+      register_item(idx);
+    }
+    catch (...)
+    {
+      items_.pop_back();
+      handlers_.pop_back();
+      throw;
+    }
+    stats_.add_handler();
+    index_.insert(item_key(items_[idx]), idx);
+  }
+
+  void
+  Epoll::reset_item(int idx, zmq::socket_t* socket, short events)
+  {
+    unregister_item(idx);
+    index_.erase(item_key(items_[idx]), idx);
+    items_[idx].socket = socket;
+    items_[idx].events = events;
+    index_.insert(item_key(items_[idx]), idx);
+    if (!items_[idx].disabled)
+    {
+      register_item(idx);
+    }
+  }
+
+  void
+  Epoll::register_item(int idx)
+  {
+    Item& item = items_[idx];
+
+    struct epoll_event ev;
+    ev.data.u64 = idx;
+
+    if (item.socket)
+    {
+      size_t sz = sizeof(item.fd);
+      item.socket->getsockopt(ZMQ_FD, &item.fd, &sz);
+      //ZMQ_FD signals any change of socket state, actual events
+      //are taken from ZMQ_EVENTS
+      ev.events = EPOLLIN | EPOLLET;
+    }
+    else
+    {
+      ev.events = events_to_epoll(item.events);
+    }
+
+    item.epoll_fd = item.fd;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, item.epoll_fd, &ev) == -1)
+    {
+      if (errno != EEXIST)
+      {
+        throw zmq::error_t();
+      }
+      //another handler is set to the same descriptor:
+      //duplicate refers to the same file, but is a separate epoll entry
+      item.epoll_fd = ::dup(item.fd);
+      if (item.epoll_fd == -1 ||
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, item.epoll_fd, &ev) == -1)
+      {
+        const int err = errno;
+        if (item.epoll_fd != -1)
+        {
+          ::close(item.epoll_fd);
+        }
+        errno = err;
+        throw zmq::error_t();
+      }
+    }
+
+    if (item.socket)
+    {
+      //edge may be already consumed, so check ZMQ_EVENTS on next poll
+      mark_pending(idx);
+    }
+  }
+
+  void
+  Epoll::unregister_item(int idx)
+  {
+    Item& item = items_[idx];
+    if (item.epoll_fd == -1)
+    {
+      return; //disabled
+    }
+    //descriptor may already be closed, ignore errors
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, item.epoll_fd, 0);
+    if (item.epoll_fd != item.fd)
+    {
+      ::close(item.epoll_fd);
+    }
+    item.epoll_fd = -1;
+  }
+
+  void
+  Epoll::mark_pending(int idx)
+  {
+    if (!items_[idx].pending)
+    {
+      items_[idx].pending = true;
+      pending_.push_back(idx);
+    }
+  }
+
+  short
+  Epoll::actual_events(const Item& item)
+  {
+    stats_.events_queried();
+    uint32_t events;
+    size_t sz = sizeof(events);
+    item.socket->getsockopt(ZMQ_EVENTS, &events, &sz);
+    return static_cast<short>(events) & item.events & Poll::EVENTS_MASK;
+  }
+
+  bool
+  Epoll::call_handler(int idx, Arg arg)
+  {
+    //read before call: handler may remove itself
+    const bool batch = arg.socket && (items_[idx].events & Poll::BATCH);
+    Stats::Stamp st = Stats::start();
+    bool res = handlers_[idx](arg);
+    stats_.handler_called(idx, st);
+    if (!res)
+    {
+      return false;
+    }
+    if (!batch)
+    {
+      return true;
+    }
+    for (size_t i = 1; i < batch_limit_; ++i)
+    {
+      //handler may have removed or disabled itself
+      if (idx >= static_cast<int>(items_.size()) || !items_[idx].socket ||
+        items_[idx].disabled)
+      {
+        break;
+      }
+      arg.events = actual_events(items_[idx]);
+      if (!arg.events)
+      {
+        break;
+      }
+      st = Stats::start();
+      res = handlers_[idx](arg);
+      stats_.handler_called(idx, st);
+      if (!res)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool
+  Epoll::disable_handler(zmq::socket_t& socket)
+  {
+    const int idx = index_of(socket);
+    if (idx < 0 || items_[idx].disabled)
+    {
+      return false;
+    }
+    unregister_item(idx);
+    items_[idx].disabled = true;
+    return true;
+  }
+
+  bool
+  Epoll::enable_handler(zmq::socket_t& socket)
+  {
+    const int idx = index_of(socket);
+    if (idx < 0 || !items_[idx].disabled)
+    {
+      return false;
+    }
+    //marks socket pending: messages may have arrived while disabled
+    register_item(idx);
+    items_[idx].disabled = false;
+    return true;
+  }
+
+  int
+  Epoll::index_of(zmq::socket_t& socket) const
+  {
+    //the first one if socket has many handlers
+    int res = -1;
+    const IndexMap::Key key = IndexMap::socket_key(&socket);
+    for (int pos = -1; index_.find_next(key, pos); )
+    {
+      const int idx = index_.value(pos);
+      if (res < 0 || idx < res)
+      {
+        res = idx;
+      }
+    }
+    return res;
+  }
+
+  void
+  Epoll::remove_handlers_from(int idx)
+  {
+    for (int i = idx; i < static_cast<int>(items_.size()); ++i)
+    {
+      unregister_item(i);
+      index_.erase(item_key(items_[i]), i);
+    }
+    items_.resize(idx);
+    handlers_.resize(idx);
+    stats_.remove_from(idx);
+
+    IndexVec::iterator out = pending_.begin();
+    for (IndexVec::const_iterator it = pending_.begin();
+      it != pending_.end(); ++it)
+    {
+      if (*it < idx)
+      {
+        *out++ = *it;
+      }
+    }
+    pending_.erase(out, pending_.end());
+  }
+
+  size_t
+  Epoll::replace_socket(zmq::socket_t* old_ptr, zmq::socket_t* new_ptr)
+  {
+    IndexVec found;
+    const IndexMap::Key key = IndexMap::socket_key(old_ptr);
+    for (int pos = -1; index_.find_next(key, pos); )
+    {
+      found.push_back(index_.value(pos));
+    }
+    for (IndexVec::const_iterator it = found.begin(); it != found.end(); ++it)
+    {
+      reset_item(*it, new_ptr, items_[*it].events);
+    }
+    return found.size();
+  }
+
+  PollResult
+  Epoll::dispatch(int num_events, int& num_called)
+  {
+    if (!num_events && pending_.empty())
+    {
+      return OK;
+    }
+
+    Private::DispatchScope scope(stats_);
+    PollResult res = OK;
+
+    for (int i = 0; i < num_events; ++i)
+    {
+      const int idx = events_[i].data.u64;
+      if (idx >= static_cast<int>(items_.size()))
+      {
+        continue; //removed by some handler
+      }
+
+      Item& item = items_[idx];
+      if (item.disabled)
+      {
+        continue; //disabled by some handler
+      }
+      if (item.socket)
+      {
+        mark_pending(idx);
+        continue;
+      }
+
+      //after cancel zmq sockets are still collected, their edges are consumed
+      Arg arg = {0, item.fd, epoll_to_events(events_[i].events)};
+      if (res == OK && (arg.events & item.events))
+      {
+        ++num_called;
+        if (!call_handler(idx, arg))
+        {
+          res = CANCELLED;
+        }
+      }
+    }
+
+    dispatched_.swap(pending_);
+
+    IndexVec::const_iterator it = dispatched_.begin();
+    for (; it != dispatched_.end() && res == OK; ++it)
+    {
+      const int idx = *it;
+      if (idx >= static_cast<int>(items_.size()))
+      {
+        continue;
+      }
+      items_[idx].pending = false;
+      if (items_[idx].disabled)
+      {
+        continue; //enable_handler marks it pending again
+      }
+
+      Arg arg = {items_[idx].socket, 0, actual_events(items_[idx])};
+      if (!arg.events)
+      {
+        continue;
+      }
+
+      ++num_called;
+      if (!call_handler(idx, arg))
+      {
+        res = CANCELLED;
+      }
+
+      //edge triggered: events left must be handled on next poll
+      if (idx < static_cast<int>(items_.size()) && items_[idx].socket &&
+        !items_[idx].disabled && actual_events(items_[idx]))
+      {
+        mark_pending(idx);
+      }
+    }
+
+    //not dispatched because of cancel
+    for (; it != dispatched_.end(); ++it)
+    {
+      if (*it < static_cast<int>(items_.size()))
+      {
+        items_[*it].pending = false;
+        mark_pending(*it);
+      }
+    }
+    dispatched_.clear();
+
+    return res;
+  }
+
+  PollResult
+  Epoll::poll(Timer& timer)
+  {
+    while (true)
+    {
+      long wait = pending_.empty() ? timer.remaining() : 0;
+      if (wait != 0 && !timers_.empty())
+      {
+        wait = timers_.poll_timeout(Clock::now_usec(), wait);
+      }
+
+      Stats::Stamp st = Stats::start();
+      int ret = ::epoll_wait(
+        epoll_fd_, &events_[0], events_.size(), timeout_msec(wait));
+      if (ret == -1)
+      {
+        if (errno != EINTR)
+        {
+          last_error_ = ::strerror(errno);
+          return ERROR;
+        }
+        ret = 0;
+      }
+      stats_.polled(st, ret + pending_.size());
+
+      //events are dispatched first: edges of zmq sockets are consumed
+      int num_called = 0;
+      PollResult res = dispatch(ret, num_called);
+      if (res != OK)
+      {
+        return res;
+      }
+
+      const int expired =
+        timers_.empty() ? 0 : timers_.expire(Clock::now_usec());
+      if (expired < 0)
+      {
+        return CANCELLED;
+      }
+      if (num_called > 0 || expired > 0)
+      {
+        return OK;
+      }
+
+      //no actual events (ZMQ_FD signaled socket state change only)
+      timer.tick();
+      if (timer.remaining() == 0)
+      {
+        return NONE_MATCHED;
+      }
+    }
+  }
+
+  PollResult
+  Epoll::run(long timeout, int max_events)
+  {
+    PollResult res = NONE_MATCHED;
+    //deadline is computed once, clock is read once per operation
+    Timer timer(timeout);
+    for (int i = 0; i < max_events || max_events == -1; ++i)
+    {
+      res = poll(timer);
+      if (res != OK && res != NONE_MATCHED)
+      {
+        break;
+      }
+      timer.tick();
+      if (timeout >=0 && timer.remaining() <= 0)
+      {
+        break;
+      }
+    }
+    return res;
+  }
+}
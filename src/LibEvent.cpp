@@ -7,9 +7,38 @@
 #include "zmqreactor/LibEvent.hpp"
 
 #include <iostream>
+#include <vector>
+#include <tr1/functional>
 
 namespace ZmqReactor
 {
+  /**
+   * Maximum number of different durations of common timeouts
+   * (libevent allows 256 per base, leave some for application)
+   */
+  static const size_t MAX_COMMON_TIMEOUTS = 64;
+
+  /**
+   * Create event base with precise (microsecond) timer if available:
+   * on Linux it is timerfd instead of epoll millisecond timeout.
+   */
+  static
+  event_base*
+  new_event_base()
+  {
+    event_config* cfg = ::event_config_new();
+    if (!cfg)
+    {
+      return ::event_base_new();
+    }
+#if LIBEVENT_VERSION_NUMBER >= 0x02010200
+    ::event_config_set_flag(cfg, EVENT_BASE_FLAG_PRECISE_TIMER);
+#endif
+    event_base* base = ::event_base_new_with_config(cfg);
+    ::event_config_free(cfg);
+    return base;
+  }
+
   class LibEvent::AllHandlersIter
   {
   private:
@@ -23,10 +52,18 @@ namespace ZmqReactor
     void
     next_queue();
 
+    /**
+     * Move to the next non-empty queue if current one is over
+     */
+    void
+    skip_empty();
+
     AllHandlersIter(LibEvent* reactor, bool end) :
       reactor_(reactor), cur_queue_(end ? 0 : first_queue()),
       cur_hi_(end ? 0 : cur_queue_->head())
-    {}
+    {
+      skip_empty();
+    }
 
   public:
     static
@@ -96,9 +133,15 @@ namespace ZmqReactor
   void
   LibEvent::AllHandlersIter::next_queue()
   {
+    HandlerQueue* triggered = reactor_->triggered_handlers_;
     if (cur_queue_ == first_queue())
     {
-      cur_queue_ = &reactor_->triggered_handlers_;
+      cur_queue_ = triggered;
+    }
+    else if (cur_queue_ >= triggered &&
+      cur_queue_ < triggered + PRIORITIES - 1)
+    {
+      ++cur_queue_;
     }
     else
     {
@@ -106,15 +149,10 @@ namespace ZmqReactor
     }
   }
 
-  LibEvent::AllHandlersIter&
-  LibEvent::AllHandlersIter::operator++ ()
+  void
+  LibEvent::AllHandlersIter::skip_empty()
   {
-    if (!cur_queue_ || !cur_hi_)
-    {
-      return *this;
-    }
-    cur_hi_ = cur_queue_->next(cur_hi_);
-    if (!cur_hi_)
+    while (cur_queue_ && !cur_hi_)
     {
       next_queue();
       if (cur_queue_)
@@ -122,18 +160,38 @@ namespace ZmqReactor
         cur_hi_ = cur_queue_->head();
       }
     }
+  }
+
+  LibEvent::AllHandlersIter&
+  LibEvent::AllHandlersIter::operator++ ()
+  {
+    if (!cur_queue_ || !cur_hi_)
+    {
+      return *this;
+    }
+    cur_hi_ = cur_queue_->next(cur_hi_);
+    skip_empty();
     return *this;
   }
 
   LibEvent::LibEvent() :
-    base_(::event_base_new()),
+    base_(new_event_base()),
     now_handled_(0),
-    poll_result_(OK)
+    poll_result_(OK),
+    multiparts_(messages_)
   {
-    //EV_PERSIST does not work with 0 timeouts
-    ::event_assign(
-       &event_immediate_, base_, 0, EV_TIMEOUT,
-       &LibEvent::immediate_callback, this);
+    //default priority of events is the middle one, i.e. normal
+    ::event_base_priority_init(base_, PRIORITIES);
+    for (int prio = 0; prio < PRIORITIES; ++prio)
+    {
+      immediate_[prio].reactor = this;
+      immediate_[prio].priority = prio;
+      //EV_PERSIST does not work with 0 timeouts
+      ::event_assign(
+         &immediate_[prio].event, base_, 0, EV_TIMEOUT,
+         &LibEvent::immediate_callback, &immediate_[prio]);
+      ::event_priority_set(&immediate_[prio].event, prio);
+    }
   }
 
   LibEvent::~LibEvent()
@@ -144,23 +202,64 @@ namespace ZmqReactor
     {
       do_remove_handler((it++).get());
     }
+    while (HandlerInfo* hi = disabled_handlers_.pop_head())
+    {
+      stats_.release_slot(hi->stats_slot_);
+      pool_.destroy(hi);
+    }
     ::event_base_free(base_);
   }
 
   LibEvent::HasEvents::Value
-  LibEvent::has_actual_events(HandlerInfo* hi) const
+  LibEvent::has_actual_events(HandlerInfo* hi)
   {
     if (hi->is_zmq())
     {
+      stats_.events_queried();
       uint32_t actual_events;
       size_t sz = sizeof(actual_events);
       hi->arg_.socket->getsockopt(ZMQ_EVENTS, &actual_events, &sz);
-      return ((hi->expected_events_ & zmq_to_reactor(actual_events)) != 0) ?
-        HasEvents::YES : HasEvents::NO;
+      hi->cached_events_ = hi->expected_events_ &
+        zmq_to_reactor(actual_events) & Poll::EVENTS_MASK;
+      hi->events_cached_ = true;
+      return hi->cached_events_ ? HasEvents::YES : HasEvents::NO;
     }
     return HasEvents::UNKNOWN;
   }
 
+  void
+  LibEvent::invalidate_events(zmq::socket_t* socket)
+  {
+    const IndexMap::Key key = IndexMap::socket_key(socket);
+    for (int pos = -1; index_.find_next(key, pos); )
+    {
+      index_.value(pos)->events_cached_ = false;
+    }
+  }
+
+  const timeval*
+  LibEvent::common_timeout(long usec)
+  {
+    CommonTimeoutsMap::const_iterator it = common_timeouts_.find(usec);
+    if (it != common_timeouts_.end())
+    {
+      return it->second;
+    }
+    if (usec <= 0 || common_timeouts_.size() >= MAX_COMMON_TIMEOUTS)
+    {
+      return 0;
+    }
+    timeval tv;
+    tv.tv_sec = usec / 1000000;
+    tv.tv_usec = usec % 1000000;
+    const timeval* common = ::event_base_init_common_timeout(base_, &tv);
+    if (common)
+    {
+      common_timeouts_[usec] = common;
+    }
+    return common;
+  }
+
   int
   LibEvent::fd_by_sock(zmq::socket_t& sock) const
   {
@@ -170,17 +269,53 @@ namespace ZmqReactor
     return fd;
   }
 
+  SendQueue&
+  LibEvent::add_send_queue(
+    zmq::socket_t& socket, size_t high_watermark,
+    const SendQueue::BackpressureFun& backpressure, short flags)
+  {
+    SendQueue& queue = send_queues_.add(socket, high_watermark, backpressure);
+    //for zmq sockets POLLOUT is watched as readability of ZMQ_FD
+    //and checked with ZMQ_EVENTS
+    const Private::SendQueueFlusher flusher = {&queue};
+    HandlerDesc hd = add_handler(socket,
+      static_cast<short>(Poll::OUT | Private::SEND_QUEUE_FLAG | flags),
+      flusher);
+    disable_handler(hd); //till something is queued
+    queue.set_interest(std::tr1::bind(
+      &LibEvent::set_send_interest, this, hd.hi_,
+      std::tr1::placeholders::_1));
+    return queue;
+  }
+
+  void
+  LibEvent::set_send_interest(HandlerInfo* hi, bool on)
+  {
+    HandlerDesc hd(hi);
+    if (on)
+    {
+      enable_handler(hd);
+    }
+    else
+    {
+      disable_handler(hd);
+    }
+  }
+
   void
   LibEvent::immediate_callback(int fd, short event, void *arg)
   {
-    LibEvent* reactor = static_cast<LibEvent*>(arg);
+    Immediate* im = static_cast<Immediate*>(arg);
+    LibEvent* reactor = im->reactor;
+    HandlerQueue& triggered = reactor->triggered_handlers_[im->priority];
+    Private::DispatchScope scope(reactor->stats_);
 //std::cout << time(0) << ">" <<time(0) << ": >>> Reactor: in immediate_callback, fd=" << fd << "\n";
-    for (HandlerInfo* hi = reactor->triggered_handlers_.head(),
+    for (HandlerInfo* hi = triggered.head(),
       * next_hi = hi; hi; hi = next_hi)
     {
-      hi->arg_.events = hi->expected_events_;
+      hi->arg_.events = hi->expected_events_ & Poll::EVENTS_MASK;
 
-      next_hi = reactor->triggered_handlers_.next(hi);
+      next_hi = triggered.next(hi);
 
       reactor->handle_event(hi, HasEvents::YES, false);
     }
@@ -199,7 +334,16 @@ namespace ZmqReactor
 
     if (has_ev != HasEvents::NO)
     {
+      if (hi->is_zmq())
+      {
+        invalidate_events(hi->arg_.socket);
+      }
+      Private::Stats::Stamp st = Private::Stats::start();
       const bool should_continue = hi->fun_(hi->arg_);
+      if (now_handled_)
+      {
+        stats_.handler_called(hi->stats_slot_, st);
+      }
       if (!should_continue)
       {
         ::event_base_loopbreak(base_);
@@ -214,7 +358,7 @@ namespace ZmqReactor
         //timeouts are up to date
         return HasEvents::NO;
       }
-      has_ev = has_actual_events(hi); //again
+      has_ev = known_events(hi); //again, unless reported by handler
     }
 
     if (has_ev == HasEvents::NO)
@@ -222,7 +366,7 @@ namespace ZmqReactor
       if (hi->status_ == HandlerInfo::TRIGGERED)
       {
 //std::cout << time(0) << ">" <<"Reactor: handle_event: triggered to waiting\n";
-        triggered_handlers_.dequeue(hi);
+        triggered_handlers_[hi->priority_].dequeue(hi);
         hi->status_ = HandlerInfo::WAITING;
         waiting_handlers_.enqueue(hi);
         if (update_immediate)
@@ -238,7 +382,7 @@ namespace ZmqReactor
 //std::cout << time(0) << ">" <<"Reactor: handle_event: waiting to triggered\n";
         waiting_handlers_.dequeue(hi);
         hi->status_ = HandlerInfo::TRIGGERED;
-        triggered_handlers_.enqueue(hi);
+        triggered_handlers_[hi->priority_].enqueue(hi);
         if (update_immediate)
         {
           update_immediate_timeout();
@@ -258,23 +402,24 @@ namespace ZmqReactor
 //std::cout << time(0) << ">" <<time(0) << ": ----> Reactor: in event_callback, fd=" << fd << "\n";
     hi->arg_.events = events_to_reactor(event);
 
-    hi->reactor_->handle_event(
-      hi, hi->reactor_->has_actual_events(hi), true);
+    Private::DispatchScope scope(hi->reactor_->stats_);
+    //socket may have been read or written outside of reactor's handlers:
+    //cached events are not trusted on edges
+    hi->reactor_->handle_event(hi, hi->reactor_->has_actual_events(hi), true);
 //std::cout << time(0) << ">" <<"----< Reactor: exit event_callback, fd=" << fd << "\n";
   }
 
   void
   LibEvent::update_immediate_timeout()
   {
-//std::cout << time(0) << ">" <<">> Reactor: in update_immediate_timeout...\n";
-    if (triggered_handlers_.head())
+    for (int prio = 0; prio < PRIORITIES; ++prio)
     {
-//std::cout << time(0) << ">" <<"Reactor: scheduling timeout\n";
-
-      timeval tv = {0, 0};
-      ::event_add(&event_immediate_, &tv);
+      if (triggered_handlers_[prio].head())
+      {
+        timeval tv = {0, 0};
+        ::event_add(&immediate_[prio].event, &tv);
+      }
     }
-//std::cout << time(0) << ">" <<"<< Reactor: after update_immediate_timeout...\n";
   }
 
   void
@@ -288,7 +433,7 @@ namespace ZmqReactor
     {
     case HasEvents::YES:
       hi->status_ = HandlerInfo::TRIGGERED;
-      triggered_handlers_.enqueue(hi);
+      triggered_handlers_[hi->priority_].enqueue(hi);
       update_immediate_timeout();
       break;
     default:
@@ -299,11 +444,18 @@ namespace ZmqReactor
   }
 
   void
-  LibEvent::do_add_handler(HandlerInfo* hi, short libev_events)
+  LibEvent::assign_event(HandlerInfo* hi, short libev_events)
   {
     ::event_assign(
       &hi->event_, base_, hi->arg_.fd, libev_events,
       &LibEvent::event_callback, hi);
+    ::event_priority_set(&hi->event_, hi->priority_);
+  }
+
+  void
+  LibEvent::do_add_handler(HandlerInfo* hi, short libev_events)
+  {
+    assign_event(hi, libev_events);
     do_activate(hi);
   }
 
@@ -324,50 +476,103 @@ namespace ZmqReactor
   {
     if (hi)
     {
-      do_deactivate(hi);
-      delete hi;
+      index_.erase(handler_key(hi), hi);
+      if (hi->enabled_)
+      {
+        do_deactivate(hi);
+      }
+      else
+      {
+        //already deactivated
+        disabled_handlers_.dequeue(hi);
+      }
+      stats_.release_slot(hi->stats_slot_);
+      pool_.destroy(hi);
     }
   }
 
   bool
   LibEvent::force_check_events(const HandlerDesc& hd)
   {
+    if (hd.hi_ && hd.hi_->is_zmq())
+    {
+      invalidate_events(hd.hi_->arg_.socket);
+    }
     if (hd.hi_ && hd.hi_->status_ == HandlerInfo::WAITING &&
       has_actual_events(hd.hi_) == HasEvents::YES)
     {
       hd.hi_->status_ = HandlerInfo::TRIGGERED;
       waiting_handlers_.dequeue(hd.hi_);
-      triggered_handlers_.enqueue(hd.hi_);
+      triggered_handlers_[hd.hi_->priority_].enqueue(hd.hi_);
       update_immediate_timeout();
       return true;
     }
     return false;
   }
 
+  LibEvent::HandlerDesc
+  LibEvent::find_handler(zmq::socket_t& socket)
+  {
+    //send queues are skipped
+    for (int pos = -1; index_.find_next(IndexMap::socket_key(&socket), pos); )
+    {
+      HandlerInfo* hi = index_.value(pos);
+      if (!(hi->expected_events_ & Private::SEND_QUEUE_FLAG))
+      {
+        return HandlerDesc(hi);
+      }
+    }
+    return HandlerDesc();
+  }
+
   size_t
   LibEvent::do_replace_descriptor(
     zmq::socket_t* old_ptr, int old_fd, zmq::socket_t* new_ptr, int new_fd)
   {
-    size_t replaced = 0;
-
-    for (AllHandlersIter it = AllHandlersIter::begin(this),
-      e = AllHandlersIter::end(this); it != e; )
+    std::vector<HandlerInfo*> found;
+    if (old_ptr)
+    {
+      const IndexMap::Key key = IndexMap::socket_key(old_ptr);
+      for (int pos = -1; index_.find_next(key, pos); )
+      {
+        found.push_back(index_.value(pos));
+      }
+    }
+    if (old_fd)
     {
-      HandlerInfo* hi = (it++).get();
+      const IndexMap::Key key = IndexMap::fd_key(old_fd);
+      for (int pos = -1; index_.find_next(key, pos); )
+      {
+        found.push_back(index_.value(pos));
+      }
+    }
 
-      if (
-        (old_ptr && hi->arg_.socket == old_ptr) ||
-        (old_fd && hi->arg_.fd == old_fd))
+    for (std::vector<HandlerInfo*>::const_iterator it = found.begin();
+      it != found.end(); ++it)
+    {
+      HandlerInfo* hi = *it;
+      index_.erase(handler_key(hi), hi);
+      const short libev_events = ::event_get_events(&hi->event_);
+      if (hi->enabled_)
       {
         ::event_del(&hi->event_);
-        hi->arg_.socket = new_ptr;
-        hi->arg_.fd = new_fd;
         get_queue(hi).dequeue(hi);
-        do_add_handler(hi, ::event_get_events(&hi->event_));
-        ++replaced;
       }
+      hi->arg_.socket = new_ptr;
+      hi->arg_.fd = new_fd;
+      hi->events_cached_ = false;
+      if (hi->enabled_)
+      {
+        do_add_handler(hi, libev_events);
+      }
+      else
+      {
+        //registered when enabled
+        assign_event(hi, libev_events);
+      }
+      index_.insert(handler_key(hi), hi);
     }
-    return replaced;
+    return found.size();
   }
 
   PollResult
@@ -380,14 +585,19 @@ namespace ZmqReactor
     else if (timeout > 0)
     {
       timeval tv;
-      tv.tv_sec = timeout;
-      tv.tv_usec = 0;
+      tv.tv_sec = timeout / 1000000;
+      tv.tv_usec = timeout % 1000000;
       ::event_base_loopexit(base_, &tv);
     }
 
     poll_result_ = NONE_MATCHED;
 
+    const Private::Stats::Stamp st = Private::Stats::start();
+    const uint64_t dispatch_before = stats_.dispatch_time();
+
     int ret = ::event_base_loop(base_, mode);
+
+    stats_.looped(st, dispatch_before);
     if (ret == -1)
     {
       poll_result_ = ERROR;
@@ -0,0 +1,220 @@
+/**
+ * @file Offload.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/OffloadMessage.hpp"
+#include "zmqreactor/details/Mailbox.hpp"
+#include "zmqreactor/details/ScopedLock.hpp"
+
+#include <stdint.h>
+
+namespace ZmqReactor
+{
+  bool
+  OffloadMessage::recv(zmq::socket_t& socket)
+  {
+    while (true)
+    {
+      parts_.push_back(0);
+      parts_.back() = new zmq::message_t;
+      if (!socket.recv(parts_.back(), ZMQ_NOBLOCK))
+      {
+        delete parts_.back();
+        parts_.pop_back();
+        return !parts_.empty();
+      }
+      int64_t more;
+      size_t sz = sizeof(more);
+      socket.getsockopt(ZMQ_RCVMORE, &more, &sz);
+      if (!more)
+      {
+        return true;
+      }
+    }
+  }
+
+  namespace Private
+  {
+    /**
+     * Maximum number of messages handled by one job:
+     * then job is resubmitted to let other mailboxes run
+     */
+    static const size_t JOB_QUOTA = 64;
+
+    Mailbox::Mailbox(
+      zmq::socket_t& socket, const Fun& fun, WorkerPool& pool,
+      size_t limit, const ResumeFun& resume, const ErrorFun& error) :
+      socket_(&socket), fun_(fun), resume_(resume), error_(error),
+      pool_(&pool), limit_(limit ? limit : 1), in_flight_(0),
+      scheduled_(false), paused_(false), failures_(0)
+    {
+      ::pthread_mutex_init(&lock_, 0);
+      ::pthread_cond_init(&idle_cond_, 0);
+    }
+
+    Mailbox::~Mailbox()
+    {
+      ::pthread_mutex_lock(&lock_);
+      while (scheduled_)
+      {
+        ::pthread_cond_wait(&idle_cond_, &lock_);
+      }
+      ::pthread_mutex_unlock(&lock_);
+
+      ::pthread_cond_destroy(&idle_cond_);
+      ::pthread_mutex_destroy(&lock_);
+    }
+
+    size_t
+    Mailbox::in_flight()
+    {
+      ::pthread_mutex_lock(&lock_);
+      const size_t res = in_flight_;
+      ::pthread_mutex_unlock(&lock_);
+      return res;
+    }
+
+    size_t
+    Mailbox::failures()
+    {
+      ::pthread_mutex_lock(&lock_);
+      const size_t res = failures_;
+      ::pthread_mutex_unlock(&lock_);
+      return res;
+    }
+
+    bool
+    Mailbox::receive()
+    {
+      ::pthread_mutex_lock(&lock_);
+      const size_t room = (limit_ > in_flight_) ? limit_ - in_flight_ : 0;
+      ::pthread_mutex_unlock(&lock_);
+
+      //receive without holding the lock
+      try
+      {
+        while (batch_.size() < room)
+        {
+          OffloadMessage* msg = new OffloadMessage(socket_);
+          if (!msg->recv(*socket_))
+          {
+            delete msg;
+            break;
+          }
+          batch_.push_back(msg);
+        }
+      }
+      catch (...)
+      {
+        for (size_t i = 0; i < batch_.size(); ++i)
+        {
+          delete batch_[i];
+        }
+        batch_.clear();
+        throw;
+      }
+
+      bool schedule, pause;
+      {
+        ScopedLock locked(lock_);
+        queue_.insert(queue_.end(), batch_.begin(), batch_.end());
+        in_flight_ += batch_.size();
+        //messages left by failed submit are scheduled again
+        schedule = !queue_.empty() && !scheduled_;
+        if (schedule)
+        {
+          scheduled_ = true;
+        }
+        pause = (in_flight_ >= limit_);
+        if (pause)
+        {
+          paused_ = true;
+        }
+      }
+      batch_.clear();
+
+      if (schedule)
+      {
+        try
+        {
+          pool_->submit(&run, this);
+        }
+        catch (...)
+        {
+          //no job runs: destructor must not wait for it
+          ScopedLock locked(lock_);
+          scheduled_ = false;
+          ::pthread_cond_broadcast(&idle_cond_);
+          throw;
+        }
+      }
+      return pause;
+    }
+
+    void
+    Mailbox::run(void* ctx)
+    {
+      Mailbox* mb = static_cast<Mailbox*>(ctx);
+      for (size_t n = 0; n < JOB_QUOTA; ++n)
+      {
+        ::pthread_mutex_lock(&mb->lock_);
+        if (mb->queue_.empty())
+        {
+          mb->scheduled_ = false;
+          ::pthread_cond_broadcast(&mb->idle_cond_);
+          ::pthread_mutex_unlock(&mb->lock_);
+          return;
+        }
+        OffloadMessage* msg = mb->queue_.front();
+        mb->queue_.pop_front();
+        ::pthread_mutex_unlock(&mb->lock_);
+
+        //exception must not leave worker thread
+        //or leave the message in flight
+        bool failed = false;
+        try
+        {
+          mb->fun_(*msg);
+        }
+        catch (...)
+        {
+          failed = true;
+        }
+        delete msg;
+
+        ::pthread_mutex_lock(&mb->lock_);
+        --mb->in_flight_;
+        if (failed)
+        {
+          ++mb->failures_;
+        }
+        const bool resume = mb->paused_ && mb->in_flight_ <= mb->limit_ / 2;
+        if (resume)
+        {
+          mb->paused_ = false;
+        }
+        ::pthread_mutex_unlock(&mb->lock_);
+
+        if (failed && mb->error_)
+        {
+          try
+          {
+            mb->error_();
+          }
+          catch (...)
+          {
+            //failure is counted anyway
+          }
+        }
+        if (resume)
+        {
+          mb->resume_();
+        }
+      }
+      //quota is exhausted: let other jobs run, keep scheduled
+      mb->pool_->submit(&run, mb);
+    }
+  }
+}
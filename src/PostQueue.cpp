@@ -0,0 +1,150 @@
+/**
+ * @file PostQueue.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/details/PostQueue.hpp"
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    PostQueue::PostQueue() :
+      head_(0), taken_(0), fd_(-1)
+    {}
+
+    PostQueue::~PostQueue()
+    {
+      destroy_list(taken_);
+      destroy_list(head_);
+      if (fd_ != -1)
+      {
+        ::close(fd_);
+      }
+    }
+
+    void
+    PostQueue::destroy_list(Node* node)
+    {
+      while (node)
+      {
+        Node* next = node->next;
+        delete node;
+        node = next;
+      }
+    }
+
+    void
+    PostQueue::open()
+    {
+      if (fd_ != -1)
+      {
+        return;
+      }
+      fd_ = ::eventfd(0, EFD_NONBLOCK);
+      if (fd_ == -1)
+      {
+        throw zmq::error_t();
+      }
+      if (head_)
+      {
+        //posted before opening
+        wakeup();
+      }
+    }
+
+    void
+    PostQueue::wakeup()
+    {
+      const uint64_t val = 1;
+      ssize_t res = ::write(fd_, &val, sizeof(val));
+      (void)res; //counter overflow is impossible: it is read on each drain
+    }
+
+    void
+    PostQueue::push(Node* node)
+    {
+      Node* head = relaxed_load(head_);
+      do
+      {
+        node->next = head;
+      }
+      while (!compare_exchange(head_, head, node));
+
+      //only the first task of a burst wakes consumer up:
+      //next ones are taken by the same drain
+      if (!head && relaxed_load(fd_) != -1)
+      {
+        wakeup();
+      }
+    }
+
+    bool
+    PostQueue::drain()
+    {
+      //reset eventfd before taking tasks: tasks posted after taking
+      //will signal it again
+      uint64_t val;
+      ssize_t res = ::read(fd_, &val, sizeof(val));
+      (void)res;
+
+      Node* node = exchange(head_, static_cast<Node*>(0));
+
+      //reverse to posting order
+      Node* taken = 0;
+      while (node)
+      {
+        Node* next = node->next;
+        node->next = taken;
+        taken = node;
+        node = next;
+      }
+
+      //append to tasks left by cancelled drain
+      Node** tail = &taken_;
+      while (*tail)
+      {
+        tail = &(*tail)->next;
+      }
+      *tail = taken;
+
+      const Arg arg = {0, 0, 0};
+      while (taken_)
+      {
+        node = taken_;
+        taken_ = node->next;
+        bool ok;
+        try
+        {
+          ok = node->task(arg);
+        }
+        catch (...)
+        {
+          delete node;
+          if (taken_)
+          {
+            //eventfd is already reset: call the rest on next poll
+            wakeup();
+          }
+          throw;
+        }
+        delete node;
+        if (!ok)
+        {
+          if (taken_)
+          {
+            //call the rest on next poll
+            wakeup();
+          }
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+}
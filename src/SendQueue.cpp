@@ -0,0 +1,103 @@
+/**
+ * @file SendQueue.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/SendQueue.hpp"
+
+namespace ZmqReactor
+{
+  SendQueue::SendQueue(
+    zmq::socket_t& socket, size_t high_watermark,
+    const BackpressureFun& backpressure) :
+    socket_(&socket), high_(0), low_(0), batch_limit_(DEFAULT_BATCH_LIMIT),
+    congested_(false), backpressure_(backpressure)
+  {
+    set_watermarks(high_watermark, high_watermark / 2);
+  }
+
+  SendQueue::~SendQueue()
+  {
+    for (std::deque<Entry>::iterator it = queue_.begin();
+      it != queue_.end(); ++it)
+    {
+      delete it->msg;
+    }
+  }
+
+  void
+  SendQueue::set_watermarks(size_t high, size_t low)
+  {
+    high_ = high ? high : 1;
+    low_ = (low < high_) ? low : high_ - 1;
+  }
+
+  bool
+  SendQueue::send(zmq::message_t& msg, int flags)
+  {
+    if (queue_.empty() && socket_->send(msg, flags | ZMQ_NOBLOCK))
+    {
+      return !congested_;
+    }
+
+    Entry e = {pool_.acquire(), flags};
+    try
+    {
+      e.msg->move(&msg);
+      queue_.push_back(e);
+    }
+    catch (...)
+    {
+      pool_.release(e.msg);
+      throw;
+    }
+
+    if (queue_.size() == 1 && interest_)
+    {
+      interest_(true);
+    }
+    if (!congested_ && queue_.size() >= high_)
+    {
+      congested_ = true;
+      if (backpressure_)
+      {
+        backpressure_(*this, true);
+      }
+    }
+    return !congested_;
+  }
+
+  bool
+  SendQueue::flush()
+  {
+    for (size_t n = 0; n < batch_limit_ && !queue_.empty(); ++n)
+    {
+      Entry& e = queue_.front();
+      if (!socket_->send(*e.msg, e.flags | ZMQ_NOBLOCK))
+      {
+        break; //EAGAIN: wait for next ZMQ_POLLOUT
+      }
+      pool_.release(e.msg);
+      queue_.pop_front();
+    }
+
+    if (congested_ && queue_.size() <= low_)
+    {
+      congested_ = false;
+      if (backpressure_)
+      {
+        backpressure_(*this, false);
+      }
+    }
+    if (queue_.empty())
+    {
+      if (interest_)
+      {
+        interest_(false);
+      }
+      return true;
+    }
+    return false;
+  }
+}
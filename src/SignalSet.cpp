@@ -0,0 +1,92 @@
+/**
+ * @file SignalSet.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/details/SignalSet.hpp"
+
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    SignalSet::SignalSet() :
+      fd_(-1)
+    {
+      sigemptyset(&mask_);
+    }
+
+    SignalSet::~SignalSet()
+    {
+      if (fd_ != -1)
+      {
+        ::close(fd_);
+      }
+    }
+
+    bool
+    SignalSet::add(int signo, const SignalFun& fun)
+    {
+      sigset_t mask = mask_;
+      if (signo <= 0 || sigaddset(&mask, signo) == -1)
+      {
+        errno = EINVAL;
+        throw zmq::error_t();
+      }
+      if (static_cast<size_t>(signo) >= funs_.size())
+      {
+        funs_.resize(signo + 1);
+      }
+
+      //blocked before signalfd is updated: not delivered the usual way
+      sigset_t one;
+      sigemptyset(&one);
+      sigaddset(&one, signo);
+      const int err = ::pthread_sigmask(SIG_BLOCK, &one, 0);
+      if (err)
+      {
+        errno = err;
+        throw zmq::error_t();
+      }
+
+      const int fd = ::signalfd(fd_, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+      if (fd == -1)
+      {
+        throw zmq::error_t();
+      }
+      mask_ = mask;
+      funs_[signo] = fun;
+
+      const bool created = (fd_ == -1);
+      fd_ = fd;
+      return created;
+    }
+
+    bool
+    SignalSet::read()
+    {
+      signalfd_siginfo infos[BATCH];
+      const ssize_t res = ::read(fd_, infos, sizeof(infos));
+      if (res <= 0)
+      {
+        return true; //EAGAIN: spurious wakeup
+      }
+
+      bool ok = true;
+      const int num = static_cast<int>(res / sizeof(signalfd_siginfo));
+      for (int i = 0; i < num; ++i)
+      {
+        const size_t signo = infos[i].ssi_signo;
+        if (signo < funs_.size() && funs_[signo] && !funs_[signo](infos[i]))
+        {
+          ok = false;
+        }
+      }
+      return ok;
+    }
+  }
+}
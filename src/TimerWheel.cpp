@@ -0,0 +1,327 @@
+/**
+ * @file TimerWheel.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/details/TimerWheel.hpp"
+
+#include <climits>
+
+namespace ZmqReactor
+{
+  namespace Private
+  {
+    /**
+     * Timeouts farther than this number of ticks are put
+     * to the last level and rescheduled when it is reached
+     */
+    static const uint64_t MAX_DELTA =
+      static_cast<uint64_t>(TimerWheel::SLOTS - 1) <<
+      (TimerWheel::SLOT_BITS * (TimerWheel::LEVELS - 1));
+
+    static const uint64_t NO_TICK = ~static_cast<uint64_t>(0);
+
+    TimerWheel::TimerWheel(long resolution_usec, uint64_t now_usec) :
+      resolution_(resolution_usec),
+      now_tick_(now_usec / resolution_usec),
+      free_(-1),
+      size_(0)
+    {
+      for (int i = 0; i < NUM_LISTS; ++i)
+      {
+        heads_[i] = -1;
+      }
+      for (int i = 0; i < LEVELS; ++i)
+      {
+        bitmaps_[i] = 0;
+      }
+    }
+
+    int
+    TimerWheel::alloc_node()
+    {
+      if (free_ != -1)
+      {
+        const int idx = free_;
+        free_ = nodes_[idx].next;
+        return idx;
+      }
+      Node n;
+      n.expires = 0;
+      n.period = 0;
+      n.gen = 0;
+      n.list = NO_LIST;
+      n.prev = n.next = -1;
+      nodes_.push_back(n);
+      return nodes_.size() - 1;
+    }
+
+    void
+    TimerWheel::free_node(int idx)
+    {
+      Node& n = nodes_[idx];
+      n.fun = Callback();
+      ++n.gen;
+      n.list = NO_LIST;
+      n.next = free_;
+      free_ = idx;
+      --size_;
+    }
+
+    void
+    TimerWheel::link(int idx, int list)
+    {
+      Node& n = nodes_[idx];
+      n.list = list;
+      n.prev = -1;
+      n.next = heads_[list];
+      if (n.next != -1)
+      {
+        nodes_[n.next].prev = idx;
+      }
+      heads_[list] = idx;
+      if (list < DUE_LIST)
+      {
+        bitmaps_[list / SLOTS] |= static_cast<uint64_t>(1) << (list % SLOTS);
+      }
+    }
+
+    void
+    TimerWheel::unlink(int idx)
+    {
+      Node& n = nodes_[idx];
+      if (n.prev != -1)
+      {
+        nodes_[n.prev].next = n.next;
+      }
+      else
+      {
+        heads_[n.list] = n.next;
+        if (n.next == -1 && n.list < DUE_LIST)
+        {
+          bitmaps_[n.list / SLOTS] &=
+            ~(static_cast<uint64_t>(1) << (n.list % SLOTS));
+        }
+      }
+      if (n.next != -1)
+      {
+        nodes_[n.next].prev = n.prev;
+      }
+      n.list = NO_LIST;
+    }
+
+    void
+    TimerWheel::schedule(int idx)
+    {
+      const uint64_t expires = nodes_[idx].expires;
+      if (expires <= now_tick_)
+      {
+        link(idx, DUE_LIST);
+        return;
+      }
+
+      uint64_t delta = expires - now_tick_;
+      uint64_t at = expires;
+      if (delta > MAX_DELTA)
+      {
+        delta = MAX_DELTA;
+        at = now_tick_ + MAX_DELTA;
+      }
+
+      int level = 0;
+      while (level < LEVELS - 1 &&
+        delta >= (static_cast<uint64_t>(1) << (SLOT_BITS * (level + 1))))
+      {
+        ++level;
+      }
+      const int slot = (at >> (SLOT_BITS * level)) & (SLOTS - 1);
+      link(idx, level * SLOTS + slot);
+    }
+
+    uint64_t
+    TimerWheel::next_tick() const
+    {
+      uint64_t next = NO_TICK;
+      for (int level = 0; level < LEVELS; ++level)
+      {
+        const uint64_t bits = bitmaps_[level];
+        if (!bits)
+        {
+          continue;
+        }
+        const int shift = SLOT_BITS * level;
+        //slot of current position is reached after full turn,
+        //so search starts from the next one
+        const int from = ((now_tick_ >> shift) + 1) & (SLOTS - 1);
+        const uint64_t rotated =
+          from ? ((bits >> from) | (bits << (SLOTS - from))) : bits;
+        const uint64_t steps = __builtin_ctzll(rotated) + 1;
+        const uint64_t tick = ((now_tick_ >> shift) + steps) << shift;
+        if (tick < next)
+        {
+          next = tick;
+        }
+      }
+      return next;
+    }
+
+    void
+    TimerWheel::process_tick()
+    {
+      //higher levels first: cascaded timers may get to lower slots
+      //which are reached at the same tick
+      for (int level = LEVELS - 1; level >= 0; --level)
+      {
+        const int shift = SLOT_BITS * level;
+        if (now_tick_ & ((static_cast<uint64_t>(1) << shift) - 1))
+        {
+          continue;
+        }
+        const int list = level * SLOTS + ((now_tick_ >> shift) & (SLOTS - 1));
+        while (heads_[list] != -1)
+        {
+          const int idx = heads_[list];
+          unlink(idx);
+          schedule(idx);
+        }
+      }
+    }
+
+    TimeoutHandle
+    TimerWheel::add(uint64_t now_usec, long timeout_usec,
+      const Callback& fun, bool persistent)
+    {
+      if (!size_ && now_usec / resolution_ > now_tick_)
+      {
+        //nothing to process, skip idle time at once
+        now_tick_ = now_usec / resolution_;
+      }
+      if (timeout_usec < 0)
+      {
+        timeout_usec = 0;
+      }
+
+      const int idx = alloc_node();
+      Node& n = nodes_[idx];
+      n.fun = fun;
+      //round up: never expire earlier than requested
+      n.expires = (now_usec + timeout_usec + resolution_ - 1) / resolution_;
+      n.period = 0;
+      if (persistent)
+      {
+        n.period = (timeout_usec + resolution_ - 1) / resolution_;
+        if (!n.period)
+        {
+          n.period = 1;
+        }
+      }
+      ++size_;
+      schedule(idx);
+      return TimeoutHandle(idx, n.gen);
+    }
+
+    bool
+    TimerWheel::cancel(const TimeoutHandle& handle)
+    {
+      if (handle.idx < 0 || handle.idx >= static_cast<int>(nodes_.size()))
+      {
+        return false;
+      }
+      const Node& n = nodes_[handle.idx];
+      if (n.gen != handle.gen || n.list == NO_LIST)
+      {
+        return false;
+      }
+      unlink(handle.idx);
+      free_node(handle.idx);
+      return true;
+    }
+
+    bool
+    TimerWheel::advance(uint64_t now_usec)
+    {
+      const uint64_t target = now_usec / resolution_;
+      while (now_tick_ < target)
+      {
+        const uint64_t next = next_tick();
+        if (next > target)
+        {
+          now_tick_ = target;
+          break;
+        }
+        now_tick_ = next;
+        process_tick();
+      }
+      return heads_[DUE_LIST] != -1;
+    }
+
+    long
+    TimerWheel::poll_timeout(uint64_t now_usec, long timeout) const
+    {
+      if (heads_[DUE_LIST] != -1)
+      {
+        return 0;
+      }
+      const uint64_t next = next_tick();
+      if (next == NO_TICK)
+      {
+        return timeout;
+      }
+      const uint64_t at = next * resolution_;
+      long wait = 0;
+      if (at > now_usec)
+      {
+        wait = (at - now_usec > static_cast<uint64_t>(LONG_MAX)) ?
+          LONG_MAX : static_cast<long>(at - now_usec);
+      }
+      return (timeout < 0 || wait < timeout) ? wait : timeout;
+    }
+
+    int
+    TimerWheel::fire()
+    {
+      int called = 0;
+      while (heads_[DUE_LIST] != -1)
+      {
+        const int idx = heads_[DUE_LIST];
+        unlink(idx);
+
+        //callback may add or cancel timeouts (including this one),
+        //so it is called from local copy
+        Callback fun;
+        fun.swap(nodes_[idx].fun);
+        const uint32_t gen = nodes_[idx].gen;
+        if (nodes_[idx].period)
+        {
+          Node& n = nodes_[idx];
+          n.expires += n.period;
+          if (n.expires <= now_tick_)
+          {
+            //we are late: don't fire missed periods in a burst
+            n.expires = now_tick_ + 1;
+          }
+          schedule(idx);
+        }
+        else
+        {
+          free_node(idx);
+        }
+
+        ++called;
+        Arg arg = {0, 0, 0};
+        const bool res = fun(arg);
+
+        if (nodes_[idx].gen == gen && nodes_[idx].list != NO_LIST)
+        {
+          nodes_[idx].fun.swap(fun);
+        }
+        if (!res)
+        {
+          return -1;
+        }
+      }
+      return called;
+    }
+  }
+}
@@ -0,0 +1,198 @@
+/**
+ * @file WorkerPool.cpp
+ * @author askryabin
+ *
+ */
+
+#include "zmqreactor/WorkerPool.hpp"
+#include "zmqreactor/common.hpp"
+#include "zmqreactor/details/Atomic.hpp"
+#include "zmqreactor/details/ScopedLock.hpp"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+namespace ZmqReactor
+{
+  using Private::relaxed_load;
+  using Private::atomic_add;
+
+  /**
+   * Worker of the current thread (if it is a worker)
+   */
+  static __thread void* current_worker = 0;
+
+  WorkerPool::WorkerPool(size_t num_threads) :
+    pending_(0), sleeping_(0), failed_(0), next_(0), stopping_(false)
+  {
+    if (!num_threads)
+    {
+      const long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+      num_threads = (cpus > 0) ? cpus : 1;
+    }
+    ::pthread_mutex_init(&idle_lock_, 0);
+    ::pthread_cond_init(&idle_cond_, 0);
+
+    workers_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+      Worker* w = new Worker;
+      w->pool = this;
+      w->index = i;
+      ::pthread_mutex_init(&w->lock, 0);
+      workers_.push_back(w);
+    }
+
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+      const int err =
+        ::pthread_create(&workers_[i]->thread, 0, &run_worker, workers_[i]);
+      if (err)
+      {
+        stop_and_join(i);
+        errno = err;
+        throw zmq::error_t();
+      }
+    }
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    stop_and_join(workers_.size());
+  }
+
+  void
+  WorkerPool::stop_and_join(size_t num_started)
+  {
+    ::pthread_mutex_lock(&idle_lock_);
+    stopping_ = true;
+    ::pthread_cond_broadcast(&idle_cond_);
+    ::pthread_mutex_unlock(&idle_lock_);
+
+    for (size_t i = 0; i < num_started; ++i)
+    {
+      ::pthread_join(workers_[i]->thread, 0);
+    }
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+      ::pthread_mutex_destroy(&workers_[i]->lock);
+      delete workers_[i];
+    }
+    workers_.clear();
+    ::pthread_cond_destroy(&idle_cond_);
+    ::pthread_mutex_destroy(&idle_lock_);
+  }
+
+  long
+  WorkerPool::failed_jobs() const
+  {
+    return relaxed_load(failed_);
+  }
+
+  void
+  WorkerPool::submit(JobFun fun, void* ctx)
+  {
+    Worker* w = static_cast<Worker*>(current_worker);
+    if (!w || w->pool != this)
+    {
+      //races on next_ only affect distribution
+      const size_t n = relaxed_load(next_);
+      Private::relaxed_store(next_, n + 1);
+      w = workers_[n % workers_.size()];
+    }
+
+    Job job = {fun, ctx};
+    {
+      //push_back may throw
+      Private::ScopedLock locked(w->lock);
+      w->jobs.push_back(job);
+    }
+
+    //full barriers: either sleeping worker is seen here,
+    //or it sees pending job before waiting
+    atomic_add(pending_, 1L);
+    if (atomic_add(sleeping_, 0L) > 0)
+    {
+      ::pthread_mutex_lock(&idle_lock_);
+      ::pthread_cond_signal(&idle_cond_);
+      ::pthread_mutex_unlock(&idle_lock_);
+    }
+  }
+
+  bool
+  WorkerPool::take(Worker* w, Job& job)
+  {
+    //own jobs in submission order
+    ::pthread_mutex_lock(&w->lock);
+    if (!w->jobs.empty())
+    {
+      job = w->jobs.front();
+      w->jobs.pop_front();
+      ::pthread_mutex_unlock(&w->lock);
+      return true;
+    }
+    ::pthread_mutex_unlock(&w->lock);
+
+    //steal the latest job of other worker
+    const size_t size = workers_.size();
+    for (size_t i = 1; i < size; ++i)
+    {
+      Worker* victim = workers_[(w->index + i) % size];
+      ::pthread_mutex_lock(&victim->lock);
+      if (!victim->jobs.empty())
+      {
+        job = victim->jobs.back();
+        victim->jobs.pop_back();
+        ::pthread_mutex_unlock(&victim->lock);
+        return true;
+      }
+      ::pthread_mutex_unlock(&victim->lock);
+    }
+    return false;
+  }
+
+  void*
+  WorkerPool::run_worker(void* arg)
+  {
+    Worker* w = static_cast<Worker*>(arg);
+    WorkerPool* pool = w->pool;
+    current_worker = w;
+
+    Job job;
+    while (true)
+    {
+      if (pool->take(w, job))
+      {
+        atomic_add(pool->pending_, -1L);
+        try
+        {
+          job.fun(job.ctx);
+        }
+        catch (...)
+        {
+          //worker keeps running
+          atomic_add(pool->failed_, 1L);
+        }
+        continue;
+      }
+
+      ::pthread_mutex_lock(&pool->idle_lock_);
+      atomic_add(pool->sleeping_, 1L);
+      while (!atomic_add(pool->pending_, 0L) && !pool->stopping_)
+      {
+        ::pthread_cond_wait(&pool->idle_cond_, &pool->idle_lock_);
+      }
+      atomic_add(pool->sleeping_, -1L);
+      //finish all jobs before stopping
+      const bool stop = pool->stopping_ && !atomic_add(pool->pending_, 0L);
+      ::pthread_mutex_unlock(&pool->idle_lock_);
+      if (stop)
+      {
+        break;
+      }
+    }
+    current_worker = 0;
+    return 0;
+  }
+}
@@ -0,0 +1,153 @@
+/**
+ * @file BusyPollTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks busy polling: adaptation of spin window to intervals
+ * between events, spin hits and blocking wakeups counting
+ * in Dynamic and Static reactors.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Static.hpp"
+#include "zmqreactor/details/BusyPoll.hpp"
+
+using ZmqReactor::BusyPollStats;
+
+static const long MAX_WINDOW = 100;
+
+struct Receiver
+{
+  int* calls;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    zmq::message_t msg;
+    const bool received = arg.socket->recv(&msg, ZMQ_NOBLOCK);
+    assert(received);
+    ++*calls;
+    return true;
+  }
+};
+
+static void*
+delayed_send(void* arg)
+{
+  ::usleep(10000);
+  zmq::message_t msg(1);
+  static_cast<zmq::socket_t*>(arg)->send(msg);
+  return 0;
+}
+
+void
+test_window()
+{
+  ZmqReactor::Private::BusyPoll busy;
+  assert(!busy.enabled() && busy.window() == 0);
+
+  uint64_t now = 1000;
+  busy.set_max_window(MAX_WINDOW, now);
+  assert(busy.enabled() && busy.window() == MAX_WINDOW);
+
+  //frequent events: twice the average interval
+  for (int i = 0; i < 100; ++i)
+  {
+    busy.woken(now += 10, true);
+  }
+  assert(busy.window() > 10 && busy.window() <= 30);
+
+  //rare events: spinning is off
+  for (int i = 0; i < 20; ++i)
+  {
+    busy.woken(now += 100000, false);
+  }
+  assert(busy.window() == 0);
+
+  //frequent again
+  for (int i = 0; i < 100; ++i)
+  {
+    busy.woken(now += 10, false);
+  }
+  assert(busy.window() > 0);
+
+  const BusyPollStats& stats = busy.stats();
+  assert(stats.spin_hits == 100 && stats.blocking_wakeups == 120);
+
+  busy.set_max_window(0, now);
+  assert(!busy.enabled() && busy.window() == 0);
+  std::cout << "window OK" << std::endl;
+}
+
+void
+test_dynamic(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+
+  int calls = 0;
+  Receiver r = {&calls};
+  ZmqReactor::Dynamic reactor;
+  reactor.add_handler(s.in, r);
+  reactor.set_busy_poll(MAX_WINDOW);
+  assert(reactor.busy_poll() == MAX_WINDOW);
+
+  //queued message is found while spinning
+  zmq::message_t msg(1);
+  s.out.send(msg);
+  ZmqReactor::PollResult res = reactor(-1);
+  assert(res == ZmqReactor::OK && calls == 1);
+  assert(reactor.busy_poll_stats().spin_hits == 1);
+  assert(reactor.busy_poll_stats().blocking_wakeups == 0);
+
+  //message comes after spin window
+  pthread_t thread;
+  ::pthread_create(&thread, 0, &delayed_send, &s.out);
+  res = reactor(-1);
+  ::pthread_join(thread, 0);
+  assert(res == ZmqReactor::OK && calls == 2);
+  assert(reactor.busy_poll_stats().spin_hits == 1);
+  assert(reactor.busy_poll_stats().blocking_wakeups == 1);
+
+  //timeout shorter than spin window
+  res = reactor(10);
+  assert(res == ZmqReactor::NONE_MATCHED);
+  std::cout << "dynamic OK" << std::endl;
+}
+
+void
+test_static(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+
+  int calls = 0;
+  Receiver r = {&calls};
+  ZmqReactor::StaticPtr reactor = ZmqReactor::make_static(s.in, r);
+  reactor->set_busy_poll(MAX_WINDOW);
+
+  zmq::message_t msg(1);
+  s.out.send(msg);
+  ZmqReactor::PollResult res = (*reactor)(-1);
+  assert(res == ZmqReactor::OK && calls == 1);
+  assert(reactor->busy_poll_stats().spin_hits == 1);
+  std::cout << "static OK" << std::endl;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_window();
+  zmq::context_t context(1);
+  test_dynamic(context);
+  test_static(context);
+  return 0;
+}
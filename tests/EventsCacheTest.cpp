@@ -0,0 +1,135 @@
+/**
+ * @file EventsCacheTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks events of sockets, cached by LibEvent reactor and reported
+ * by handlers (set_remaining_events): all messages are handled,
+ * hinted handlers need fewer ZMQ_EVENTS queries (if stats are compiled in),
+ * messages left after wrong hint are handled after force_check_events.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/LibEvent.hpp"
+
+static const int ROUNDS = 5;
+
+static const int BURST = 3;
+
+struct Drainer
+{
+  ZmqReactor::LibEvent* reactor;
+  int* received;
+  bool hint;
+  int limit; //messages per call, 0 - until EAGAIN
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    zmq::message_t msg;
+    for (int n = 0; !limit || n < limit; ++n)
+    {
+      if (!arg.socket->recv(&msg, ZMQ_NOBLOCK))
+      {
+        break;
+      }
+      ++*received;
+    }
+    if (hint)
+    {
+      reactor->set_remaining_events(0);
+    }
+    return true;
+  }
+};
+
+static void
+send_burst(zmq::socket_t& out)
+{
+  for (int i = 0; i < BURST; ++i)
+  {
+    Test::send_str(out, "x");
+  }
+}
+
+/**
+ * @return number of ZMQ_EVENTS queries, -1 if stats are not compiled in
+ */
+static long
+drain_rounds(zmq::context_t& context, bool hint)
+{
+  Test::SocketPair s(context);
+  int received = 0;
+  ZmqReactor::LibEvent reactor;
+  Drainer d = {&reactor, &received, hint, 0};
+  reactor.add_handler(s.in, ZMQ_POLLIN, d);
+
+  for (int round = 1; round <= ROUNDS; ++round)
+  {
+    send_burst(s.out);
+    for (int i = 0; i < 10 && received < round * BURST; ++i)
+    {
+      ZmqReactor::PollResult res = reactor(100000);
+      assert(res == ZmqReactor::OK);
+    }
+    assert(received == round * BURST);
+  }
+
+  ZmqReactor::ReactorStats st;
+  if (!reactor.stats(st))
+  {
+    return -1;
+  }
+  return static_cast<long>(st.events_queries);
+}
+
+void
+test_queries(zmq::context_t& context)
+{
+  const long plain = drain_rounds(context, false);
+  const long hinted = drain_rounds(context, true);
+  if (plain >= 0)
+  {
+    //hinted handler is not followed by query
+    assert(hinted < plain);
+  }
+}
+
+void
+test_wrong_hint(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+  int received = 0;
+  ZmqReactor::LibEvent reactor;
+  //receives one message, but claims there are no more
+  Drainer d = {&reactor, &received, true, 1};
+  ZmqReactor::LibEvent::HandlerDesc hd =
+    reactor.add_handler(s.in, ZMQ_POLLIN, d);
+
+  send_burst(s.out);
+  reactor.run(50000);
+  assert(received >= 1);
+
+  for (int i = 0; i < BURST && received < BURST; ++i)
+  {
+    reactor.force_check_events(hd);
+    reactor.run(50000);
+  }
+  assert(received == BURST);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+  test_queries(context);
+  test_wrong_hint(context);
+  std::cout << "events cache OK" << std::endl;
+  return 0;
+}
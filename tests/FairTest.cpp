@@ -0,0 +1,189 @@
+/**
+ * @file FairTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks FAIR dispatch mode of Dynamic reactor:
+ * dispatch start rotates between polls, each socket gets at most
+ * its budget of handler calls per poll, round limit is respected,
+ * all messages are handled in order,
+ * handlers may add handlers while called in batch.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+
+static const int SOCKETS = 3;
+static const int MESSAGES = 100;
+static const size_t BUDGET = 4;
+static const size_t ROUND_LIMIT = 6;
+
+struct Receiver
+{
+  std::vector<int>* calls; //socket index per handler call
+  int* last; //last sequence number of socket
+  int idx;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    zmq::message_t msg;
+    const bool received = arg.socket->recv(&msg, ZMQ_NOBLOCK);
+    assert(received);
+    assert(msg.size() == sizeof(int));
+    int seq;
+    memcpy(&seq, msg.data(), sizeof(seq));
+    assert(seq == *last + 1);
+    *last = seq;
+    calls->push_back(idx);
+    return true;
+  }
+};
+
+struct Noop
+{
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    return true;
+  }
+};
+
+/**
+ * Adds handler on each call, so handlers vector is reallocated
+ */
+struct Adder
+{
+  ZmqReactor::Dynamic* reactor;
+  int* received;
+  int fd;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    zmq::message_t msg;
+    const bool ok = arg.socket->recv(&msg, ZMQ_NOBLOCK);
+    assert(ok);
+    ++*received;
+    //this handler may be moved: members are not used after adding
+    reactor->add_handler(fd, ZMQ_POLLIN, Noop());
+    return true;
+  }
+};
+
+void
+test_adding_handlers(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+  for (size_t n = 0; n < BUDGET; ++n)
+  {
+    zmq::message_t msg(1);
+    s.out.send(msg);
+  }
+
+  int fds[2];
+  const int piped = ::pipe(fds);
+  assert(piped == 0);
+
+  int received = 0;
+  ZmqReactor::Dynamic reactor;
+  reactor.set_dispatch_mode(ZmqReactor::Dynamic::FAIR);
+  reactor.set_fair_limits(BUDGET);
+  Adder a = {&reactor, &received, fds[0]};
+  reactor.add_handler(s.in, a);
+
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  assert(received == static_cast<int>(BUDGET));
+  assert(reactor.num_handlers() == 1 + BUDGET);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+
+  Test::SocketPairs s(context, SOCKETS);
+
+  for (int n = 0; n < MESSAGES; ++n)
+  {
+    for (int i = 0; i < SOCKETS; ++i)
+    {
+      zmq::message_t msg(sizeof(n));
+      memcpy(msg.data(), &n, sizeof(n));
+      s[i].out.send(msg);
+    }
+  }
+
+  std::vector<int> calls;
+  std::vector<int> last(SOCKETS, -1);
+
+  ZmqReactor::Dynamic reactor;
+  reactor.set_dispatch_mode(ZmqReactor::Dynamic::FAIR);
+  reactor.set_fair_limits(BUDGET, ROUND_LIMIT);
+  assert(reactor.fair_budget() == BUDGET);
+  assert(reactor.fair_round_limit() == ROUND_LIMIT);
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    Receiver r = {&calls, &last[i], i};
+    reactor.add_handler(s[i].in, r);
+  }
+
+  //first rounds: budget for the first socket, rest of round limit
+  //for the next one, the third is served first in the next round
+  const int expected[][ROUND_LIMIT] = {
+    {0, 0, 0, 0, 1, 1},
+    {2, 2, 2, 2, 0, 0},
+    {1, 1, 1, 1, 2, 2},
+  };
+  for (int round = 0; round < 3; ++round)
+  {
+    calls.clear();
+    ZmqReactor::PollResult res = reactor(0);
+    assert(res == ZmqReactor::OK);
+    assert(calls.size() == ROUND_LIMIT);
+    for (size_t k = 0; k < ROUND_LIMIT; ++k)
+    {
+      assert(calls[k] == expected[round][k]);
+    }
+  }
+
+  //no round limit: every ready socket is served each round
+  reactor.set_fair_limits(BUDGET);
+  calls.clear();
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  assert(calls.size() == SOCKETS * BUDGET);
+
+  size_t total = 0;
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    total += last[i] + 1;
+  }
+  while (reactor(0) == ZmqReactor::OK)
+  {
+  }
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    assert(last[i] == MESSAGES - 1);
+  }
+  assert(total == 3 * ROUND_LIMIT + SOCKETS * BUDGET);
+
+  test_adding_handlers(context);
+
+  std::cout << "fair OK" << std::endl;
+  return 0;
+}
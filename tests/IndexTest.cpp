@@ -0,0 +1,148 @@
+/**
+ * @file IndexTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks hash index of handlers (repeated keys, erase, growth)
+ * and socket lookup and replacement in Dynamic, Epoll and LibEvent
+ * reactors, which use it.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+#include <set>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Epoll.hpp"
+#include "zmqreactor/LibEvent.hpp"
+#include "zmqreactor/details/HashIndex.hpp"
+
+typedef ZmqReactor::Private::HashIndex<int> Index;
+
+static const int KEYS = 10000;
+
+struct Noop
+{
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    return true;
+  }
+};
+
+static std::set<int>
+values(const Index& index, Index::Key key)
+{
+  std::set<int> res;
+  for (int pos = -1; index.find_next(key, pos); )
+  {
+    res.insert(index.value(pos));
+  }
+  return res;
+}
+
+void
+test_index()
+{
+  Index index;
+  assert(values(index, Index::fd_key(1)).empty());
+
+  //descriptors and aligned pointers do not collide
+  std::vector<zmq::socket_t*> ptrs;
+  for (int i = 0; i < KEYS; ++i)
+  {
+    ptrs.push_back(reinterpret_cast<zmq::socket_t*>(0x1000 + i * 8));
+    index.insert(Index::socket_key(ptrs.back()), i);
+    index.insert(Index::fd_key(i), KEYS + i);
+  }
+  assert(index.size() == 2 * KEYS);
+  for (int i = 0; i < KEYS; ++i)
+  {
+    std::set<int> v = values(index, Index::socket_key(ptrs[i]));
+    assert(v.size() == 1 && *v.begin() == i);
+    v = values(index, Index::fd_key(i));
+    assert(v.size() == 1 && *v.begin() == KEYS + i);
+  }
+
+  //repeated key
+  index.insert(Index::fd_key(7), 1);
+  index.insert(Index::fd_key(7), 2);
+  std::set<int> v = values(index, Index::fd_key(7));
+  assert(v.size() == 3 && v.count(1) && v.count(2) && v.count(KEYS + 7));
+
+  bool res = index.erase(Index::fd_key(7), 2);
+  assert(res);
+  res = index.erase(Index::fd_key(7), 2);
+  assert(!res);
+  res = index.update(Index::fd_key(7), 1, 5);
+  assert(res);
+  v = values(index, Index::fd_key(7));
+  assert(v.size() == 2 && v.count(5) && v.count(KEYS + 7));
+
+  //churn: erased entries are dropped, table does not grow forever
+  for (int n = 0; n < 10; ++n)
+  {
+    for (int i = 0; i < KEYS; ++i)
+    {
+      res = index.erase(Index::socket_key(ptrs[i]), i);
+      assert(res);
+    }
+    for (int i = 0; i < KEYS; ++i)
+    {
+      index.insert(Index::socket_key(ptrs[i]), i);
+    }
+  }
+  assert(index.size() == 2 * KEYS + 1);
+  assert(index.find(Index::socket_key(ptrs[KEYS - 1]), KEYS - 1) >= 0);
+
+  index.clear();
+  assert(index.size() == 0);
+  assert(values(index, Index::fd_key(7)).empty());
+
+  std::cout << "index OK" << std::endl;
+}
+
+template <typename ReactorT>
+void
+test_replace(zmq::context_t& context)
+{
+  zmq::socket_t s1(context, ZMQ_PAIR), s2(context, ZMQ_PAIR),
+    s3(context, ZMQ_PAIR);
+
+  ReactorT reactor;
+  reactor.add_handler(s1, Noop());
+  reactor.add_handler(s2, Noop());
+  assert(reactor.disable_handler(s2));
+  assert(!reactor.disable_handler(s3));
+
+  assert(reactor.replace_socket(&s2, &s3) == 1);
+  assert(!reactor.enable_handler(s2));
+  assert(reactor.enable_handler(s3));
+  assert(reactor.replace_socket(&s2, &s3) == 0);
+  assert(reactor.disable_handler(s1));
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_index();
+
+  zmq::context_t context(1);
+  test_replace<ZmqReactor::Dynamic>(context);
+  test_replace<ZmqReactor::Epoll>(context);
+  test_replace<ZmqReactor::LibEvent>(context);
+
+  ZmqReactor::Dynamic reactor;
+  zmq::socket_t s1(context, ZMQ_PAIR), s2(context, ZMQ_PAIR);
+  reactor.add_handler(s1, Noop());
+  assert(reactor.replace_handler(s1, Noop()));
+  assert(!reactor.replace_handler(s2, Noop()));
+
+  std::cout << "replace OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file InplaceHandlerTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks InplaceHandler: small functors (including bound member function
+ * with a parameter, as in ReactorsTest) are stored inline, bigger ones
+ * on heap; copying, assignment and clear() of both storage kinds
+ * keep functors alive exactly while handlers hold them;
+ * strict handler accepts functor fitting its storage.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <tr1/functional>
+
+#include "zmqreactor/InplaceHandler.hpp"
+
+typedef ZmqReactor::InplaceHandler<> Handler;
+
+static const ZmqReactor::Arg arg = {0, 0, 0};
+
+static int alive = 0; //number of existing functors
+static int last_id = 0; //id of the last called functor
+static const void* last_called = 0; //address of the last called functor
+
+/**
+ * Functor of at least Pad bytes, counting its copies
+ */
+template <size_t Pad>
+struct Tracked
+{
+  char pad[Pad];
+  int id;
+
+  explicit
+  Tracked(int i) : id(i)
+  {
+    ++alive;
+  }
+
+  Tracked(const Tracked& other) : id(other.id)
+  {
+    ++alive;
+  }
+
+  ~Tracked()
+  {
+    --alive;
+  }
+
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    last_id = id;
+    last_called = this;
+    return true;
+  }
+};
+
+typedef Tracked<sizeof(void*)> Small;
+typedef Tracked<ZmqReactor::INPLACE_HANDLER_SIZE> Big;
+
+struct Param
+{
+  int a, b, c, d;
+};
+
+struct Cls
+{
+  bool
+  handle(ZmqReactor::Arg, Param)
+  {
+    return true;
+  }
+};
+
+template <typename FunT>
+bool
+fits(const FunT&)
+{
+  return Handler::Fits<FunT>::value;
+}
+
+/**
+ * Calls handler, checks called functor
+ * @return whether functor is stored inside handler
+ */
+static bool
+call_inline(Handler& h, int id)
+{
+  assert(!h.empty());
+  assert(h(arg));
+  assert(last_id == id);
+  const char* begin = reinterpret_cast<const char*>(&h);
+  const char* called = static_cast<const char*>(last_called);
+  return called >= begin && called < begin + sizeof(h);
+}
+
+void
+test_fits()
+{
+  assert(Handler::Fits<Small>::value);
+  assert(!Handler::Fits<Big>::value);
+  assert((ZmqReactor::InplaceHandler<sizeof(Big)>::Fits<Big>::value));
+
+  //handler of ReactorsTest, 48 bytes on 64-bit platforms
+  Cls cls;
+  Param param = {1, 2, 3, 4};
+  if (sizeof(void*) == 8)
+  {
+    assert(fits(std::tr1::bind(
+      std::tr1::mem_fn(&Cls::handle), &cls,
+      std::tr1::placeholders::_1, param)));
+  }
+  std::cout << "fits OK" << std::endl;
+}
+
+/**
+ * Copying, assignment and clearing of handlers of the same storage kind
+ */
+template <typename FunT>
+void
+test_copy(bool inplace)
+{
+  {
+    Handler h = FunT(1);
+    assert(alive == 1);
+    assert(call_inline(h, 1) == inplace);
+
+    Handler copy(h);
+    assert(alive == 2);
+    assert(call_inline(copy, 1) == inplace);
+
+    Handler assigned = FunT(2);
+    assert(alive == 3);
+    assigned = h;
+    assert(alive == 3);
+    assert(call_inline(assigned, 1) == inplace);
+
+    const Handler& self = assigned;
+    assigned = self;
+    assert(alive == 3);
+    assert(call_inline(assigned, 1) == inplace);
+
+    copy.clear();
+    assert(copy.empty());
+    assert(alive == 2);
+    copy.clear();
+    assert(alive == 2);
+
+    //empty is assigned and copied
+    assigned = copy;
+    assert(assigned.empty());
+    assert(alive == 1);
+    Handler empty_copy(copy);
+    assert(empty_copy.empty());
+
+    //cleared handler is reused
+    copy = h;
+    assert(alive == 2);
+    assert(call_inline(copy, 1) == inplace);
+  }
+  assert(alive == 0);
+}
+
+/**
+ * Assignment between inline and heap handlers
+ */
+void
+test_mixed()
+{
+  {
+    Handler small = Small(1);
+    Handler big = Big(2);
+    assert(alive == 2);
+
+    Handler h = small;
+    assert(call_inline(h, 1));
+    h = big;
+    assert(alive == 3);
+    assert(!call_inline(h, 2));
+    h = small;
+    assert(alive == 3);
+    assert(call_inline(h, 1));
+  }
+  assert(alive == 0);
+  std::cout << "mixed OK" << std::endl;
+}
+
+void
+test_strict()
+{
+  {
+    ZmqReactor::InplaceHandler<sizeof(Big), true> h = Big(3);
+    assert(alive == 1);
+    assert(h(arg) && last_id == 3);
+    ZmqReactor::InplaceHandler<sizeof(Big), true> copy(h);
+    assert(alive == 2);
+  }
+  assert(alive == 0);
+  std::cout << "strict OK" << std::endl;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  Handler h;
+  assert(h.empty());
+  h.clear();
+  assert(h.empty());
+
+  test_fits();
+  test_copy<Small>(true);
+  std::cout << "inline OK" << std::endl;
+  test_copy<Big>(false);
+  std::cout << "heap OK" << std::endl;
+  test_mixed();
+  test_strict();
+  return 0;
+}
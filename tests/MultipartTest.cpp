@@ -0,0 +1,182 @@
+/**
+ * @file MultipartTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks multipart handlers (add_multipart_handler):
+ * all frames are received, envelope and body are split
+ * for ROUTER socket, but not for PULL socket (empty frame is data there),
+ * frame objects are reused between messages in Dynamic,
+ * Epoll and LibEvent reactors.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Epoll.hpp"
+#include "zmqreactor/LibEvent.hpp"
+
+using ZmqReactor::Multipart;
+
+typedef std::vector<std::string> Strings;
+
+static std::string
+str(const zmq::message_t& msg)
+{
+  return std::string(static_cast<const char*>(msg.data()), msg.size());
+}
+
+static Strings
+strings(const Multipart& parts)
+{
+  Strings res;
+  for (size_t i = 0; i < parts.size(); ++i)
+  {
+    res.push_back(str(parts[i]));
+  }
+  return res;
+}
+
+struct Collector
+{
+  std::vector<Strings>* envelopes;
+  std::vector<Strings>* bodies;
+  std::vector<const zmq::message_t*>* first_frames;
+
+  bool
+  operator() (ZmqReactor::Arg arg, Multipart msg)
+  {
+    assert(arg.events == ZMQ_POLLIN);
+    assert(msg.size() == msg.envelope().size() + msg.body().size() +
+      (msg.has_envelope() ? 1 : 0));
+    envelopes->push_back(strings(msg.envelope()));
+    bodies->push_back(strings(msg.body()));
+    first_frames->push_back(&msg[0]);
+    return true;
+  }
+};
+
+static void
+send(zmq::socket_t& socket, const char* parts[])
+{
+  for (; *parts; ++parts)
+  {
+    Test::send_str(socket, *parts, parts[1] ? ZMQ_SNDMORE : 0);
+  }
+}
+
+struct Fixture : Test::SocketPair
+{
+  bool routed; //in is ROUTER: peer's identity starts messages
+  std::vector<Strings> envelopes, bodies;
+  std::vector<const zmq::message_t*> first_frames;
+
+  Fixture(zmq::context_t& context, int in_type, int out_type) :
+    Test::SocketPair(context, in_type, out_type, false),
+    routed(in_type == ZMQ_XREP)
+  {
+    out.setsockopt(ZMQ_IDENTITY, "peer", 4);
+    connect();
+  }
+
+  Collector
+  collector()
+  {
+    Collector c = {&envelopes, &bodies, &first_frames};
+    return c;
+  }
+
+  void
+  send_all()
+  {
+    const char* request[] = {"hop", "", "cmd", "arg", 0};
+    const char* plain[] = {"one", "two", "three", 0};
+    send(out, request);
+    send(out, plain);
+    send(out, request);
+  }
+
+  void
+  check()
+  {
+    assert(bodies.size() == 3);
+
+    if (routed)
+    {
+      assert(envelopes[0].size() == 2);
+      assert(envelopes[0][0] == "peer" && envelopes[0][1] == "hop");
+      assert(bodies[0].size() == 2);
+      assert(bodies[0][0] == "cmd" && bodies[0][1] == "arg");
+
+      //no delimiter
+      assert(envelopes[1].empty());
+      assert(bodies[1].size() == 4);
+      assert(bodies[1][0] == "peer" && bodies[1][3] == "three");
+    }
+    else
+    {
+      //empty frame is data, not delimiter
+      assert(envelopes[0].empty());
+      assert(bodies[0].size() == 4);
+      assert(bodies[0][0] == "hop" && bodies[0][1].empty());
+
+      assert(envelopes[1].empty());
+      assert(bodies[1].size() == 3);
+      assert(bodies[1][0] == "one" && bodies[1][2] == "three");
+    }
+
+    assert(envelopes[2] == envelopes[0] && bodies[2] == bodies[0]);
+
+    //frame objects are reused
+    assert(first_frames[1] == first_frames[0]);
+    assert(first_frames[2] == first_frames[0]);
+  }
+};
+
+template <typename ReactorT>
+void
+test_reactor(zmq::context_t& context, int in_type, int out_type)
+{
+  Fixture f(context, in_type, out_type);
+  ReactorT reactor;
+  reactor.add_multipart_handler(f.in, f.collector(), ZmqReactor::Poll::BATCH);
+  f.send_all();
+  for (int i = 0; i < 3 && f.bodies.size() < 3; ++i)
+  {
+    ZmqReactor::PollResult res = reactor(0);
+    assert(res == ZmqReactor::OK);
+  }
+  f.check();
+}
+
+void
+test_libevent(zmq::context_t& context, int in_type, int out_type)
+{
+  Fixture f(context, in_type, out_type);
+  ZmqReactor::LibEvent reactor;
+  f.send_all();
+  reactor.add_multipart_handler(f.in, f.collector());
+  reactor.run(50000);
+  f.check();
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+  test_reactor<ZmqReactor::Dynamic>(context, ZMQ_XREP, ZMQ_XREQ);
+  test_reactor<ZmqReactor::Epoll>(context, ZMQ_XREP, ZMQ_XREQ);
+  test_libevent(context, ZMQ_XREP, ZMQ_XREQ);
+  test_reactor<ZmqReactor::Dynamic>(context, ZMQ_PULL, ZMQ_PUSH);
+  test_reactor<ZmqReactor::Epoll>(context, ZMQ_PULL, ZMQ_PUSH);
+  test_libevent(context, ZMQ_PULL, ZMQ_PUSH);
+  std::cout << "multipart OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file OffloadTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks offloading handlers to worker pool:
+ * messages of each socket are handled in order,
+ * number of messages in flight does not exceed limit
+ * (source is paused and resumed), all messages are handled.
+ * Exceptions of handlers and jobs are caught in workers.
+ * Offload works with reactor of PackedHandler handlers.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Offload.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+#include "zmqreactor/details/Atomic.hpp"
+
+static const int SOCKETS = 3;
+static const int MESSAGES = 2000;
+static const size_t LIMIT = 16;
+
+typedef ZmqReactor::Offload<ZmqReactor::Dynamic> Offload;
+
+struct Handler
+{
+  Offload* offload;
+  int idx;
+  int* last; //last sequence number, accessed by one worker at a time
+  long* total;
+
+  void
+  operator() (ZmqReactor::OffloadMessage& msg)
+  {
+    assert(msg.size() == 2);
+    assert(msg[0].size() == sizeof(int));
+    int seq;
+    memcpy(&seq, msg[0].data(), sizeof(seq));
+    assert(seq == *last + 1);
+    *last = seq;
+    assert(offload->in_flight(idx) <= LIMIT);
+    if (seq % 100 == 0)
+    {
+      ::usleep(1000); //slow handler
+    }
+    ZmqReactor::Private::atomic_add(*total, 1L);
+  }
+};
+
+struct Checker
+{
+  long* total;
+
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    return ZmqReactor::Private::atomic_add(*total, 0L) <
+      static_cast<long>(SOCKETS) * MESSAGES;
+  }
+};
+
+static void
+send_part(zmq::socket_t& sock, const void* data, size_t size, int flags)
+{
+  zmq::message_t msg(size);
+  memcpy(msg.data(), data, size);
+  sock.send(msg, flags);
+}
+
+static const int FAILING = 10;
+
+/**
+ * Throws on the 4th message
+ */
+struct FailingHandler
+{
+  long* total;
+
+  void
+  operator() (ZmqReactor::OffloadMessage& msg)
+  {
+    int seq;
+    memcpy(&seq, msg[0].data(), sizeof(seq));
+    if (seq == 3)
+    {
+      throw std::runtime_error("handler failed");
+    }
+    ZmqReactor::Private::atomic_add(*total, 1L);
+  }
+};
+
+template <typename ReactorT>
+void
+test_handler_failure(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+  for (int n = 0; n < FAILING; ++n)
+  {
+    send_part(s.out, &n, sizeof(n), 0);
+  }
+
+  long total = 0;
+  ReactorT reactor;
+  ZmqReactor::WorkerPool workers(2);
+  ZmqReactor::Offload<ReactorT> offload(reactor, workers);
+  FailingHandler h = {&total};
+  offload.add_handler(s.in, h);
+
+  //failure cancels polling
+  ZmqReactor::PollResult res = reactor.run(10000000);
+  assert(res == ZmqReactor::CANCELLED);
+
+  //the rest of messages are handled
+  for (int i = 0; i < 1000 && offload.in_flight(0) > 0; ++i)
+  {
+    reactor(1000);
+  }
+  assert(offload.in_flight(0) == 0);
+  assert(offload.failures(0) == 1);
+  assert(total == FAILING - 1);
+}
+
+static void
+throwing_job(void*)
+{
+  throw std::runtime_error("job failed");
+}
+
+static void
+counting_job(void* ctx)
+{
+  ZmqReactor::Private::atomic_add(*static_cast<long*>(ctx), 1L);
+}
+
+void
+test_job_failure()
+{
+  long done = 0;
+  ZmqReactor::WorkerPool workers(1);
+  workers.submit(&throwing_job, 0);
+  workers.submit(&counting_job, &done);
+  //the only worker keeps running
+  for (int i = 0; i < 1000 && !ZmqReactor::Private::atomic_add(done, 0L); ++i)
+  {
+    ::usleep(1000);
+  }
+  assert(done == 1);
+  assert(workers.failed_jobs() == 1);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+
+  Test::SocketPairs s(context, SOCKETS);
+
+  //all messages are queued before reactor starts,
+  //so reactor has to pause sources
+  for (int n = 0; n < MESSAGES; ++n)
+  {
+    for (int i = 0; i < SOCKETS; ++i)
+    {
+      send_part(s[i].out, &n, sizeof(n), ZMQ_SNDMORE);
+      send_part(s[i].out, "payload", 7, 0);
+    }
+  }
+
+  std::vector<int> last(SOCKETS, -1);
+  long total = 0;
+  {
+    ZmqReactor::Dynamic reactor;
+    ZmqReactor::WorkerPool workers(4);
+    Offload offload(reactor, workers);
+
+    for (int i = 0; i < SOCKETS; ++i)
+    {
+      Handler h = {&offload, i, &last[i], &total};
+      offload.add_handler(s[i].in, h, LIMIT);
+    }
+    Checker c = {&total};
+    reactor.add_timeout(1000, c, true);
+
+    ZmqReactor::PollResult res = reactor.run(10000000);
+    assert(res == ZmqReactor::CANCELLED);
+  }
+
+  assert(total == static_cast<long>(SOCKETS) * MESSAGES);
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    assert(last[i] == MESSAGES - 1);
+  }
+
+  test_handler_failure<ZmqReactor::Dynamic>(context);
+  //internal handlers are added to reactor of non-owning handlers
+  test_handler_failure<ZmqReactor::BasicDynamic<ZmqReactor::PackedHandler> >(
+    context);
+  test_job_failure();
+
+  std::cout << "offload OK" << std::endl;
+  return 0;
+}
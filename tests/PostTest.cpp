@@ -0,0 +1,229 @@
+/**
+ * @file PostTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks posting tasks to Dynamic reactor:
+ * burst of posts is drained by one poll operation,
+ * tasks from concurrent producers are called in their posting order,
+ * task returning false cancels polling, tasks after a throwing one
+ * are called on the next poll,
+ * posting to reactor of PackedHandler handlers.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+#include <pthread.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+
+static const int PRODUCERS = 4;
+static const int TASKS = 10000;
+
+struct Counter
+{
+  std::vector<int>* last; //last sequence number per producer
+  int producer;
+  int seq;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    assert(!arg.socket && !arg.fd && !arg.events);
+    assert((*last)[producer] == seq - 1);
+    (*last)[producer] = seq;
+    return true;
+  }
+};
+
+struct Stopper
+{
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    return false;
+  }
+};
+
+struct Thrower
+{
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    throw std::runtime_error("task failed");
+  }
+};
+
+struct Producer
+{
+  ZmqReactor::Dynamic* reactor;
+  std::vector<int>* last;
+  int id;
+};
+
+static void*
+produce(void* arg)
+{
+  Producer* p = static_cast<Producer*>(arg);
+  for (int i = 0; i < TASKS; ++i)
+  {
+    Counter c = {p->last, p->id, i};
+    p->reactor->post(c);
+  }
+  return 0;
+}
+
+struct Finisher
+{
+  ZmqReactor::Dynamic* reactor;
+  std::vector<pthread_t>* producers;
+};
+
+/**
+ * Waits for producers, then stops reactor
+ */
+static void*
+finish(void* arg)
+{
+  Finisher* f = static_cast<Finisher*>(arg);
+  for (size_t i = 0; i < f->producers->size(); ++i)
+  {
+    ::pthread_join((*f->producers)[i], 0);
+  }
+  f->reactor->post(Stopper());
+  return 0;
+}
+
+void
+test_burst()
+{
+  ZmqReactor::Dynamic reactor;
+  reactor.enable_post();
+  assert(reactor.num_handlers() == 1);
+
+  std::vector<int> last(1, -1);
+  for (int i = 0; i < TASKS; ++i)
+  {
+    Counter c = {&last, 0, i};
+    reactor.post(c);
+  }
+  ZmqReactor::PollResult res = reactor(1000000);
+  assert(res == ZmqReactor::OK);
+  assert(last[0] == TASKS - 1);
+
+  //nothing left
+  res = reactor(10000);
+  assert(res == ZmqReactor::NONE_MATCHED);
+
+  std::cout << "burst OK" << std::endl;
+}
+
+void
+test_producers()
+{
+  ZmqReactor::Dynamic reactor;
+  reactor.enable_post();
+
+  std::vector<int> last(PRODUCERS, -1);
+  std::vector<Producer> producers(PRODUCERS);
+  std::vector<pthread_t> threads(PRODUCERS);
+  for (int i = 0; i < PRODUCERS; ++i)
+  {
+    Producer p = {&reactor, &last, i};
+    producers[i] = p;
+    const int err = ::pthread_create(&threads[i], 0, &produce, &producers[i]);
+    assert(!err);
+  }
+  Finisher f = {&reactor, &threads};
+  pthread_t finisher;
+  const int err = ::pthread_create(&finisher, 0, &finish, &f);
+  assert(!err);
+
+  //tasks are called while producers post
+  ZmqReactor::PollResult res = reactor.run(5000000);
+  ::pthread_join(finisher, 0);
+  assert(res == ZmqReactor::CANCELLED);
+  for (int i = 0; i < PRODUCERS; ++i)
+  {
+    assert(last[i] == TASKS - 1);
+  }
+
+  std::cout << "producers OK" << std::endl;
+}
+
+void
+test_packed()
+{
+  //internal handler of eventfd is added to reactor of non-owning handlers
+  ZmqReactor::BasicDynamic<ZmqReactor::PackedHandler> reactor;
+  reactor.enable_post();
+  assert(reactor.num_handlers() == 1);
+
+  std::vector<int> last(1, -1);
+  for (int i = 0; i < 3; ++i)
+  {
+    Counter c = {&last, 0, i};
+    reactor.post(c);
+  }
+  ZmqReactor::PollResult res = reactor(1000000);
+  assert(res == ZmqReactor::OK);
+  assert(last[0] == 2);
+
+  reactor.post(Stopper());
+  res = reactor(1000000);
+  assert(res == ZmqReactor::CANCELLED);
+
+  std::cout << "packed OK" << std::endl;
+}
+
+void
+test_throwing()
+{
+  ZmqReactor::Dynamic reactor;
+  reactor.enable_post();
+
+  std::vector<int> last(1, -1);
+  Counter c0 = {&last, 0, 0};
+  reactor.post(c0);
+  reactor.post(Thrower());
+  Counter c1 = {&last, 0, 1};
+  reactor.post(c1);
+  Counter c2 = {&last, 0, 2};
+  reactor.post(c2);
+
+  bool thrown = false;
+  try
+  {
+    reactor(0);
+  }
+  catch (const std::runtime_error&)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(last[0] == 0);
+
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  assert(last[0] == 2);
+
+  std::cout << "throwing OK" << std::endl;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_burst();
+  test_producers();
+  test_packed();
+  test_throwing();
+  return 0;
+}
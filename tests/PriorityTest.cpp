@@ -0,0 +1,146 @@
+/**
+ * @file PriorityTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks handler priorities: ready high priority handlers are called
+ * before normal and low priority ones in Dynamic (all dispatch modes),
+ * Static and LibEvent reactors; low priority handlers are deferred
+ * when FAIR mode round limit is exhausted.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Static.hpp"
+#include "zmqreactor/LibEvent.hpp"
+
+static const int SOCKETS = 3;
+
+/**
+ * Priorities of sockets: registered from the lowest
+ */
+static const short EVENTS[SOCKETS] = {
+  ZMQ_POLLIN | ZmqReactor::Poll::LOW_PRIORITY,
+  ZMQ_POLLIN,
+  ZMQ_POLLIN | ZmqReactor::Poll::HIGH_PRIORITY
+};
+
+struct Recorder
+{
+  std::vector<int>* order;
+  int idx;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    assert(arg.events == ZMQ_POLLIN);
+    zmq::message_t msg;
+    const bool received = arg.socket->recv(&msg, ZMQ_NOBLOCK);
+    assert(received);
+    order->push_back(idx);
+    return true;
+  }
+};
+
+static Recorder
+rec(std::vector<int>& order, int idx)
+{
+  Recorder r = {&order, idx};
+  return r;
+}
+
+static void
+check_order(const std::vector<int>& order)
+{
+  assert(order.size() == SOCKETS);
+  assert(order[0] == 2 && order[1] == 1 && order[2] == 0);
+}
+
+void
+test_dynamic(zmq::context_t& context, ZmqReactor::Dynamic::DispatchMode mode)
+{
+  Test::SocketPairs s(context, SOCKETS);
+  std::vector<int> order;
+  ZmqReactor::Dynamic reactor;
+  reactor.set_dispatch_mode(mode);
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    reactor.add_handler(s[i].in, EVENTS[i], rec(order, i));
+  }
+  s.send_all();
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  check_order(order);
+}
+
+void
+test_fair_deferred(zmq::context_t& context)
+{
+  Test::SocketPairs s(context, SOCKETS);
+  std::vector<int> order;
+  ZmqReactor::Dynamic reactor;
+  reactor.set_dispatch_mode(ZmqReactor::Dynamic::FAIR);
+  reactor.set_fair_limits(1, 2);
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    reactor.add_handler(s[i].in, EVENTS[i], rec(order, i));
+  }
+  s.send_all();
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  assert(order.size() == 2 && order[0] == 2 && order[1] == 1);
+  res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  check_order(order);
+}
+
+void
+test_static(zmq::context_t& context)
+{
+  Test::SocketPairs s(context, SOCKETS);
+  std::vector<int> order;
+  ZmqReactor::StaticPtr reactor = ZmqReactor::make_static(
+    s[0].in, rec(order, 0), EVENTS[0],
+    s[1].in, rec(order, 1), EVENTS[1],
+    s[2].in, rec(order, 2), EVENTS[2]);
+  s.send_all();
+  ZmqReactor::PollResult res = (*reactor)(0);
+  assert(res == ZmqReactor::OK);
+  check_order(order);
+}
+
+void
+test_libevent(zmq::context_t& context)
+{
+  Test::SocketPairs s(context, SOCKETS);
+  std::vector<int> order;
+  ZmqReactor::LibEvent reactor;
+  s.send_all();
+  for (int i = 0; i < SOCKETS; ++i)
+  {
+    reactor.add_handler(s[i].in, EVENTS[i], rec(order, i));
+  }
+  reactor.run(50000);
+  check_order(order);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+  test_dynamic(context, ZmqReactor::Dynamic::SCAN);
+  test_dynamic(context, ZmqReactor::Dynamic::READY_LIST);
+  test_dynamic(context, ZmqReactor::Dynamic::FAIR);
+  test_fair_deferred(context);
+  test_static(context);
+  test_libevent(context);
+  std::cout << "priority OK" << std::endl;
+  return 0;
+}
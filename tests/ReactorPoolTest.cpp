@@ -0,0 +1,137 @@
+/**
+ * @file ReactorPoolTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks pool of reactor threads: shard selection,
+ * cancelling by handler in one shard stops others,
+ * stop() from other thread and run with timeout,
+ * pool of reactors of PackedHandler handlers.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/ReactorPool.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+
+using ZmqReactor::ReactorPool;
+
+struct PipeReader
+{
+  int* calls;
+  int forward_fd;
+  bool ret;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    char c;
+    const ssize_t got = ::read(arg.fd, &c, 1);
+    assert(got == 1);
+    ++*calls;
+    if (forward_fd != -1)
+    {
+      const ssize_t put = ::write(forward_fd, &c, 1);
+      assert(put == 1);
+    }
+    return ret;
+  }
+};
+
+static PipeReader
+reader(int& calls, bool ret, int forward_fd = -1)
+{
+  PipeReader r = {&calls, forward_fd, ret};
+  return r;
+}
+
+void
+test_cancel()
+{
+  int a[2], b[2];
+  const int pa = ::pipe(a), pb = ::pipe(b);
+  assert(pa == 0 && pb == 0);
+
+  int calls_a = 0, calls_b = 0;
+  ReactorPool pool(2, ReactorPool::LEAST_LOADED);
+  assert(pool.num_shards() == 2);
+
+  //handler of a (shard 0) wakes up handler of b (shard 1), which cancels
+  const size_t shard_a =
+    pool.add_handler(a[0], ZmqReactor::Poll::IN, reader(calls_a, true, b[1]));
+  const size_t shard_b =
+    pool.add_handler(b[0], ZmqReactor::Poll::IN, reader(calls_b, false));
+  assert(shard_a != shard_b);
+  assert(pool.load(0) == 1 && pool.load(1) == 1);
+
+  const ssize_t put = ::write(a[1], "x", 1);
+  assert(put == 1);
+  ZmqReactor::PollResult res = pool.run(5000000);
+
+  assert(res == ZmqReactor::CANCELLED);
+  assert(pool.result(shard_b) == ZmqReactor::CANCELLED);
+  //shard a has been stopped by pool
+  assert(pool.result(shard_a) == ZmqReactor::CANCELLED);
+  assert(calls_a == 1 && calls_b == 1);
+  assert(!pool.running());
+
+  for (int i = 0; i < 2; ++i)
+  {
+    ::close(a[i]);
+    ::close(b[i]);
+  }
+  std::cout << "cancel OK" << std::endl;
+}
+
+void
+test_stop_and_timeout()
+{
+  ReactorPool pool(3, ReactorPool::HASH);
+
+  pool.start();
+  assert(pool.running());
+  ::usleep(10000);
+  pool.stop();
+  ZmqReactor::PollResult res = pool.join();
+  assert(res == ZmqReactor::CANCELLED);
+
+  //restart: previous stop request is forgotten
+  res = pool.run(20000);
+  assert(res == ZmqReactor::NONE_MATCHED);
+  for (size_t i = 0; i < pool.num_shards(); ++i)
+  {
+    assert(pool.result(i) == ZmqReactor::NONE_MATCHED);
+  }
+  std::cout << "stop and timeout OK" << std::endl;
+}
+
+void
+test_packed()
+{
+  //stop handlers are added to reactors of non-owning handlers
+  ZmqReactor::BasicReactorPool<
+    ZmqReactor::BasicDynamic<ZmqReactor::PackedHandler> > pool(2);
+
+  pool.start();
+  ::usleep(10000);
+  pool.stop();
+  ZmqReactor::PollResult res = pool.join();
+  assert(res == ZmqReactor::CANCELLED);
+  std::cout << "packed OK" << std::endl;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_cancel();
+  test_stop_and_timeout();
+  test_packed();
+  return 0;
+}
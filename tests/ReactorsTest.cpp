@@ -4,24 +4,23 @@
  *
  * \test
  * \brief
- * Performs poll for different types of reactors 9static, dynamic)
+ * Performs poll for different types of reactors (static, dynamic, epoll, libevent)
  * and for raw zmq poll api.
  *
  * Reactors dispatch requests to following handlers types:
  * \li bound member function.
  * \li bound member function with additional (big) parameter,
- * which probably wouldn/t fit into internal buffer of tr1::function object,
- * so dynamic memory allocation should occur for Dynamic reactor.
+ * which wouldn't fit into internal buffer of tr1::function object,
+ * but still fits inline storage of Dynamic reactor's handlers.
  * \li raw function pointer
  *
- * To measure this overhead we may parameterize test
- * with number of iterations and to see the consumed time.
- * Ex:
+ * Test may be parameterized with number of iterations:
  * \code
  * $ ./ReactorsTest 100000
  * \endcode
  * Number of iterations means the number of "event sets" dispatched,
  * each reactor is created just once.
+ * To measure reactors' overhead use zmqreactor_bench (see bench directory).
  */
 
 #include "stdlib.h"
@@ -39,6 +38,7 @@
 #include <pthread.h>
 
 #include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Epoll.hpp"
 #include "zmqreactor/Static.hpp"
 #include "zmqreactor/LibEvent.hpp"
 
@@ -258,20 +258,19 @@ int run_raw(SomeStatefulCls& cls, zmq::socket_t* socks[], int num)
 
 enum ServerRunMode
 {
-  DYNAMIC = 0, STATIC, LIBEVENT, RAW
+  DYNAMIC = 0, STATIC, LIBEVENT, RAW, EPOLL
 };
 
-static const char* MODES[] = {"DYNAMIC", "STATIC", "LIBEVENT", "RAW"};
+static const char* MODES[] = {"DYNAMIC", "STATIC", "LIBEVENT", "RAW", "EPOLL"};
 
 struct ServerRunResult
 {
   int handled_1, handled_2, handled_3;
-  double elapsed;
   const ServerRunMode mode;
 
   explicit
   ServerRunResult(ServerRunMode m) :
-    handled_1(0), handled_2(0), handled_3(0), elapsed(0.), mode(m)
+    handled_1(0), handled_2(0), handled_3(0), mode(m)
   {}
 };
 
@@ -299,9 +298,6 @@ void* server_fun(void* param)
     SomeStatefulCls cls;
     handled_free = 0;
 
-    clock_t start, finish;
-    start = clock();
-
     //dynamic
     switch (result.mode)
     {
@@ -321,6 +317,22 @@ void* server_fun(void* param)
       r.run();
       break;
     }
+    case EPOLL:
+    {
+      ZmqReactor::Epoll r;
+      for (int i = 0; i < sockets_num; ++i)
+      {
+        r.add_handler(*sockets_1[i], ZMQ_POLLIN, std::bind1st(std::mem_fun(&SomeStatefulCls::handle_1), &cls));
+        r.add_handler(*sockets_2[i], std::tr1::bind(
+            std::tr1::mem_fn(&SomeStatefulCls::handle_2), &cls,
+            std::tr1::placeholders::_1, some_param
+        ));
+        //free fun
+        r.add_handler(*sockets_3[i], std::ptr_fun(&free_handler));
+      }
+      r.run();
+      break;
+    }
     case STATIC:
     {
       assert(sockets_num == 1);
@@ -364,19 +376,15 @@ void* server_fun(void* param)
     }
     }
 
-    finish = clock();
-    double elapsed = static_cast<double>(finish - start)/CLOCKS_PER_SEC;
     std::cout <<
         "Total with mode " << MODES[result.mode] << ": "
         << "handled 1: " << cls.num_handled_1 << ", "
         << "handled 2: " << cls.num_handled_2 << ", "
-        << "handled free: " << handled_free
-        << "; elapsed: " << elapsed << std::endl;
+        << "handled free: " << handled_free << std::endl;
 
     result.handled_1 = cls.num_handled_1;
     result.handled_2 = cls.num_handled_2;
     result.handled_3 = handled_free;
-    result.elapsed = elapsed;
 
   }
   catch (std::exception &e) {
@@ -427,7 +435,6 @@ void test(ServerRunMode mode)
   assert(result.handled_1 == attempts+1); //for 'end' request
   assert(result.handled_2 == attempts);
   assert(result.handled_3 == attempts);
-//  assert(result.elapsed > 0.);
 }
 
 int main (int argc, const char* argv[])
@@ -444,5 +451,6 @@ int main (int argc, const char* argv[])
   test(DYNAMIC);
 //  test(STATIC);
   test(LIBEVENT);
+  test(EPOLL);
 //  test(RAW);
 }
@@ -0,0 +1,116 @@
+/**
+ * @file RecvTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks handlers with messages received by reactor (add_recv_handler):
+ * content of received messages and reuse of message objects
+ * in Dynamic (with and without Poll::BATCH), Epoll and LibEvent reactors.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/Epoll.hpp"
+#include "zmqreactor/LibEvent.hpp"
+
+static const int MESSAGES = 10;
+
+struct Collector
+{
+  std::vector<std::string>* received;
+  std::vector<const zmq::message_t*>* objects;
+
+  bool
+  operator() (ZmqReactor::Arg arg, zmq::message_t& msg)
+  {
+    assert(arg.events == ZMQ_POLLIN);
+    received->push_back(
+      std::string(static_cast<const char*>(msg.data()), msg.size()));
+    objects->push_back(&msg);
+    return true;
+  }
+};
+
+static void
+send_all(zmq::socket_t& out)
+{
+  for (int i = 0; i < MESSAGES; ++i)
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "msg %d", i);
+    Test::send_str(out, buf);
+  }
+}
+
+static void
+check(const std::vector<std::string>& received,
+  const std::vector<const zmq::message_t*>& objects)
+{
+  assert(received.size() == MESSAGES);
+  for (int i = 0; i < MESSAGES; ++i)
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "msg %d", i);
+    assert(received[i] == buf);
+    //the same message object is reused for all receives
+    assert(objects[i] == objects[0]);
+  }
+}
+
+template <typename ReactorT>
+void
+test_reactor(zmq::context_t& context, short flags)
+{
+  Test::SocketPair s(context);
+  std::vector<std::string> received;
+  std::vector<const zmq::message_t*> objects;
+  Collector c = {&received, &objects};
+
+  ReactorT reactor;
+  reactor.add_recv_handler(s.in, c, flags);
+  send_all(s.out);
+  for (int i = 0; i < MESSAGES && received.size() < MESSAGES; ++i)
+  {
+    ZmqReactor::PollResult res = reactor(0);
+    assert(res == ZmqReactor::OK);
+  }
+  check(received, objects);
+}
+
+void
+test_libevent(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+  std::vector<std::string> received;
+  std::vector<const zmq::message_t*> objects;
+  Collector c = {&received, &objects};
+
+  ZmqReactor::LibEvent reactor;
+  send_all(s.out);
+  reactor.add_recv_handler(s.in, c);
+  reactor.run(50000);
+  check(received, objects);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+  test_reactor<ZmqReactor::Dynamic>(context, 0);
+  test_reactor<ZmqReactor::Dynamic>(context, ZmqReactor::Poll::BATCH);
+  test_reactor<ZmqReactor::Epoll>(context, 0);
+  test_reactor<ZmqReactor::Epoll>(context, ZmqReactor::Poll::BATCH);
+  test_libevent(context);
+  std::cout << "recv OK" << std::endl;
+  return 0;
+}
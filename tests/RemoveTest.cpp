@@ -0,0 +1,148 @@
+/**
+ * @file RemoveTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks removing handlers of Dynamic reactor by handles:
+ * removal from the middle, stale handles detection,
+ * removal from handlers (deferred till the end of poll operation).
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+
+using ZmqReactor::Dynamic;
+using ZmqReactor::HandlerHandle;
+
+static const int PIPES = 5;
+
+struct PipeReader
+{
+  std::vector<int>* calls;
+  int id;
+  Dynamic* reactor;
+  std::vector<HandlerHandle>* to_remove;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    char c;
+    const ssize_t got = ::read(arg.fd, &c, 1);
+    assert(got == 1);
+    ++(*calls)[id];
+    for (size_t i = 0; i < to_remove->size(); ++i)
+    {
+      const bool removed = reactor->remove_handler((*to_remove)[i]);
+      assert(removed);
+    }
+    to_remove->clear();
+    return true;
+  }
+};
+
+static void
+put(int fd)
+{
+  const ssize_t res = ::write(fd, "x", 1);
+  assert(res == 1);
+}
+
+void
+test_remove(Dynamic::DispatchMode mode)
+{
+  int fds[PIPES][2];
+  for (int i = 0; i < PIPES; ++i)
+  {
+    const int res = ::pipe(fds[i]);
+    assert(res == 0);
+  }
+
+  std::vector<int> calls(PIPES, 0);
+  std::vector<HandlerHandle> to_remove;
+  Dynamic reactor;
+  reactor.set_dispatch_mode(mode);
+  std::vector<HandlerHandle> handles;
+  for (int i = 0; i < PIPES; ++i)
+  {
+    PipeReader r = {&calls, i, &reactor, &to_remove};
+    handles.push_back(reactor.add_handler(fds[i][0], r));
+  }
+  assert(reactor.num_handlers() == PIPES);
+
+  //from the middle: the last one is moved to its place
+  bool removed = reactor.remove_handler(handles[1]);
+  assert(removed);
+  assert(!reactor.has_handler(handles[1]));
+  removed = reactor.remove_handler(handles[1]);
+  assert(!removed);
+  assert(reactor.num_handlers() == PIPES - 1);
+
+  put(fds[0][1]);
+  put(fds[4][1]);
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  assert(calls[0] == 1 && calls[1] == 0 && calls[4] == 1);
+
+  //from handler: the first called of ready handlers 0 and 2 removes both,
+  //the other one is not called (FAIR mode starts after position 0)
+  to_remove.push_back(handles[2]);
+  to_remove.push_back(handles[0]);
+  put(fds[0][1]);
+  put(fds[2][1]);
+  put(fds[3][1]);
+  res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  if (mode == Dynamic::FAIR)
+  {
+    assert(calls[0] == 1 && calls[2] == 1);
+  }
+  else
+  {
+    assert(calls[0] == 2 && calls[2] == 0);
+  }
+  assert(calls[3] == 1);
+  assert(reactor.num_handlers() == PIPES - 3);
+  assert(!reactor.has_handler(handles[0]) && !reactor.has_handler(handles[2]));
+  assert(reactor.has_handler(handles[3]) && reactor.has_handler(handles[4]));
+
+  put(fds[3][1]);
+  put(fds[4][1]);
+  res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  assert(calls[3] == 2 && calls[4] == 2);
+
+  //slot of removed handler is reused, old handle stays stale
+  PipeReader r = {&calls, 1, &reactor, &to_remove};
+  HandlerHandle h = reactor.add_handler(fds[1][0], r);
+  assert(reactor.has_handler(h));
+  assert(!reactor.has_handler(handles[0]) && !reactor.has_handler(handles[1]));
+
+  reactor.remove_handlers_from(0);
+  assert(reactor.num_handlers() == 0);
+  assert(!reactor.has_handler(h) && !reactor.has_handler(handles[3]));
+
+  for (int i = 0; i < PIPES; ++i)
+  {
+    ::close(fds[i][0]);
+    ::close(fds[i][1]);
+  }
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_remove(Dynamic::SCAN);
+  test_remove(Dynamic::READY_LIST);
+  test_remove(Dynamic::FAIR);
+  std::cout << "remove OK" << std::endl;
+  return 0;
+}
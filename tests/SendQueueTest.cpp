@@ -0,0 +1,156 @@
+/**
+ * @file SendQueueTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks send queues of Dynamic and LibEvent reactors:
+ * messages are queued when socket's HWM is reached, flushed in order
+ * when socket becomes writable, backpressure callback is called
+ * at high and low watermarks, socket is not polled for output
+ * when queue is empty. Queues work with reactor of PackedHandler handlers.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+
+#include <stdint.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/LibEvent.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+
+static const int MESSAGES = 6;
+
+static const uint64_t HWM = 2;
+
+struct Backpressure
+{
+  std::vector<bool>* calls;
+
+  void
+  operator() (ZmqReactor::SendQueue& queue, bool congested)
+  {
+    assert(queue.congested() == congested);
+    calls->push_back(congested);
+  }
+};
+
+template <typename HandlerT>
+static void
+pump(ZmqReactor::BasicDynamic<HandlerT>& reactor)
+{
+  reactor(0);
+}
+
+static void
+pump(ZmqReactor::LibEvent& reactor)
+{
+  reactor.run(10000);
+}
+
+static int
+recv_all(zmq::socket_t& socket, std::vector<int>& received)
+{
+  int n = 0;
+  zmq::message_t msg;
+  while (socket.recv(&msg, ZMQ_NOBLOCK))
+  {
+    assert(msg.size() == sizeof(int));
+    int i;
+    memcpy(&i, msg.data(), sizeof(i));
+    received.push_back(i);
+    ++n;
+  }
+  return n;
+}
+
+template <typename ReactorT>
+void
+test_queue(zmq::context_t& context)
+{
+  Test::SocketPair s(context, ZMQ_PAIR, ZMQ_PAIR, false);
+  s.in.setsockopt(ZMQ_HWM, &HWM, sizeof(HWM));
+  s.connect();
+
+  std::vector<bool> calls;
+  Backpressure bp = {&calls};
+
+  ReactorT reactor;
+  ZmqReactor::SendQueue& queue = reactor.add_send_queue(s.out, 4, bp);
+  assert(queue.high_watermark() == 4 && queue.low_watermark() == 2);
+  //queue's handler is not found by socket
+  assert(!reactor.disable_handler(s.out));
+
+  //the first HWM messages are sent at once, others are queued
+  bool ok = true;
+  for (int i = 0; i < MESSAGES; ++i)
+  {
+    zmq::message_t msg(sizeof(i));
+    memcpy(msg.data(), &i, sizeof(i));
+    ok = queue.send(msg);
+  }
+  assert(!ok);
+  assert(queue.size() == MESSAGES - HWM);
+  assert(queue.congested());
+  assert(calls.size() == 1 && calls[0]);
+
+  //not writable: nothing is flushed
+  pump(reactor);
+  assert(queue.size() == MESSAGES - HWM);
+
+  std::vector<int> received;
+  assert(recv_all(s.in, received) == HWM);
+  pump(reactor);
+  assert(queue.size() == MESSAGES - 2 * HWM);
+  assert(!queue.congested());
+  assert(calls.size() == 2 && !calls[1]);
+
+  assert(recv_all(s.in, received) == HWM);
+  pump(reactor);
+  assert(queue.empty());
+  assert(recv_all(s.in, received) == HWM);
+
+  assert(received.size() == MESSAGES);
+  for (int i = 0; i < MESSAGES; ++i)
+  {
+    assert(received[i] == i);
+  }
+
+  //empty queue: socket is not polled for output
+  pump(reactor);
+  assert(calls.size() == 2);
+}
+
+void
+test_dynamic_idle(zmq::context_t& context)
+{
+  Test::SocketPair s(context);
+
+  ZmqReactor::Dynamic reactor;
+  ZmqReactor::SendQueue& queue = reactor.add_send_queue(s.out);
+  assert(reactor.num_handlers() == 1);
+  assert(reactor(0) == ZmqReactor::NONE_MATCHED);
+
+  zmq::message_t msg(1);
+  assert(queue.send(msg));
+  assert(queue.empty());
+  assert(reactor(0) == ZmqReactor::NONE_MATCHED);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+  test_queue<ZmqReactor::Dynamic>(context);
+  test_queue<ZmqReactor::LibEvent>(context);
+  //flusher is added to reactor of non-owning handlers
+  test_queue<ZmqReactor::BasicDynamic<ZmqReactor::PackedHandler> >(context);
+  test_dynamic_idle(context);
+  std::cout << "send queue OK" << std::endl;
+  return 0;
+}
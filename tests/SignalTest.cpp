@@ -0,0 +1,126 @@
+/**
+ * @file SignalTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks signals handled by Dynamic and LibEvent reactors
+ * (add_signal_handler): pending signals are handled in one poll operation,
+ * handler returning false cancels polling,
+ * signals of reactor of PackedHandler handlers.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/LibEvent.hpp"
+#include "zmqreactor/PackedHandler.hpp"
+
+struct Recorder
+{
+  std::vector<int>* signals;
+  bool result;
+
+  bool
+  operator() (const signalfd_siginfo& info)
+  {
+    assert(info.ssi_pid == static_cast<uint32_t>(::getpid()));
+    signals->push_back(info.ssi_signo);
+    return result;
+  }
+};
+
+static void
+send_signals()
+{
+  //blocked: stay pending till reactor reads them
+  ::kill(::getpid(), SIGUSR1);
+  ::kill(::getpid(), SIGUSR2);
+}
+
+static void
+check(const std::vector<int>& signals)
+{
+  //standard signals are taken in order of numbers
+  assert(signals.size() == 2);
+  assert(signals[0] == SIGUSR1);
+  assert(signals[1] == SIGUSR2);
+}
+
+void
+test_dynamic()
+{
+  std::vector<int> signals;
+  Recorder rec = {&signals, true};
+
+  ZmqReactor::Dynamic reactor;
+  reactor.add_signal_handler(SIGUSR1, rec);
+  reactor.add_signal_handler(SIGUSR2, rec);
+  //both signals share one handler
+  assert(reactor.num_handlers() == 1);
+
+  send_signals();
+  ZmqReactor::PollResult res = reactor(1000);
+  assert(res == ZmqReactor::OK);
+  check(signals);
+
+  //cancelling handler
+  Recorder cancel = {&signals, false};
+  reactor.add_signal_handler(SIGUSR1, cancel);
+  assert(reactor.num_handlers() == 1);
+  ::kill(::getpid(), SIGUSR1);
+  res = reactor(1000);
+  assert(res == ZmqReactor::CANCELLED);
+  assert(signals.size() == 3);
+}
+
+void
+test_libevent()
+{
+  std::vector<int> signals;
+  Recorder rec = {&signals, true};
+
+  ZmqReactor::LibEvent reactor;
+  reactor.add_signal_handler(SIGUSR1, rec);
+  reactor.add_signal_handler(SIGUSR2, rec);
+
+  send_signals();
+  reactor.run(50000);
+  check(signals);
+}
+
+void
+test_packed()
+{
+  std::vector<int> signals;
+  Recorder rec = {&signals, true};
+
+  //signalfd reader is added to reactor of non-owning handlers
+  ZmqReactor::BasicDynamic<ZmqReactor::PackedHandler> reactor;
+  reactor.add_signal_handler(SIGUSR1, rec);
+  reactor.add_signal_handler(SIGUSR2, rec);
+
+  send_signals();
+  ZmqReactor::PollResult res = reactor(1000);
+  assert(res == ZmqReactor::OK);
+  check(signals);
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_dynamic();
+  test_libevent();
+  test_packed();
+  std::cout << "signal OK" << std::endl;
+  return 0;
+}
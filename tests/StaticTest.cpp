@@ -0,0 +1,149 @@
+/**
+ * @file StaticTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks static reactor made of more than 3 handlers (C++11 only):
+ * sockets with default and explicit events are polled, exactly
+ * the handlers of ready sockets are called, in order of registration
+ * or high priority first.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Static.hpp"
+
+#ifdef ZMQREACTOR_HAS_VARIADIC
+
+static const int SOCKETS = 8;
+
+struct Recorder
+{
+  std::vector<int>* order;
+  int idx;
+
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    assert(arg.events == ZMQ_POLLIN);
+    zmq::message_t msg;
+    const bool received = arg.socket->recv(&msg, ZMQ_NOBLOCK);
+    assert(received);
+    order->push_back(idx);
+    return true;
+  }
+};
+
+static Recorder
+rec(std::vector<int>& order, int idx)
+{
+  Recorder r = {&order, idx};
+  return r;
+}
+
+/**
+ * Sends to sockets listed in ready (terminated with -1),
+ * polls reactor once and checks handlers called
+ */
+static void
+check_dispatch(
+  ZmqReactor::StaticReactorBase& reactor, Test::SocketPairs& s,
+  std::vector<int>& order, const int ready[], const int expected[])
+{
+  order.clear();
+  for (const int* i = ready; *i >= 0; ++i)
+  {
+    s.send(*i);
+  }
+  ZmqReactor::PollResult res = reactor(0);
+  assert(res == ZmqReactor::OK);
+  size_t n = 0;
+  for (; expected[n] >= 0; ++n)
+  {
+    assert(n < order.size() && order[n] == expected[n]);
+  }
+  assert(order.size() == n);
+
+  //all messages are received
+  res = reactor(0);
+  assert(res == ZmqReactor::NONE_MATCHED);
+}
+
+void
+test_dispatch(zmq::context_t& context)
+{
+  Test::SocketPairs s(context, SOCKETS);
+  std::vector<int> order;
+  ZmqReactor::StaticPtr reactor = ZmqReactor::make_static(
+    s[0].in, rec(order, 0),
+    s[1].in, rec(order, 1), ZMQ_POLLIN,
+    s[2].in, rec(order, 2),
+    s[3].in, rec(order, 3), ZMQ_POLLIN,
+    s[4].in, rec(order, 4),
+    s[5].in, rec(order, 5), ZMQ_POLLIN,
+    s[6].in, rec(order, 6), ZMQ_POLLIN,
+    s[7].in, rec(order, 7));
+
+  assert((*reactor)(0) == ZmqReactor::NONE_MATCHED);
+
+  const int ready1[] = {7, 4, 1, 5, -1};
+  const int expected1[] = {1, 4, 5, 7, -1};
+  check_dispatch(*reactor, s, order, ready1, expected1);
+
+  const int ready2[] = {0, 6, -1};
+  check_dispatch(*reactor, s, order, ready2, ready2);
+  std::cout << "dispatch OK" << std::endl;
+}
+
+void
+test_priority(zmq::context_t& context)
+{
+  Test::SocketPairs s(context, SOCKETS);
+  std::vector<int> order;
+  ZmqReactor::StaticPtr reactor = ZmqReactor::make_static(
+    s[0].in, rec(order, 0),
+    s[1].in, rec(order, 1), ZMQ_POLLIN,
+    s[2].in, rec(order, 2),
+    s[3].in, rec(order, 3), ZMQ_POLLIN,
+    s[4].in, rec(order, 4),
+    s[5].in, rec(order, 5), ZMQ_POLLIN | ZmqReactor::Poll::HIGH_PRIORITY,
+    s[6].in, rec(order, 6), ZMQ_POLLIN,
+    s[7].in, rec(order, 7));
+
+  const int ready1[] = {7, 4, 1, 5, -1};
+  const int expected1[] = {5, 1, 4, 7, -1};
+  check_dispatch(*reactor, s, order, ready1, expected1);
+
+  //high priority socket is not ready
+  const int ready2[] = {6, 0, 3, -1};
+  const int expected2[] = {0, 3, 6, -1};
+  check_dispatch(*reactor, s, order, ready2, expected2);
+  std::cout << "priority OK" << std::endl;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  zmq::context_t context(1);
+  test_dispatch(context);
+  test_priority(context);
+  return 0;
+}
+
+#else
+
+int
+main(int argc, const char* argv[])
+{
+  std::cout << "static reactor of more than 3 handlers "
+    "needs variadic templates, skipped" << std::endl;
+  return 0;
+}
+
+#endif
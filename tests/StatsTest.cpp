@@ -0,0 +1,187 @@
+/**
+ * @file StatsTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks counters of reactors (if library is compiled with ZMQREACTOR_STATS):
+ * handler calls are counted by handler's index in Dynamic reactor
+ * (also after handlers are removed) and by handler in LibEvent reactor,
+ * snapshots are taken by other thread while handlers are added and removed.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+#include <pthread.h>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/LibEvent.hpp"
+#include "zmqreactor/details/Atomic.hpp"
+
+static const int PIPES = 4;
+static const int ROUNDS = 200;
+
+struct Reader
+{
+  bool
+  operator() (ZmqReactor::Arg arg)
+  {
+    char c;
+    ssize_t res = ::read(arg.fd, &c, 1);
+    assert(res == 1);
+    return true;
+  }
+};
+
+struct Pipes
+{
+  int fds[PIPES][2];
+
+  Pipes()
+  {
+    for (int i = 0; i < PIPES; ++i)
+    {
+      const int res = ::pipe(fds[i]);
+      assert(res == 0);
+    }
+  }
+
+  ~Pipes()
+  {
+    for (int i = 0; i < PIPES; ++i)
+    {
+      ::close(fds[i][0]);
+      ::close(fds[i][1]);
+    }
+  }
+
+  void
+  put(int i)
+  {
+    ssize_t res = ::write(fds[i][1], "x", 1);
+    assert(res == 1);
+  }
+};
+
+struct Monitor
+{
+  ZmqReactor::Dynamic* reactor;
+  long stop;
+  long snapshots;
+};
+
+static void*
+monitor(void* arg)
+{
+  Monitor* m = static_cast<Monitor*>(arg);
+  ZmqReactor::ReactorStats st;
+  while (!ZmqReactor::Private::atomic_add(m->stop, 0L))
+  {
+    if (!m->reactor->stats(st))
+    {
+      break;
+    }
+    assert(st.handlers.size() <= static_cast<size_t>(PIPES));
+    for (size_t i = 0; i < st.handlers.size(); ++i)
+    {
+      assert(st.handlers[i].calls <= static_cast<uint64_t>(ROUNDS));
+    }
+    ZmqReactor::Private::atomic_add(m->snapshots, 1L);
+  }
+  return 0;
+}
+
+void
+test_dynamic()
+{
+  Pipes p;
+  ZmqReactor::Dynamic reactor;
+  Monitor m = {&reactor, 0, 0};
+  pthread_t thread;
+  const int err = ::pthread_create(&thread, 0, &monitor, &m);
+  assert(!err);
+
+  //handlers churn while monitor takes snapshots
+  for (int round = 0; round < ROUNDS; ++round)
+  {
+    std::vector<ZmqReactor::HandlerHandle> handles;
+    for (int i = 0; i < PIPES; ++i)
+    {
+      handles.push_back(reactor.add_handler(p.fds[i][0], Reader()));
+    }
+    p.put(1);
+    ZmqReactor::PollResult res = reactor(1000);
+    assert(res == ZmqReactor::OK);
+
+    ZmqReactor::ReactorStats st;
+    if (reactor.stats(st))
+    {
+      assert(st.handlers.size() == PIPES);
+      assert(st.handlers[1].calls == 1);
+      assert(st.handlers[0].calls == 0);
+    }
+
+    //counters of the last handler are moved with it
+    p.put(PIPES - 1);
+    res = reactor(1000);
+    assert(res == ZmqReactor::OK);
+    reactor.remove_handler(handles[0]);
+    if (reactor.stats(st))
+    {
+      assert(st.handlers.size() == PIPES - 1);
+      assert(st.handlers[0].calls == 1);
+      assert(st.handlers[1].calls == 1);
+    }
+    reactor.remove_handlers_from(0);
+  }
+
+  ZmqReactor::Private::atomic_add(m.stop, 1L);
+  ::pthread_join(thread, 0);
+}
+
+void
+test_libevent()
+{
+  Pipes p;
+  ZmqReactor::LibEvent reactor;
+  ZmqReactor::LibEvent::HandlerDesc hd =
+    reactor.add_handler(p.fds[0][0], Reader());
+  p.put(0);
+  p.put(0);
+  reactor.run(50000);
+
+  ZmqReactor::HandlerStats hs;
+  if (reactor.handler_stats(hd, hs))
+  {
+    assert(hs.calls == 2);
+  }
+  ZmqReactor::ReactorStats st;
+  if (reactor.stats(st))
+  {
+    assert(st.handlers.empty());
+  }
+
+  //counters of removed handler are reused
+  reactor.remove_handler(hd);
+  ZmqReactor::LibEvent::HandlerDesc hd2 =
+    reactor.add_handler(p.fds[1][0], Reader());
+  if (reactor.handler_stats(hd2, hs))
+  {
+    assert(hs.calls == 0);
+  }
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_dynamic();
+  test_libevent();
+  std::cout << "stats OK" << std::endl;
+  return 0;
+}
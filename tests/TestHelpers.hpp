@@ -0,0 +1,134 @@
+/**
+ * @file TestHelpers.hpp
+ * @author askryabin
+ * Helpers shared by tests. Included first: tests check with assert
+ * in all build types.
+ */
+
+#ifndef ZMQREACTOR_TESTHELPERS_HPP_
+#define ZMQREACTOR_TESTHELPERS_HPP_
+
+#ifdef NDEBUG
+# undef NDEBUG
+#endif
+
+#include <assert.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <zmq.hpp>
+
+namespace Test
+{
+  /**
+   * Send string (may be empty) as message part
+   */
+  inline void
+  send_str(zmq::socket_t& socket, const char* str, int flags = 0)
+  {
+    const size_t len = strlen(str);
+    zmq::message_t msg(len);
+    if (len)
+    {
+      memcpy(msg.data(), str, len);
+    }
+    const bool sent = socket.send(msg, flags);
+    assert(sent);
+  }
+
+  /**
+   * Sockets connected by unique inproc address:
+   * in is bound, out is connected to it.
+   */
+  struct SocketPair
+  {
+    zmq::socket_t in, out;
+
+    /**
+     * @param connected if false, call connect() after setting options
+     */
+    SocketPair(
+      zmq::context_t& context,
+      int in_type = ZMQ_PAIR, int out_type = ZMQ_PAIR, bool connected = true) :
+      in(context, in_type), out(context, out_type)
+    {
+      if (connected)
+      {
+        connect();
+      }
+    }
+
+    void
+    connect()
+    {
+      static int n = 0;
+      char addr[64];
+      snprintf(addr, sizeof(addr), "inproc://zmqreactor_test_pair_%d", n++);
+      in.bind(addr);
+      out.connect(addr);
+    }
+  };
+
+  /**
+   * Several socket pairs
+   */
+  class SocketPairs
+  {
+  private:
+    std::vector<SocketPair*> pairs_;
+
+    SocketPairs(const SocketPairs&);
+    void operator=(const SocketPairs&);
+
+  public:
+    SocketPairs(zmq::context_t& context, size_t num)
+    {
+      for (size_t i = 0; i < num; ++i)
+      {
+        pairs_.push_back(new SocketPair(context));
+      }
+    }
+
+    ~SocketPairs()
+    {
+      for (size_t i = 0; i < pairs_.size(); ++i)
+      {
+        delete pairs_[i];
+      }
+    }
+
+    inline size_t
+    size() const
+    {
+      return pairs_.size();
+    }
+
+    inline SocketPair&
+    operator[] (size_t i)
+    {
+      return *pairs_[i];
+    }
+
+    /**
+     * Send one-byte message to in socket of i-th pair
+     */
+    void
+    send(size_t i)
+    {
+      send_str(pairs_[i]->out, "x");
+    }
+
+    void
+    send_all()
+    {
+      for (size_t i = 0; i < pairs_.size(); ++i)
+      {
+        send(i);
+      }
+    }
+  };
+}
+
+#endif /* ZMQREACTOR_TESTHELPERS_HPP_ */
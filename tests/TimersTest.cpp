@@ -0,0 +1,219 @@
+/**
+ * @file TimersTest.cpp
+ * @author askryabin
+ *
+ * \test
+ * \brief
+ * Checks timing wheel with simulated time
+ * (expiration order, cancel, persistent and far timeouts)
+ * and timeouts of Dynamic and LibEvent reactors.
+ */
+
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <tr1/functional>
+
+#include <zmq.hpp>
+
+#include "zmqreactor/Dynamic.hpp"
+#include "zmqreactor/LibEvent.hpp"
+#include "zmqreactor/details/TimerWheel.hpp"
+#include "zmqreactor/details/Clock.hpp"
+
+using ZmqReactor::Private::TimerWheel;
+using ZmqReactor::TimeoutHandle;
+
+static const long RES = 1000;
+
+struct Record
+{
+  std::vector<int>* fired;
+  int id;
+  bool ret;
+
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    fired->push_back(id);
+    return ret;
+  }
+};
+
+static Record
+rec(std::vector<int>& fired, int id, bool ret = true)
+{
+  Record r = {&fired, id, ret};
+  return r;
+}
+
+struct Canceller
+{
+  TimerWheel* wheel;
+  TimeoutHandle* handle;
+
+  bool
+  operator() (ZmqReactor::Arg)
+  {
+    assert(wheel->cancel(*handle));
+    return true;
+  }
+};
+
+void
+test_wheel()
+{
+  uint64_t now = 1000000000;
+  TimerWheel w(RES, now);
+  std::vector<int> fired;
+
+  w.add(now, 5000, rec(fired, 1), false);
+  w.add(now, 1000, rec(fired, 2), false);
+  TimeoutHandle h3 = w.add(now, 3000, rec(fired, 3), false);
+  w.add(now, 300000, rec(fired, 4), false); //level 1
+  w.add(now, 10000000, rec(fired, 5), false); //level 2
+  assert(w.size() == 5);
+
+  assert(w.poll_timeout(now, -1) == 1000);
+  assert(w.poll_timeout(now, 500) == 500);
+
+  assert(w.cancel(h3));
+  assert(!w.cancel(h3));
+  assert(w.size() == 4);
+
+  //never earlier than requested
+  assert(w.expire(now + 999) == 0);
+  assert(w.expire(now + 1000) == 1);
+  assert(fired.size() == 1 && fired[0] == 2);
+
+  assert(w.expire(now + 299999) == 1);
+  assert(fired.back() == 1);
+  assert(w.expire(now + 300000) == 1);
+  assert(fired.back() == 4);
+  assert(w.expire(now + 9999999) == 0);
+  assert(w.expire(now + 10000000) == 1);
+  assert(fired.back() == 5);
+  assert(w.empty());
+  assert(w.poll_timeout(now, -1) == -1);
+
+  //persistent, cancelled from another timeout
+  now += 20000000;
+  fired.clear();
+  TimeoutHandle hp = w.add(now, 2000, rec(fired, 6), true);
+  Canceller c = {&w, &hp};
+  w.add(now, 7000, c, false);
+  assert(w.expire(now + 2000) == 1);
+  assert(w.expire(now + 4000) == 1);
+  assert(w.expire(now + 6000) == 1);
+  assert(w.expire(now + 7000) == 1); //canceller
+  assert(w.empty());
+  assert(fired.size() == 3);
+
+  //far timeout (beyond wheel range) expires in time
+  fired.clear();
+  const long far = 6L * 3600 * 1000000;
+  w.add(now, far, rec(fired, 7), false);
+  uint64_t t = now;
+  while (fired.empty())
+  {
+    long wait = w.poll_timeout(t, -1);
+    assert(wait >= 0);
+    t += wait;
+    w.expire(t);
+  }
+  assert(t >= now + far && t < now + far + RES);
+
+  //cancel processing: rest is fired next time
+  fired.clear();
+  now = t;
+  w.add(now, 1000, rec(fired, 8, false), false);
+  w.add(now, 1000, rec(fired, 9, false), false);
+  assert(w.expire(now + 1000) == -1);
+  assert(fired.size() == 1);
+  assert(w.poll_timeout(now + 1000, -1) == 0);
+  assert(w.expire(now + 1000) == -1);
+  assert(fired.size() == 2);
+  assert(w.empty());
+
+  std::cout << "wheel OK" << std::endl;
+}
+
+void
+test_dynamic()
+{
+  zmq::context_t context(1);
+  zmq::socket_t sock(context, ZMQ_PAIR);
+  sock.bind("inproc://zmqreactor_timers_test");
+
+  std::vector<int> fired;
+  ZmqReactor::Dynamic reactor;
+  reactor.add_handler(sock, rec(fired, 0));
+  reactor.add_timeout(20000, rec(fired, 1), true);
+  TimeoutHandle h = reactor.add_timeout(30000, rec(fired, 2));
+  reactor.add_timeout(50000, rec(fired, 3, false));
+  assert(reactor.num_timeouts() == 3);
+  assert(reactor.cancel_timeout(h));
+
+  const uint64_t start = ZmqReactor::Private::Clock::now_usec();
+  ZmqReactor::PollResult res = reactor.run(1000000);
+  const uint64_t elapsed = ZmqReactor::Private::Clock::now_usec() - start;
+
+  assert(res == ZmqReactor::CANCELLED);
+  assert(elapsed >= 50000 && elapsed < 1000000);
+  assert(fired.size() >= 2);
+  assert(fired[0] == 1 && fired.back() == 3);
+  assert(std::find(fired.begin(), fired.end(), 2) == fired.end());
+  assert(reactor.num_timeouts() == 1);
+
+  std::cout << "dynamic OK" << std::endl;
+}
+
+void
+test_libevent()
+{
+  std::vector<int> fired;
+  ZmqReactor::LibEvent reactor;
+  //many timeouts of the same duration share one timer
+  for (int i = 0; i < 100; ++i)
+  {
+    reactor.add_timeout_usec(20000, rec(fired, 2));
+  }
+  reactor.add_timeout_usec(3000, rec(fired, 1));
+  reactor.add_timeout_usec(1500, rec(fired, 0));
+  //whole seconds: does not fire within run
+  reactor.add_timeout(1, rec(fired, 5));
+
+  //run timeout is in microseconds
+  uint64_t start = ZmqReactor::Private::Clock::now_usec();
+  reactor.run(50000);
+  uint64_t elapsed = ZmqReactor::Private::Clock::now_usec() - start;
+
+  assert(elapsed >= 20000 && elapsed < 1000000);
+  assert(fired.size() == 102);
+  assert(fired[0] == 0 && fired[1] == 1 && fired.back() == 2);
+
+  fired.clear();
+  reactor.add_timeout_usec(5000, rec(fired, 3), true);
+  reactor.add_timeout_usec(12000, rec(fired, 4, false));
+  start = ZmqReactor::Private::Clock::now_usec();
+  ZmqReactor::PollResult res = reactor.run();
+  elapsed = ZmqReactor::Private::Clock::now_usec() - start;
+
+  assert(res == ZmqReactor::CANCELLED);
+  assert(elapsed >= 12000 && elapsed < 1000000);
+  assert(fired.size() == 3);
+  assert(fired[0] == 3 && fired[1] == 3 && fired[2] == 4);
+
+  std::cout << "libevent OK" << std::endl;
+}
+
+int
+main(int argc, const char* argv[])
+{
+  test_wheel();
+  test_dynamic();
+  test_libevent();
+  return 0;
+}